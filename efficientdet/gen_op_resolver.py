@@ -0,0 +1,192 @@
+# Copyright 2022 NXP
+# SPDX-License-Identifier: Apache-2.0
+
+# Generates a MutableOpResolver that registers only the kernels used by the
+# given .tflite models, for builds with 'make MINIMAL_RESOLVER=1'.
+#
+# The flatbuffers are read directly, so neither TensorFlow nor the flatbuffers
+# package is needed. Names of the builtin operators are taken from the
+# schema_generated.h of the TensorFlow tree the demo is built against.
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+# Custom operators the builtin resolver registers, with their registration
+CUSTOM_OPS = {
+	"TFLite_Detection_PostProcess": "Register_DETECTION_POSTPROCESS",
+}
+
+# Field indices of the TensorFlow Lite schema
+MODEL_OPERATOR_CODES = 1
+MODEL_SUBGRAPHS      = 2
+OPCODE_DEPRECATED    = 0
+OPCODE_CUSTOM        = 1
+OPCODE_VERSION       = 2
+OPCODE_BUILTIN       = 3
+SUBGRAPH_OPERATORS   = 3
+OPERATOR_OPCODE      = 0
+
+BUILTIN_CUSTOM = 32
+
+
+class FlatBuffer:
+	def __init__(self, data):
+		self.data = data
+
+	def u32(self, pos):
+		return struct.unpack_from("<I", self.data, pos)[0]
+
+	def table(self, pos):
+		return pos + self.u32(pos)
+
+	def field(self, table, index):
+		# Position of a table field, None if it holds the default value
+		vtable = table - struct.unpack_from("<i", self.data, table)[0]
+		vtableSize = struct.unpack_from("<H", self.data, vtable)[0]
+		entry = 4 + 2 * index
+		if entry >= vtableSize:
+			return None
+		offset = struct.unpack_from("<H", self.data, vtable + entry)[0]
+		return table + offset if offset else None
+
+	def scalar(self, table, index, fmt, default):
+		pos = self.field(table, index)
+		return struct.unpack_from("<" + fmt, self.data, pos)[0] if pos is not None else default
+
+	def vector(self, table, index):
+		# Positions of the elements of a vector of tables
+		pos = self.field(table, index)
+		if pos is None:
+			return []
+		start = pos + self.u32(pos)
+		return [self.table(start + 4 + 4 * i) for i in range(self.u32(start))]
+
+	def string(self, table, index):
+		pos = self.field(table, index)
+		if pos is None:
+			return None
+		start = pos + self.u32(pos)
+		return self.data[start + 4:start + 4 + self.u32(start)].decode("utf-8")
+
+
+def usedOperators(path):
+	# Returns {(builtin code, custom code): highest version} of the operators
+	# the model's subgraphs actually run
+	with open(path, "rb") as f:
+		data = f.read()
+
+	if len(data) < 8 or data[4:8] != b"TFL3":
+		sys.exit("{path} is not a TensorFlow Lite model".format(path=path))
+
+	fb = FlatBuffer(data)
+	model = fb.table(0)
+
+	codes = []
+	for opcode in fb.vector(model, MODEL_OPERATOR_CODES):
+		# Codes above 127 only live in the newer builtin_code field
+		deprecated = fb.scalar(opcode, OPCODE_DEPRECATED, "b", 0)
+		builtin    = max(deprecated, fb.scalar(opcode, OPCODE_BUILTIN, "i", 0))
+		custom     = fb.string(opcode, OPCODE_CUSTOM) if builtin == BUILTIN_CUSTOM else None
+		codes.append(((builtin, custom), fb.scalar(opcode, OPCODE_VERSION, "i", 1)))
+
+	used = {}
+	for subgraph in fb.vector(model, MODEL_SUBGRAPHS):
+		for operator in fb.vector(subgraph, SUBGRAPH_OPERATORS):
+			key, version = codes[fb.scalar(operator, OPERATOR_OPCODE, "I", 0)]
+			used[key] = max(used.get(key, 1), version)
+
+	return used
+
+
+def builtinNames(schema):
+	names = {}
+	with open(schema) as f:
+		for match in re.finditer(r"^\s*BuiltinOperator_(\w+)\s*=\s*(-?\d+)", f.read(), re.MULTILINE):
+			if match.group(1) not in ("MIN", "MAX"):
+				names[int(match.group(2))] = match.group(1)
+	if not names:
+		sys.exit("No BuiltinOperator values found in {schema}".format(schema=schema))
+	return names
+
+
+parser = argparse.ArgumentParser(description='Minimal op resolver generator')
+
+parser.add_argument('models', nargs='+', help='.tflite models the resolver has to support')
+parser.add_argument('--schema', help='Path to tensorflow/lite/schema/schema_generated.h', required=True)
+parser.add_argument('--output', help='Header to write', default='minimal_op_resolver.hpp')
+
+args = vars(parser.parse_args())
+
+names = builtinNames(args["schema"])
+
+operators = {}
+for model in args["models"]:
+	for key, version in usedOperators(model).items():
+		operators[key] = max(operators.get(key, 1), version)
+
+builtins = []
+customs  = []
+for (code, custom), version in sorted(operators.items(), key=lambda item: (item[0][0], item[0][1] or "")):
+	if custom is not None:
+		if custom not in CUSTOM_OPS:
+			sys.exit("Custom operator {custom} is not supported by the builtin resolver either".format(custom=custom))
+		customs.append((custom, CUSTOM_OPS[custom], version))
+	elif code not in names:
+		sys.exit("Builtin operator {code} is missing from {schema}, is the schema older than the models?".format(
+			code=code, schema=args["schema"]))
+	else:
+		builtins.append((names[code], version))
+
+lines = []
+lines.append("/*")
+lines.append("* Copyright 2022 NXP")
+lines.append("* SPDX-License-Identifier: Apache-2.0")
+lines.append("*/")
+lines.append("")
+lines.append("/*")
+lines.append("\tGenerated by gen_op_resolver.py from")
+for model in args["models"]:
+	lines.append("\t\t" + os.path.basename(model))
+lines.append("\tDo not edit, run 'make minimal_op_resolver.hpp' again instead.")
+lines.append("*/")
+lines.append("")
+lines.append("#ifndef MINIMAL_OP_RESOLVER")
+lines.append("#define MINIMAL_OP_RESOLVER")
+lines.append("")
+lines.append("#include \"tensorflow/lite/kernels/builtin_op_kernels.h\"")
+lines.append("#include \"tensorflow/lite/mutable_op_resolver.h\"")
+lines.append("")
+if customs:
+	lines.append("namespace tflite { namespace ops { namespace custom {")
+	for name, registration, version in customs:
+		lines.append("TfLiteRegistration* {registration}();".format(registration=registration))
+	lines.append("} } }")
+	lines.append("")
+lines.append("/*")
+lines.append("\tRegisters the {count} kernels the models above use, up to the highest".format(
+	count=len(builtins) + len(customs)))
+lines.append("\tversion found in them.")
+lines.append("*/")
+lines.append("class MinimalOpResolver : public tflite::MutableOpResolver {")
+lines.append("public:")
+lines.append("  MinimalOpResolver()")
+lines.append("  {")
+for name, version in builtins:
+	lines.append("    AddBuiltin(tflite::BuiltinOperator_{name}, tflite::ops::builtin::Register_{name}(), 1, {version});".format(
+		name=name, version=version))
+for name, registration, version in customs:
+	lines.append("    AddCustom(\"{name}\", tflite::ops::custom::{registration}(), 1, {version});".format(
+		name=name, registration=registration, version=version))
+lines.append("  }")
+lines.append("};")
+lines.append("")
+lines.append("#endif")
+
+with open(args["output"], "w") as f:
+	f.write("\n".join(lines) + "\n")
+
+print("{output}: {builtins} builtin and {customs} custom operators".format(
+	output=args["output"], builtins=len(builtins), customs=len(customs)))
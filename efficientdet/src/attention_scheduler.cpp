@@ -0,0 +1,163 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <iostream>
+#include "attention_scheduler.hpp"
+
+namespace {
+
+// Minimum overlap of a detection with a track's predicted box
+const float MATCH_IOU = 0.3f;
+
+// Crops in a row a tracked object may be missing from before it is dropped
+const int MAX_MISSES = 2;
+
+// Weight of the latest motion in the velocity estimate
+const float VELOCITY_SMOOTHING = 0.5f;
+
+}
+
+AttentionScheduler::AttentionScheduler(Detector& cropDetector, const AttentionOptions& options)
+  : attentionOptions(options), cropBatch(cropDetector), cropStats("attention inference")
+{
+}
+
+Detection AttentionScheduler::predict(const Track& track) const
+{
+  float elapsed = static_cast<float>(frameIndex - track.lastSeen);
+
+  Detection box = track.box;
+  box.xmin += track.vx * elapsed;
+  box.xmax += track.vx * elapsed;
+  box.ymin += track.vy * elapsed;
+  box.ymax += track.vy * elapsed;
+  return box;
+}
+
+void AttentionScheduler::update(Track& track, const Detection& detection)
+{
+  float elapsed = static_cast<float>(std::max<uint64_t>(1, frameIndex - track.lastSeen));
+  float dx = ((detection.xmin + detection.xmax) - (track.box.xmin + track.box.xmax)) / 2 / elapsed;
+  float dy = ((detection.ymin + detection.ymax) - (track.box.ymin + track.box.ymax)) / 2 / elapsed;
+
+  track.vx       += VELOCITY_SMOOTHING * (dx - track.vx);
+  track.vy       += VELOCITY_SMOOTHING * (dy - track.vy);
+  track.box       = detection;
+  track.lastSeen  = frameIndex;
+  track.misses    = 0;
+}
+
+bool AttentionScheduler::detect(const cv::Mat& frame, std::vector<Detection>& detections)
+{
+  if(tracks.empty() || sinceFull + 1 >= attentionOptions.interval){
+    return false;
+  }
+
+  frameIndex++;
+  sinceFull++;
+  cropFrames++;
+
+  // Crops for the strongest tracks, the others keep their predicted boxes
+  cropTracks.clear();
+  for(size_t i = 0; i < tracks.size(); i++){
+    cropTracks.push_back(static_cast<int>(i));
+  }
+  std::sort(cropTracks.begin(), cropTracks.end(), [this](int a, int b){
+    return tracks[a].box.score > tracks[b].box.score;
+  });
+  cropTracks.resize(std::min<size_t>(cropTracks.size(), cropBatch.capacity()));
+
+  // Crops are at least half the model resolution, so small objects are
+  // upscaled at most twice
+  int minSide = cropBatch.resolution() / 2;
+
+  regions.clear();
+  for(int index : cropTracks){
+    regions.push_back(squareCropAround(predict(tracks[index]), frame.size(), attentionOptions.margin, minSide));
+  }
+
+  cropStats.add(cropBatch.run(frame, regions, attentionOptions.threshold, regionDetections));
+  crops += regions.size();
+
+  for(size_t i = 0; i < cropTracks.size(); i++){
+    Track&    track     = tracks[cropTracks[i]];
+    Detection predicted = predict(track);
+
+    // The object in the crop that overlaps the prediction most
+    const Detection* best    = nullptr;
+    float            bestIoU = MATCH_IOU;
+    for(const Detection& detection : regionDetections[i]){
+      float iou = intersectionOverUnion(detection, predicted);
+      if(detection.label == track.box.label && iou > bestIoU){
+        best    = &detection;
+        bestIoU = iou;
+      }
+    }
+
+    if(best){
+      update(track, *best);
+    }
+    else{
+      track.misses++;
+    }
+  }
+
+  tracks.erase(std::remove_if(tracks.begin(), tracks.end(),
+                              [](const Track& track){ return track.misses > MAX_MISSES; }),
+               tracks.end());
+
+  detections.clear();
+  for(const Track& track : tracks){
+    detections.push_back(predict(track));
+  }
+
+  return true;
+}
+
+void AttentionScheduler::fullFrame(const cv::Mat& frame, const std::vector<Detection>& detections)
+{
+  frameIndex++;
+  sinceFull = 0;
+  fullFrames++;
+
+  // The full frame is authoritative: matched tracks keep their motion,
+  // unmatched detections start new tracks and everything else is dropped
+  std::vector<Track> next;
+  std::vector<bool>  matched(tracks.size(), false);
+
+  for(const Detection& detection : detections){
+    int   bestTrack = -1;
+    float bestIoU   = MATCH_IOU;
+    for(size_t i = 0; i < tracks.size(); i++){
+      float iou = intersectionOverUnion(detection, predict(tracks[i]));
+      if(!matched[i] && tracks[i].box.label == detection.label && iou > bestIoU){
+        bestTrack = static_cast<int>(i);
+        bestIoU   = iou;
+      }
+    }
+
+    Track track;
+    if(bestTrack >= 0){
+      matched[bestTrack] = true;
+      track = tracks[bestTrack];
+      update(track, detection);
+    }
+    else{
+      track.box      = detection;
+      track.lastSeen = frameIndex;
+    }
+    next.push_back(track);
+  }
+
+  tracks.swap(next);
+}
+
+void AttentionScheduler::printStats() const
+{
+  std::cout << "Attention: " << fullFrames << " full frames, " << cropFrames << " crop frames, "
+            << crops << " crops" << std::endl;
+  cropStats.print();
+}
@@ -0,0 +1,84 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef ATTENTION_SCHEDULER
+#define ATTENTION_SCHEDULER
+
+#include <cstdint>
+#include <vector>
+#include "crop_batch.hpp"
+#include "region_scheduler.hpp"
+#include "stage_stats.hpp"
+
+/*
+	Options of attention crops.
+
+	interval:  Every interval-th frame gets a full-frame inference, the
+	           frames in between only crops around tracked objects
+	margin:    Context around a tracked box, as a fraction of its size on
+	           every side
+	threshold: Minimum score of detections in crops
+*/
+struct AttentionOptions {
+  int   interval  = 10;
+  float margin    = 0.5f;
+  float threshold = 0.3f;
+};
+
+
+/*
+	Between periodic full-frame passes, runs the model only on crops around the
+	objects found so far. Every crop is resized to the full model resolution,
+	so objects are refined at a much higher effective resolution than in the
+	downscaled full frame, and all crops of a frame share one batched
+	Invoke().
+
+	Objects are followed by a simple IoU tracker with a constant-velocity
+	prediction, which places the crops on the next frame. A track not found
+	in its crop for a few frames is dropped; new objects appear with the next
+	full-frame pass.
+
+	cropDetector: Detector for the crops, its batch size is the maximum
+	              number of crops per frame. Usually a second interpreter of
+	              the main model.
+	options:      Attention settings
+*/
+class AttentionScheduler : public RegionScheduler {
+public:
+  AttentionScheduler(Detector& cropDetector, const AttentionOptions& options);
+
+  bool detect(const cv::Mat& frame, std::vector<Detection>& detections) override;
+  void fullFrame(const cv::Mat& frame, const std::vector<Detection>& detections) override;
+  void printStats() const override;
+
+private:
+  struct Track {
+    Detection box;
+    float     vx       = 0;   // Center motion per frame, normalized
+    float     vy       = 0;
+    uint64_t  lastSeen = 0;   // Frame of the last update
+    int       misses   = 0;   // Consecutive crops without the object
+  };
+
+  void      update(Track& track, const Detection& detection);
+  Detection predict(const Track& track) const;
+
+  AttentionOptions attentionOptions;
+  CropBatch        cropBatch;
+  StageStats       cropStats;
+
+  std::vector<Track>                  tracks;
+  std::vector<int>                    cropTracks;
+  std::vector<cv::Rect>               regions;
+  std::vector<std::vector<Detection>> regionDetections;
+
+  uint64_t frameIndex = 0;
+  int      sinceFull  = 0;
+  uint64_t fullFrames = 0;
+  uint64_t cropFrames = 0;
+  uint64_t crops      = 0;
+};
+
+#endif
@@ -0,0 +1,79 @@
+#!/bin/bash
+#
+# Copyright 2022 NXP
+# SPDX-License-Identifier: Apache-2.0
+#
+# Input resolution sweep. For every resolution a test clip is encoded once
+# with ffmpeg (testsrc2) or, without ffmpeg, GStreamer (videotestsrc), then
+# decoded and processed by the demo. The mean time of each stage is collected
+# into a markdown table, ready for BENCHMARK.md.
+#
+# Usage: ./benchmark_sweep.sh <model> [frames] [extra demo arguments]
+# Example: ./benchmark_sweep.sh efficientdet-lite0-int8.tflite 150 -b VX -d /usr/lib/libvx_delegate.so
+#
+# Environment:
+#   RESOLUTIONS  Resolutions to sweep, default "854x480 1280x720 1920x1080 2560x1440 3840x2160"
+#   SINK         Output sink of the measured run, default "gst" (use "null" to leave out encoding)
+#   SWEEP_DIR    Directory for clips and logs, default "sweep"
+
+set -e
+
+MODEL=$1
+FRAMES=${2:-150}
+shift 2 || shift $#
+
+if [ -z "$MODEL" ]; then
+  echo "Usage: $0 <model> [frames] [extra demo arguments]"
+  exit 1
+fi
+
+DEMO=${DEMO:-./efficientdet_demo}
+RESOLUTIONS=${RESOLUTIONS:-"854x480 1280x720 1920x1080 2560x1440 3840x2160"}
+SINK=${SINK:-gst}
+SWEEP_DIR=${SWEEP_DIR:-sweep}
+
+mkdir -p "$SWEEP_DIR"
+
+# Clean test pattern clip: no boxes or FPS text drawn into it by a previous run
+encode_clip() {
+  local width=${1%x*}
+  local height=${1#*x}
+
+  if command -v ffmpeg > /dev/null; then
+    ffmpeg -loglevel error -y -f lavfi -i "testsrc2=size=${width}x${height}:rate=30" \
+           -frames:v "$FRAMES" -c:v mpeg4 -q:v 3 "$2"
+  elif command -v gst-launch-1.0 > /dev/null; then
+    gst-launch-1.0 -q videotestsrc num-buffers="$FRAMES" pattern=smpte \
+      ! "video/x-raw,width=$width,height=$height,framerate=30/1" ! videoconvert \
+      ! avenc_mpeg4 ! avimux ! filesink location="$2"
+  else
+    echo "Neither ffmpeg nor gst-launch-1.0 found to encode the test clips" >&2
+    exit 1
+  fi
+}
+
+# Mean of a stage from the demo's "Stage timings" report
+stage_mean() {
+  awk -v stage="$1:" '$1 == stage { print $3; exit }' "$2"
+}
+
+echo "| Resolution | decode | preprocess | inference | render | encode |"
+echo "| ---------- | ------ | ---------- | --------- | ------ | ------ |"
+
+for RES in $RESOLUTIONS; do
+  CLIP="$SWEEP_DIR/testsrc_${RES}_$FRAMES.avi"
+  LOG="$SWEEP_DIR/sweep_$RES.log"
+
+  # Same content at every resolution, encoded like a typical camera clip
+  if [ ! -f "$CLIP" ]; then
+    encode_clip "$RES" "$CLIP"
+  fi
+
+  "$DEMO" -m "$MODEL" -i "$CLIP" --sink "$SINK" -o "$SWEEP_DIR/out_$RES.avi" "$@" > "$LOG"
+
+  echo "| $RES | $(stage_mean decode "$LOG") | $(stage_mean preprocess "$LOG") |" \
+       "$(stage_mean inference "$LOG") | $(stage_mean render "$LOG") | $(stage_mean encode "$LOG") |"
+done
+
+echo
+echo "*Mean time per frame in ms, $FRAMES frames per resolution, $SINK sink.*"
@@ -0,0 +1,106 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef BOUNDED_QUEUE
+#define BOUNDED_QUEUE
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/*
+	Blocking FIFO with a fixed capacity, used to hand frames between pipeline
+	threads. Storage is allocated once in the constructor.
+
+	Once close() is called, push() fails and pop() drains the remaining items
+	before it starts failing as well.
+*/
+template <typename T>
+class BoundedQueue {
+public:
+  explicit BoundedQueue(size_t capacity)
+    : items(capacity), head(0), count(0), closed(false) {}
+
+  // Blocks while the queue is full. Returns false if the queue was closed.
+  bool push(T item)
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    notFull.wait(guard, [this]{ return count < items.size() || closed; });
+    if(closed){
+      return false;
+    }
+    enqueue(std::move(item));
+    guard.unlock();
+    notEmpty.notify_one();
+    return true;
+  }
+
+  // Returns false instead of blocking when the queue is full or closed
+  bool tryPush(T& item)
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    if(count == items.size() || closed){
+      return false;
+    }
+    enqueue(std::move(item));
+    guard.unlock();
+    notEmpty.notify_one();
+    return true;
+  }
+
+  // Blocks while the queue is empty. Returns false once closed and drained.
+  bool pop(T& item)
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    notEmpty.wait(guard, [this]{ return count > 0 || closed; });
+    if(count == 0){
+      return false;
+    }
+    item = std::move(items[head]);
+    items[head] = T();
+    head = (head + 1) % items.size();
+    count--;
+    guard.unlock();
+    notFull.notify_one();
+    return true;
+  }
+
+  void close()
+  {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      closed = true;
+    }
+    notFull.notify_all();
+    notEmpty.notify_all();
+  }
+
+  size_t size() const
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    return count;
+  }
+
+  size_t capacity() const { return items.size(); }
+
+private:
+  void enqueue(T&& item)
+  {
+    items[(head + count) % items.size()] = std::move(item);
+    count++;
+  }
+
+  std::vector<T>          items;
+  size_t                  head;
+  size_t                  count;
+  bool                    closed;
+  mutable std::mutex      lock;
+  std::condition_variable notFull;
+  std::condition_variable notEmpty;
+};
+
+#endif
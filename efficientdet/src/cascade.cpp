@@ -0,0 +1,137 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <iostream>
+#include "efficientdet_utils.hpp"
+#include "cascade.hpp"
+#include "crop_batch.hpp"
+
+namespace {
+
+// Context around a gate box, as a fraction of its size on every side
+const float CROP_MARGIN = 0.25f;
+
+// Overlapping crops find the same object twice, keep the stronger one
+const float DUPLICATE_IOU = 0.5f;
+
+}
+
+Cascade::Cascade(Detector& confirm, const CascadeOptions& options)
+  : confirmDetector(confirm), cascadeOptions(options),
+    scaledPool("confirm", cv::Size(confirm.resolution, confirm.resolution), CV_8UC3, 1),
+    confirmStats("confirm inference")
+{
+}
+
+bool Cascade::gateMatches(const Detection& detection) const
+{
+  if(detection.score < cascadeOptions.gateThreshold){
+    return false;
+  }
+
+  const std::vector<int>& classes = cascadeOptions.gateClasses;
+  return classes.empty() || std::find(classes.begin(), classes.end(), detection.label) != classes.end();
+}
+
+void Cascade::runConfirm(const cv::Mat& region, bool rgb, std::vector<Detection>& detections)
+{
+  int res = confirmDetector.resolution;
+
+  // Write the last conversion straight into the input tensor
+  cv::Mat input(res, res, CV_8UC3, confirmDetector.inTensor->data.raw);
+
+  FrameBuffer scaled = scaledPool.acquire();
+  cv::resize(region, scaled.mat, scaled.mat.size(), 0, 0, cv::INTER_CUBIC);
+  if(rgb){
+    scaled.mat.copyTo(input);
+  }
+  else{
+    cv::cvtColor(scaled.mat, input, cv::COLOR_BGR2RGB);
+  }
+
+  confirmStats.add(timedInference(confirmDetector.interpreter.get()));
+
+  getOutputVectors(confirmDetector.outTensor, outputRows(confirmDetector), outputValues(confirmDetector), outputs);
+  readDetections(confirmDetector, outputs, cascadeOptions.scoreThreshold, detections);
+}
+
+bool Cascade::process(const Detector& gate, const std::vector<std::vector<float>>& gateOutputs, int image,
+                      const cv::Mat& frame, bool rgb, std::vector<Detection>& confirmed)
+{
+  frames++;
+  confirmed.clear();
+
+  readDetections(gate, gateOutputs, cascadeOptions.gateThreshold, gateDetections, image);
+  gateDetections.erase(std::remove_if(gateDetections.begin(), gateDetections.end(),
+                                      [this](const Detection& d){ return !gateMatches(d); }),
+                       gateDetections.end());
+
+  if(gateDetections.empty()){
+    return false;
+  }
+
+  flagged++;
+
+  if(cascadeOptions.crops <= 0){
+    runConfirm(frame, rgb, confirmed);
+    return true;
+  }
+
+  // Strongest gate detections first
+  std::sort(gateDetections.begin(), gateDetections.end(),
+            [](const Detection& a, const Detection& b){ return a.score > b.score; });
+
+  size_t count = std::min<size_t>(gateDetections.size(), cascadeOptions.crops);
+  for(size_t i = 0; i < count; i++){
+    // Crops are at least half the confirm resolution, so small boxes are
+    // upscaled at most twice
+    cv::Rect crop = squareCropAround(gateDetections[i], frame.size(), CROP_MARGIN, confirmDetector.resolution / 2);
+    runConfirm(frame(crop), rgb, regionDetections);
+    crops++;
+
+    for(Detection detection : regionDetections){
+      // Back from crop to frame coordinates
+      detection.xmin = (crop.x + detection.xmin * crop.width)  / frame.cols;
+      detection.xmax = (crop.x + detection.xmax * crop.width)  / frame.cols;
+      detection.ymin = (crop.y + detection.ymin * crop.height) / frame.rows;
+      detection.ymax = (crop.y + detection.ymax * crop.height) / frame.rows;
+      detection.image = image;
+
+      auto duplicate = std::find_if(confirmed.begin(), confirmed.end(), [&](const Detection& other){
+        return other.label == detection.label && intersectionOverUnion(other, detection) > DUPLICATE_IOU;
+      });
+
+      if(duplicate == confirmed.end()){
+        confirmed.push_back(detection);
+      }
+      else if(duplicate->score < detection.score){
+        *duplicate = detection;
+      }
+    }
+  }
+
+  return true;
+}
+
+void Cascade::printStats() const
+{
+  std::cout << "Cascade: " << flagged << " of " << frames << " frames confirmed";
+  if(cascadeOptions.crops > 0){
+    std::cout << ", " << crops << " crops";
+  }
+  std::cout << std::endl;
+  confirmStats.print();
+}
+
+void drawDetections(const std::vector<Detection>& detections, cv::Mat& image)
+{
+  for(const Detection& detection : detections){
+    cv::Point topLeft(detection.xmin * image.cols, detection.ymin * image.rows);
+    cv::Point bottomRight(detection.xmax * image.cols, detection.ymax * image.rows);
+
+    cv::rectangle(image, topLeft, bottomRight, cv::Scalar(0, 255, 0));
+  }
+}
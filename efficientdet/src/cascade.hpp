@@ -0,0 +1,92 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef CASCADE
+#define CASCADE
+
+#include <cstdint>
+#include <vector>
+#include "opencv2/opencv.hpp"
+#include "detector.hpp"
+#include "frame_pool.hpp"
+#include "stage_stats.hpp"
+
+/*
+	Options of the confirm stage.
+
+	gateClasses:    COCO class ids that trigger the confirm model, empty for
+	                every class
+	gateThreshold:  Minimum score of a gate detection that triggers the
+	                confirm model
+	crops:          0 runs the confirm model on the whole frame, N > 0 on up
+	                to N crops around the strongest gate detections
+	scoreThreshold: Minimum score of confirmed detections
+*/
+struct CascadeOptions {
+  std::vector<int> gateClasses;
+  float            gateThreshold  = 0.5f;
+  int              crops          = 0;
+  float            scoreThreshold = 0.3f;
+};
+
+
+/*
+	Second stage of a two-model cascade. A cheap gate model (ie. lite0) runs on
+	every frame; only frames where it finds one of the gate classes are passed
+	to the larger confirm model (ie. lite3), either whole or as crops around
+	the gate's boxes. Empty frames therefore cost one gate inference only.
+
+	confirm: Detector of the confirm model, batch size 1
+	options: Cascade settings
+*/
+class Cascade {
+public:
+  Cascade(Detector& confirm, const CascadeOptions& options);
+
+  /*
+		Check the gate detections of one frame and run the confirm model if
+		the frame is flagged.
+
+		gate:        Detector the outputs come from
+		gateOutputs: Outputs of the frame from getOutputVectors()
+		image:       Index of the frame within the gate's batch
+		frame:       The frame, at any resolution
+		rgb:         True if frame is RGB, false for BGR
+		confirmed:   Filled with the confirm model's detections, normalized to
+		             frame
+
+		Returns true if the frame was flagged and confirmed holds the result.
+	*/
+  bool process(const Detector& gate, const std::vector<std::vector<float>>& gateOutputs, int image,
+               const cv::Mat& frame, bool rgb, std::vector<Detection>& confirmed);
+
+  // Prints flagged frames, crops and confirm inference timings
+  void printStats() const;
+
+private:
+  bool gateMatches(const Detection& detection) const;
+  void runConfirm(const cv::Mat& region, bool rgb, std::vector<Detection>& detections);
+
+  Detector&      confirmDetector;
+  CascadeOptions cascadeOptions;
+  FramePool      scaledPool;
+  StageStats     confirmStats;
+
+  std::vector<std::vector<float>> outputs;
+  std::vector<Detection>          gateDetections;
+  std::vector<Detection>          regionDetections;
+
+  uint64_t frames  = 0;
+  uint64_t flagged = 0;
+  uint64_t crops   = 0;
+};
+
+
+/*
+	Draw normalized detections into an image of any resolution.
+*/
+void drawDetections(const std::vector<Detection>& detections, cv::Mat& image);
+
+#endif
@@ -0,0 +1,83 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include "efficientdet_utils.hpp"
+#include "crop_batch.hpp"
+
+float intersectionOverUnion(const Detection& a, const Detection& b)
+{
+  float w = std::min(a.xmax, b.xmax) - std::max(a.xmin, b.xmin);
+  float h = std::min(a.ymax, b.ymax) - std::max(a.ymin, b.ymin);
+  if(w <= 0 || h <= 0){
+    return 0;
+  }
+
+  float intersection = w * h;
+  float areaA = (a.xmax - a.xmin) * (a.ymax - a.ymin);
+  float areaB = (b.xmax - b.xmin) * (b.ymax - b.ymin);
+  return intersection / (areaA + areaB - intersection);
+}
+
+cv::Rect squareCropAround(const Detection& detection, cv::Size frameSize, float margin, int minSide)
+{
+  float cx   = (detection.xmin + detection.xmax) / 2 * frameSize.width;
+  float cy   = (detection.ymin + detection.ymax) / 2 * frameSize.height;
+  float side = std::max((detection.xmax - detection.xmin) * frameSize.width,
+                        (detection.ymax - detection.ymin) * frameSize.height) * (1 + 2 * margin);
+
+  int s = std::min({std::max(static_cast<int>(side), minSide), frameSize.width, frameSize.height});
+  int x = std::min(std::max(static_cast<int>(cx - s / 2.0f), 0), frameSize.width - s);
+  int y = std::min(std::max(static_cast<int>(cy - s / 2.0f), 0), frameSize.height - s);
+
+  return cv::Rect(x, y, s, s);
+}
+
+CropBatch::CropBatch(Detector& detector)
+  : cropDetector(detector),
+    scaledPool("crop", cv::Size(detector.resolution, detector.resolution), CV_8UC3, 1)
+{
+}
+
+std::chrono::microseconds CropBatch::run(const cv::Mat& frame, const std::vector<cv::Rect>& regions,
+                                         float threshold, std::vector<std::vector<Detection>>& detections)
+{
+  int    res        = cropDetector.resolution;
+  size_t slotBytes  = static_cast<size_t>(res) * res * 3;
+  int    count      = std::min<int>(regions.size(), capacity());
+  uint8_t* input    = reinterpret_cast<uint8_t*>(cropDetector.inTensor->data.raw);
+
+  FrameBuffer scaled = scaledPool.acquire();
+
+  // Slots past count keep stale regions, their outputs are ignored
+  for(int i = 0; i < count; i++){
+    cv::Mat slot(res, res, CV_8UC3, input + i * slotBytes);
+    cv::resize(frame(regions[i]), scaled.mat, scaled.mat.size(), 0, 0, cv::INTER_CUBIC);
+    cv::cvtColor(scaled.mat, slot, cv::COLOR_BGR2RGB);
+  }
+
+  std::chrono::microseconds duration = timedInference(cropDetector.interpreter.get());
+
+  getOutputVectors(cropDetector.outTensor, outputRows(cropDetector) * cropDetector.batch,
+                   outputValues(cropDetector), outputs);
+  splitBatchOutputs(cropDetector, outputs, count, regionOutputs);
+
+  detections.resize(count);
+  for(int i = 0; i < count; i++){
+    readDetections(cropDetector, regionOutputs[i], threshold, detections[i], i);
+
+    // Back from region to frame coordinates
+    const cv::Rect& region = regions[i];
+    for(Detection& detection : detections[i]){
+      detection.xmin  = (region.x + detection.xmin * region.width)  / frame.cols;
+      detection.xmax  = (region.x + detection.xmax * region.width)  / frame.cols;
+      detection.ymin  = (region.y + detection.ymin * region.height) / frame.rows;
+      detection.ymax  = (region.y + detection.ymax * region.height) / frame.rows;
+      detection.image = 0;
+    }
+  }
+
+  return duration;
+}
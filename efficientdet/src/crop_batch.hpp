@@ -0,0 +1,65 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef CROP_BATCH
+#define CROP_BATCH
+
+#include <chrono>
+#include <vector>
+#include "opencv2/opencv.hpp"
+#include "detector.hpp"
+#include "frame_pool.hpp"
+
+/*
+	Intersection over union of two normalized detections.
+*/
+float intersectionOverUnion(const Detection& a, const Detection& b);
+
+
+/*
+	Square crop in pixels around a normalized box, grown by margin (a fraction
+	of the box size on every side), at least minSide pixels wide and moved
+	inside the frame.
+*/
+cv::Rect squareCropAround(const Detection& detection, cv::Size frameSize, float margin, int minSide);
+
+
+/*
+	Runs one detector on several regions of a frame with a single batched
+	Invoke(). Every region is resized to the model resolution and packed into
+	its own slot of the input tensor; the detections of every region are
+	mapped back to normalized frame coordinates.
+
+	detector: Detector with a batch size of the largest number of regions per
+	          call, see resizeBatch()
+*/
+class CropBatch {
+public:
+  explicit CropBatch(Detector& detector);
+
+  int capacity() const   { return cropDetector.batch; }
+  int resolution() const { return cropDetector.resolution; }
+
+  /*
+		frame:      BGR frame
+		regions:    Regions of frame in pixels, at most capacity()
+		threshold:  Minimum score of returned detections
+		detections: Filled with the detections of every region, normalized to
+		            frame
+
+		Returns the inference time.
+	*/
+  std::chrono::microseconds run(const cv::Mat& frame, const std::vector<cv::Rect>& regions, float threshold,
+                                std::vector<std::vector<Detection>>& detections);
+
+private:
+  Detector& cropDetector;
+  FramePool scaledPool;
+
+  std::vector<std::vector<float>>              outputs;
+  std::vector<std::vector<std::vector<float>>> regionOutputs;
+};
+
+#endif
@@ -0,0 +1,108 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include "detection_sink.hpp"
+
+namespace {
+
+bool endsWith(const std::string& str, const std::string& suffix)
+{
+  return str.size() >= suffix.size() &&
+         str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Minimal escaping for paths inside JSON strings
+std::string jsonEscape(const std::string& str)
+{
+  std::string res;
+
+  for(auto c : str){
+    if(c == '"' || c == '\\'){
+      res.push_back('\\');
+    }
+    res.push_back(c);
+  }
+
+  return res;
+}
+
+}
+
+FileDetectionSink::FileDetectionSink(const std::string& path)
+  : csv(endsWith(path, ".csv"))
+{
+  file = (path == "-") ? stdout : fopen(path.c_str(), "w");
+
+  if(file && csv){
+    fprintf(file, "source,frame,label,score,ymin,xmin,ymax,xmax\n");
+  }
+}
+
+FileDetectionSink::~FileDetectionSink()
+{
+  if(file && file != stdout){
+    fclose(file);
+  }
+  else if(file){
+    fflush(file);
+  }
+}
+
+void FileDetectionSink::write(const std::string& source, int frame, const std::vector<Detection>& detections)
+{
+  std::lock_guard<std::mutex> guard(lock);
+
+  if(!file){
+    return;
+  }
+
+  if(csv){
+    for(const Detection& d : detections){
+      fprintf(file, "%s,%d,%d,%.4f,%.4f,%.4f,%.4f,%.4f\n",
+              source.c_str(), frame, d.label, d.score, d.ymin, d.xmin, d.ymax, d.xmax);
+    }
+    return;
+  }
+
+  fprintf(file, "{\"source\":\"%s\",\"frame\":%d,\"detections\":[", jsonEscape(source).c_str(), frame);
+
+  for(size_t i = 0; i < detections.size(); i++){
+    const Detection& d = detections[i];
+    fprintf(file, "%s{\"label\":%d,\"score\":%.4f,\"box\":[%.4f,%.4f,%.4f,%.4f]}",
+            i ? "," : "", d.label, d.score, d.ymin, d.xmin, d.ymax, d.xmax);
+  }
+
+  fprintf(file, "]}\n");
+}
+
+void FileDetectionSink::flush()
+{
+  std::lock_guard<std::mutex> guard(lock);
+
+  if(file){
+    fflush(file);
+  }
+}
+
+void MemoryDetectionSink::write(const std::string& source, int frame, const std::vector<Detection>& detections)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  records.push_back({source, frame, detections});
+}
+
+void MemoryDetectionSink::replay(DetectionSink& sink) const
+{
+  std::lock_guard<std::mutex> guard(lock);
+
+  for(const Record& record : records){
+    sink.write(record.source, record.frame, record.detections);
+  }
+}
+
+size_t MemoryDetectionSink::size() const
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return records.size();
+}
@@ -0,0 +1,81 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef DETECTION_SINK
+#define DETECTION_SINK
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "detector.hpp"
+
+/*
+	Destination for structured detection results. Implementations are safe to
+	use from several threads.
+*/
+class DetectionSink {
+public:
+  virtual ~DetectionSink() = default;
+
+  /*
+		source:     Input the detections belong to (video file, image path, ...)
+		frame:      Frame index within source, 0 for still images
+		detections: Detections of that frame
+	*/
+  virtual void write(const std::string& source, int frame, const std::vector<Detection>& detections) = 0;
+
+  virtual void flush() {}
+};
+
+
+/*
+	Writes detections to a file, or to stdout for "-". Paths ending in .csv get
+	one row per detection, everything else gets one JSON object per frame
+	(JSON lines).
+*/
+class FileDetectionSink : public DetectionSink {
+public:
+  explicit FileDetectionSink(const std::string& path);
+  ~FileDetectionSink() override;
+
+  bool isOpened() const { return file != nullptr; }
+
+  void write(const std::string& source, int frame, const std::vector<Detection>& detections) override;
+  void flush() override;
+
+private:
+  std::mutex lock;
+  FILE*      file = nullptr;
+  bool       csv  = false;
+};
+
+
+/*
+	Keeps detections in memory, so results produced out of order (ie. by
+	parallel segments) can be replayed into another sink in order.
+*/
+class MemoryDetectionSink : public DetectionSink {
+public:
+  void write(const std::string& source, int frame, const std::vector<Detection>& detections) override;
+
+  // Writes every stored frame to sink in the order they were received
+  void replay(DetectionSink& sink) const;
+
+  size_t size() const;
+
+private:
+  struct Record {
+    std::string            source;
+    int                    frame;
+    std::vector<Detection> detections;
+  };
+
+  mutable std::mutex  lock;
+  std::vector<Record> records;
+};
+
+#endif
@@ -0,0 +1,284 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <cstring>
+#include <iostream>
+#include "tensorflow/lite/interpreter.h"
+#include "tensorflow/lite/kernels/register.h"
+#include "tensorflow/lite/model.h"
+#include "tensorflow/lite/delegates/nnapi/nnapi_delegate.h"
+#include "tensorflow/lite/tools/evaluation/utils.h"
+#include "tensorflow/lite/delegates/external/external_delegate.h"
+#include "efficientdet_utils.hpp"
+#include "detector.hpp"
+#include "memory_usage.hpp"
+
+// 'make MINIMAL_RESOLVER=1' registers only the kernels of the supported
+// models, see gen_op_resolver.py
+#ifdef EFFICIENTDET_MINIMAL_RESOLVER
+#include "minimal_op_resolver.hpp"
+typedef MinimalOpResolver DetectorOpResolver;
+#else
+typedef tflite::ops::builtin::BuiltinOpResolver DetectorOpResolver;
+#endif
+
+std::shared_ptr<tflite::FlatBufferModel> loadModel(const std::string& modelFile)
+{
+  std::shared_ptr<tflite::FlatBufferModel> model =
+      tflite::FlatBufferModel::BuildFromFile(modelFile.c_str());
+
+  if(!model){
+    std::cout << "Failed to load model " << modelFile << std::endl;
+  }
+
+  return model;
+}
+
+std::unique_ptr<tflite::Interpreter> buildInterpreter(const tflite::FlatBufferModel& model,
+                                                      const DetectorOptions& options,
+                                                      size_t* delegateBytes)
+{
+  DetectorOpResolver resolver;
+  tflite::InterpreterBuilder builder(model, resolver);
+  std::unique_ptr<tflite::Interpreter> interpreter;
+  builder(&interpreter);
+
+  if(!interpreter){
+    std::cout << "Failed to build interpreter." << std::endl;
+    return nullptr;
+  }
+
+  // Set before the thread count, which is applied to the shared context
+  if(options.cpuBackend){
+    interpreter->SetExternalContext(kTfLiteCpuBackendContext, options.cpuBackend.get());
+  }
+
+  interpreter->SetNumThreads(options.numThreads);
+
+  interpreter->SetAllowFp16PrecisionForFp32(true);
+
+  size_t residentBefore = residentBytes();
+
+  if (toUpperCase(options.backend) == std::string("NNAPI")){
+    tflite::StatefulNnApiDelegate::Options nnapiOptions;
+    auto delegate = tflite::evaluation::CreateNNAPIDelegate(nnapiOptions);
+    if (!delegate) {
+      std::cout << "NNAPI acceleration is unsupported on this platform." << std::endl;
+    } else {
+      std::cout << "Use NNAPI acceleration." << std::endl;
+    }
+
+    if (interpreter->ModifyGraphWithDelegate(std::move(delegate)) !=
+        kTfLiteOk) {
+      std::cout << "Failed to apply NNAPI delegate." << std::endl;
+      return nullptr;
+    }
+  }
+
+  else if(toUpperCase(options.backend) == std::string("VX")){
+    // The interpreter owns the delegate, so every interpreter gets its own
+    // instance and the delegate is removed together with the interpreter
+    TfLiteExternalDelegateOptions extDelegateOptions =
+        TfLiteExternalDelegateOptionsDefault(options.delegatePath.c_str());
+    tflite::Interpreter::TfLiteDelegatePtr delegate(
+        TfLiteExternalDelegateCreate(&extDelegateOptions), TfLiteExternalDelegateDelete);
+
+    if(!delegate){
+      std::cout << "VX acceleration failed to initialize." << std::endl;
+      std::cout << "Failed to apply VX delegate." << std::endl;
+    }
+    else{
+      std::cout << "VX acceleration enabled." << std::endl;
+
+      if(interpreter->ModifyGraphWithDelegate(std::move(delegate)) != kTfLiteOk){
+        std::cout << "Failed to apply VX delegate." << std::endl;
+      }
+    }
+  }
+
+  if(delegateBytes){
+    size_t residentAfter = residentBytes();
+    *delegateBytes = residentAfter > residentBefore ? residentAfter - residentBefore : 0;
+  }
+
+  // Allocate tensor buffers.
+  if(interpreter->AllocateTensors() != kTfLiteOk){
+    std::cout << "Failed to allocate tensors." << std::endl;
+    return nullptr;
+  }
+
+  return interpreter;
+}
+
+bool loadDetector(const std::string& modelFile, const DetectorOptions& options, Detector& detector,
+                  std::shared_ptr<tflite::FlatBufferModel> model)
+{
+  detector.modelFile  = modelFile;
+  detector.resolution = parseModelRes(modelFile);
+  detector.keras      = parseKerasModel(modelFile);
+
+  if(detector.resolution < 0){
+    return false;
+  }
+
+  detector.model = model ? model : loadModel(modelFile);
+  if(!detector.model){
+    return false;
+  }
+
+  detector.interpreter = buildInterpreter(*detector.model, options, &detector.delegateBytes);
+  if(!detector.interpreter){
+    return false;
+  }
+
+  detector.inTensor  = detector.interpreter->input_tensor(0);
+  detector.outTensor = detector.interpreter->output_tensor(0);
+
+  return true;
+}
+
+bool warmUpDetector(Detector& detector, int runs)
+{
+  // Zeros are a valid image for every input type, results are discarded
+  memset(detector.inTensor->data.raw, 0, detector.inTensor->bytes);
+
+  for(int i = 0; i < runs; i++){
+    if(detector.interpreter->Invoke() != kTfLiteOk){
+      std::cout << "Warm-up of " << detector.modelFile << " failed." << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool bindInputBuffer(Detector& detector, void* data, size_t bytes)
+{
+  int index = detector.interpreter->inputs()[0];
+  bool first = detector.inTensor->allocation_type != kTfLiteCustom;
+
+  TfLiteCustomAllocation allocation{data, bytes};
+  if(detector.interpreter->SetCustomAllocationForTensor(index, allocation) != kTfLiteOk){
+    return false;
+  }
+
+  // The arena no longer holds the input, plan the allocations again once
+  if(first){
+    if(detector.interpreter->AllocateTensors() != kTfLiteOk){
+      std::cout << "Failed to allocate tensors." << std::endl;
+      return false;
+    }
+    detector.inTensor  = detector.interpreter->input_tensor(0);
+    detector.outTensor = detector.interpreter->output_tensor(0);
+  }
+
+  return true;
+}
+
+bool resizeBatch(Detector& detector, int batch)
+{
+  int index = detector.interpreter->inputs()[0];
+  std::vector<int> dims = {batch, detector.resolution, detector.resolution, 3};
+
+  if(detector.interpreter->ResizeInputTensor(index, dims) != kTfLiteOk ||
+     detector.interpreter->AllocateTensors() != kTfLiteOk){
+    std::cout << "Failed to resize the input tensor to a batch of " << batch << std::endl;
+    return false;
+  }
+
+  detector.batch     = batch;
+  detector.inTensor  = detector.interpreter->input_tensor(0);
+  detector.outTensor = detector.interpreter->output_tensor(0);
+
+  return true;
+}
+
+int outputValues(const Detector& detector)
+{
+  return detector.keras ? 4 : 7;
+}
+
+int outputRows(const Detector& detector)
+{
+  return static_cast<int>(detector.outTensor->bytes / sizeof(float) / outputValues(detector) / detector.batch);
+}
+
+void splitBatchOutputs(const Detector& detector, const std::vector<std::vector<float>>& outputs,
+                       int images, std::vector<std::vector<std::vector<float>>>& perImage)
+{
+  int rows = static_cast<int>(outputs.size()) / detector.batch;
+
+  perImage.resize(images);
+  for(auto& image : perImage){
+    image.clear();
+  }
+
+  for(size_t i = 0; i < outputs.size(); i++){
+    int image = static_cast<int>(i) / rows;
+
+    if(!detector.keras){
+      int column = static_cast<int>(outputs[i][0]);
+      if(column >= 0 && column < detector.batch){
+        image = column;
+      }
+    }
+
+    if(image < images){
+      perImage[image].push_back(outputs[i]);
+    }
+  }
+}
+
+void readDetections(const Detector& detector, const std::vector<std::vector<float>>& outputs,
+                    float threshold, std::vector<Detection>& detections, int image)
+{
+  detections.clear();
+
+  // Keras-converted models only put boxes into the first output. Classes and
+  // scores follow in the next outputs (boxes, classes, scores, count).
+  const float* classes = nullptr;
+  const float* scores  = nullptr;
+  if(detector.keras && detector.interpreter->outputs().size() >= 3){
+    int offset = image * outputRows(detector);
+    classes = detector.interpreter->output_tensor(1)->data.f + offset;
+    scores  = detector.interpreter->output_tensor(2)->data.f + offset;
+  }
+
+  for(size_t i = 0; i < outputs.size(); i++){
+    const std::vector<float>& vec = outputs[i];
+
+    if(i > 0 && vec == outputs[i-1]){
+      continue;
+    }
+
+    Detection detection;
+
+    if(detector.keras){
+      detection.image = image;
+      detection.ymin  = vec[0];
+      detection.xmin  = vec[1];
+      detection.ymax  = vec[2];
+      detection.xmax  = vec[3];
+      detection.score = scores  ? scores[i] : 1.0f;
+      detection.label = classes ? static_cast<int>(classes[i]) : -1;
+    }
+
+    else{
+      float scale = 1.0f / detector.resolution;
+
+      detection.image = static_cast<int>(vec[0]);
+      detection.ymin  = vec[1] * scale;
+      detection.xmin  = vec[2] * scale;
+      detection.ymax  = vec[3] * scale;
+      detection.xmax  = vec[4] * scale;
+      detection.score = vec[5];
+      detection.label = static_cast<int>(vec[6]);
+    }
+
+    if(detection.score >= threshold){
+      detections.push_back(detection);
+    }
+  }
+}
@@ -0,0 +1,176 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef DETECTOR
+#define DETECTOR
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "tensorflow/lite/external_cpu_backend_context.h"
+#include "tensorflow/lite/interpreter.h"
+#include "tensorflow/lite/model.h"
+
+/*
+	How interpreters are built.
+
+	backend:      CPU, NNAPI or VX (case-insensitive)
+	delegatePath: Path to the external delegate library, used with VX
+	numThreads:   Number of threads of each interpreter
+	cpuBackend:   CPU backend context (thread pool and GEMM scratch) shared by
+	              every interpreter built with these options, nullptr gives
+	              each interpreter its own. Interpreters sharing a context must
+	              not be invoked at the same time.
+*/
+struct DetectorOptions {
+  std::string backend      = "CPU";
+  std::string delegatePath;
+  int         numThreads   = 4;
+  std::shared_ptr<tflite::ExternalCpuBackendContext> cpuBackend;
+};
+
+
+/*
+	An EfficientDet model together with a ready-to-invoke interpreter. Several
+	detectors may share one FlatBufferModel, each owns its interpreter.
+
+	batch:         Number of images per Invoke(), see resizeBatch()
+	delegateBytes: Growth of the resident set while the delegate was applied,
+	               an estimate of the delegate's own memory. Anything else
+	               allocating at the same time (other interpreters, opening
+	               the input and output) disturbs the measurement.
+*/
+struct Detector {
+  std::string modelFile;
+  int         resolution    = -1;
+  bool        keras         = false;
+  int         batch         = 1;
+  size_t      delegateBytes = 0;
+
+  std::shared_ptr<tflite::FlatBufferModel> model;
+  std::unique_ptr<tflite::Interpreter>     interpreter;
+
+  TfLiteTensor* inTensor  = nullptr;
+  TfLiteTensor* outTensor = nullptr;
+};
+
+
+/*
+	A single detection with coordinates normalized to 0-1.
+
+	image: Index of the image within a batch
+	label: COCO class id, -1 if the model does not provide it
+*/
+struct Detection {
+  int   image;
+  float ymin;
+  float xmin;
+  float ymax;
+  float xmax;
+  float score;
+  int   label;
+};
+
+
+/*
+	Load a .tflite file. Returns nullptr on failure.
+*/
+std::shared_ptr<tflite::FlatBufferModel> loadModel(const std::string& modelFile);
+
+
+/*
+	Build an interpreter for model, apply the selected delegate and allocate
+	tensors. The resident set growth while applying the delegate is stored in
+	delegateBytes if not nullptr. Returns nullptr on failure.
+*/
+std::unique_ptr<tflite::Interpreter> buildInterpreter(const tflite::FlatBufferModel& model,
+                                                      const DetectorOptions& options,
+                                                      size_t* delegateBytes = nullptr);
+
+
+/*
+	Prepare detector for modelFile. The resolution and output format are parsed
+	from the model name.
+
+	modelFile: Path to the EfficientDet model
+	options:   Interpreter options
+	detector:  Detector to be filled
+	model:     Already loaded model to share, loaded from modelFile when nullptr
+
+	Returns false on failure.
+*/
+bool loadDetector(const std::string& modelFile, const DetectorOptions& options, Detector& detector,
+                  std::shared_ptr<tflite::FlatBufferModel> model = nullptr);
+
+
+/*
+	Invoke the interpreter runs times on whatever the input tensor holds, so
+	lazy kernel preparation, weight packing and delegate compilation happen
+	before the first real frame.
+
+	Returns false if an Invoke() fails.
+*/
+bool warmUpDetector(Detector& detector, int runs);
+
+
+/*
+	Make data the input tensor's buffer instead of copying into the arena, using
+	Interpreter::SetCustomAllocationForTensor. data must be aligned to 64 bytes
+	(kDefaultTensorAlignment), stay valid until the next Invoke() returns and
+	hold at least bytes bytes. The first call re-plans the tensor allocations.
+	Input tensors consumed by a delegate may not support custom allocations.
+
+	Returns false on failure.
+*/
+bool bindInputBuffer(Detector& detector, void* data, size_t bytes);
+
+
+/*
+	Resize the input tensor to [batch, H, W, 3] and allocate tensors again.
+	Images are packed back to back into the input tensor. Delegates that only
+	support static shapes may refuse the resize.
+
+	Returns false on failure.
+*/
+bool resizeBatch(Detector& detector, int batch);
+
+
+/*
+	Number of values per detection row (7, or 4 for Keras-converted models)
+	and number of rows per image in the first output tensor.
+*/
+int outputValues(const Detector& detector);
+int outputRows(const Detector& detector);
+
+
+/*
+	Split the outputs of a batched Invoke() into one set of rows per image.
+	Rows of the 7-value layout are assigned by their image index column,
+	Keras-converted outputs by position.
+
+	detector: Detector the outputs come from
+	outputs:  Outputs of the whole batch from getOutputVectors()
+	images:   Number of images actually packed into the batch
+	perImage: Filled with the rows of every image, empty for images without
+	          rows
+*/
+void splitBatchOutputs(const Detector& detector, const std::vector<std::vector<float>>& outputs,
+                       int images, std::vector<std::vector<std::vector<float>>>& perImage);
+
+
+/*
+	Convert raw outputs from getOutputVectors() into normalized detections with
+	a score of at least threshold. Consecutive duplicates (padding) are skipped.
+
+	detector:   Detector the outputs come from
+	outputs:    Outputs of one image from getOutputVectors()
+	threshold:  Minimum score
+	detections: Vector to be filled
+	image:      Index of the image within the batch
+*/
+void readDetections(const Detector& detector, const std::vector<std::vector<float>>& outputs,
+                    float threshold, std::vector<Detection>& detections, int image = 0);
+
+#endif
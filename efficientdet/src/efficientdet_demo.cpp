@@ -3,63 +3,366 @@
 * SPDX-License-Identifier: Apache-2.0
 */
 
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
 #include <cstdint>
 #include <cstddef>
 #include <cstring>
+#include <exception>
 #include <iostream>
 #include <vector>
 #include <fstream>
+#include <future>
 #include <sstream>
 #include <experimental/filesystem>
-#include "tensorflow/lite/interpreter.h"
-#include "tensorflow/lite/kernels/register.h"
-#include "tensorflow/lite/model.h"
-#include "tensorflow/lite/delegates/nnapi/nnapi_delegate.h"
-#include "tensorflow/lite/tools/delegates/delegate_provider.h"
-#include "tensorflow/lite/tools/evaluation/utils.h"
-#include "tensorflow/lite/delegates/external/external_delegate.h"
 #include "opencv2/opencv.hpp"
 #include "efficientdet_utils.hpp"
+#include "attention_scheduler.hpp"
+#include "cascade.hpp"
+#include "detection_sink.hpp"
+#include "detector.hpp"
+#include "frame_pool.hpp"
+#include "image_batch.hpp"
+#include "latest_frame_source.hpp"
+#include "memory_usage.hpp"
+#include "model_reloader.hpp"
+#include "pipeline.hpp"
+#include "quality_controller.hpp"
+#include "segment_runner.hpp"
+#include "shm_source.hpp"
+#include "stream_list.hpp"
+#include "stream_runner.hpp"
+#include "tensor_cache.hpp"
+#include "thread_placement.hpp"
+#include "tile_scheduler.hpp"
+#include "video_sink.hpp"
+#include "video_source.hpp"
+#include "worker_pool.hpp"
 #include "cxxopts.hpp"
 
 int main(int argc, char* argv[]) {
 
-  std::string modelFile;
-  std::string videoFile;
-  std::string backend;
-  std::string delegatePath;
+  auto processStart = std::chrono::steady_clock::now();
+
+  std::string     modelFile;
+  std::string     videoFile;
+  std::string     captureMode;
+  std::string     detectionsFile;
+  DetectorOptions detectorOptions;
+  PipelineOptions pipelineOptions;
+  SinkOptions     sinkOptions;
+  SegmentOptions  segmentOptions;
+  bool            buildCache = false;
+  std::string     cacheFile;
+  int             repeat = 1;
+  std::string     imagesPath;
+  ImageBatchOptions imageOptions;
+  std::string     shmResults;
+  SourceOptions   sourceOptions;
+  int             batch = 1;
+  std::vector<std::string> variantFiles;
+  QualityOptions  qualityOptions;
+  std::string     confirmFile;
+  CascadeOptions  cascadeOptions;
+  AttentionOptions attentionOptions;
+  int             attentionCrops = 4;
+  bool            tilesMode = false;
+  TileOptions     tileOptions;
+  int             tileBatch = 4;
+  bool            hotSwap = false;
+  ReloadOptions   reloadOptions;
+  int             warmup = 1;
+  size_t          memoryBudget = 0;
+  std::string     streamList;
+  std::string     streamManifest;
+  StreamRunnerOptions streamRunnerOptions;
+  ThreadPlacement placement;
+  bool            cpuUsage = false;
+  WorkerPoolOptions workerOptions;
 
   try{  
     cxxopts::Options appOptions("EfficientDet detection example", "Example object detection using EfficientDet on an input video file.");
 
     appOptions.add_options()
     ("m,model", "Path to EfficientDet model", cxxopts::value<std::string>()->default_value(""))
-    ("i,input", "Path to input video file", cxxopts::value<std::string>()->default_value(""))
+    ("i,input", "Path to input video file or synthetic:WxH:N", cxxopts::value<std::string>()->default_value(""))
     ("b,backend", "Backend to use for inference (CPU, NNAPI, ...)", cxxopts::value<std::string>()->default_value("CPU"))
     ("d,delegate", "Path to external delegate (ie. VX)", cxxopts::value<std::string>()->default_value(""))
+    ("threads", "Number of interpreter threads", cxxopts::value<int>()->default_value("4"))
+    ("capture", "Input decode path (opencv, gst-scaled, gst-tee)", cxxopts::value<std::string>()->default_value("opencv"))
+    ("writer-queue", "Number of finished frames queued for the encoder thread", cxxopts::value<int>()->default_value("4"))
+    ("writer-drop", "Drop frames instead of waiting when the encoder queue is full")
+    ("o,output", "Output file, GStreamer pipeline or '-' for stdout", cxxopts::value<std::string>()->default_value("out.avi"))
+    ("sink", "Output sink (gst, gst-pipeline, ffmpeg, mjpeg, y4m, null)", cxxopts::value<std::string>()->default_value("gst"))
+    ("codec", "Fourcc of the encoder for gst and ffmpeg sinks", cxxopts::value<std::string>()->default_value("mp4v"))
+    ("preset", "FFmpeg encoder speed preset (ultrafast ... veryslow)", cxxopts::value<std::string>()->default_value(""))
+    ("quality", "FFmpeg CRF or MJPEG quality, -1 keeps the encoder default", cxxopts::value<int>()->default_value("-1"))
+    ("detections", "Write detections to a .csv or JSON lines file", cxxopts::value<std::string>()->default_value(""))
+    ("score-threshold", "Minimum score of written detections", cxxopts::value<float>()->default_value("0.3"))
+    ("segments", "Split the input into N segments processed in parallel", cxxopts::value<int>()->default_value("1"))
+    ("keyframe-interval", "GOP length of the input, segment boundaries are aligned to it", cxxopts::value<int>()->default_value("0"))
+    ("segment-video", "Write video in segment mode (chunks are stitched in order)")
+    ("keep-segments", "Keep the per-segment video chunks")
+    ("build-cache", "Decode the input once into a tensor cache and exit")
+    ("cache-file", "Tensor cache to write with --build-cache", cxxopts::value<std::string>()->default_value(""))
+    ("repeat", "Number of passes over a tensor cache (-i cache:<file>)", cxxopts::value<int>()->default_value("1"))
+    ("images", "Process a directory or manifest of images instead of a video", cxxopts::value<std::string>()->default_value(""))
+    ("decoders", "Number of image decoder threads", cxxopts::value<int>()->default_value("2"))
+    ("full-decode", "Always decode images at full resolution")
+    ("shm-results", "Write detections to a shared-memory ring (with -i shm:<name>)", cxxopts::value<std::string>()->default_value(""))
+    ("input-format", "Format of stdin / pipe input (y4m, rgb24, bgr24)", cxxopts::value<std::string>()->default_value("y4m"))
+    ("input-size", "Frame size of raw stdin / pipe input, WxH", cxxopts::value<std::string>()->default_value(""))
+    ("input-fps", "Frame rate of raw stdin / pipe input", cxxopts::value<double>()->default_value("30"))
+    ("realtime", "Process only the newest input frame, drop frames detection is too slow for")
+    ("batch", "Number of frames per inference", cxxopts::value<int>()->default_value("1"))
+    ("copy-input", "Copy the model input into the input tensor instead of binding the tensor to it")
+    ("models", "Comma-separated model variants to switch between", cxxopts::value<std::string>()->default_value(""))
+    ("target-fps", "Frame rate held by switching between --models", cxxopts::value<double>()->default_value("0"))
+    ("target-latency", "Frame time in ms held by switching between --models", cxxopts::value<double>()->default_value("0"))
+    ("cascade", "Larger model confirming the frames the main model flags", cxxopts::value<std::string>()->default_value(""))
+    ("gate-classes", "Comma-separated COCO class ids that trigger the cascade, empty for all", cxxopts::value<std::string>()->default_value(""))
+    ("gate-threshold", "Minimum score of detections that trigger the cascade", cxxopts::value<float>()->default_value("0.5"))
+    ("cascade-crops", "Confirm up to N crops around the flagged boxes instead of the whole frame", cxxopts::value<int>()->default_value("0"))
+    ("attention-interval", "Full-frame inference every N frames, crops around tracked objects in between", cxxopts::value<int>()->default_value("0"))
+    ("attention-crops", "Maximum number of crops per frame between full-frame passes", cxxopts::value<int>()->default_value("4"))
+    ("tiles", "Infer only the model-sized tiles of the frame that changed")
+    ("tile-threshold", "Mean gray level difference that marks a tile as changed", cxxopts::value<double>()->default_value("4"))
+    ("tile-refresh", "Re-infer static tiles after N frames, 0 for never", cxxopts::value<int>()->default_value("300"))
+    ("tile-batch", "Number of tiles per inference", cxxopts::value<int>()->default_value("4"))
+    ("warmup", "Number of warm-up inferences before the first frame", cxxopts::value<int>()->default_value("1"))
+    ("memory-budget", "Memory in MiB the interpreters and frame buffers may use, 0 for no limit", cxxopts::value<int>()->default_value("0"))
+    ("streams", "Comma-separated inputs processed as separate streams", cxxopts::value<std::string>()->default_value(""))
+    ("stream-list", "File with one input stream per line", cxxopts::value<std::string>()->default_value(""))
+    ("workers", "Process the streams in N crash-isolated worker processes", cxxopts::value<int>()->default_value("0"))
+    ("interpreters", "Number of interpreters shared by the streams of this process", cxxopts::value<int>()->default_value("2"))
+    ("pool-threads", "Number of threads decoding and encoding the streams of this process", cxxopts::value<int>()->default_value("2"))
+    ("scheduler", "Scheduling of the pool threads (fair, steal)", cxxopts::value<std::string>()->default_value("fair"))
+    ("affinity", "CPUs per thread role, ie. 'capture=0;preprocess=1;interpreter=2-5;encoder=1'", cxxopts::value<std::string>()->default_value(""))
+    ("sched", "Scheduling policy per thread role, ie. 'interpreter=fifo:10;encoder=batch'", cxxopts::value<std::string>()->default_value(""))
+    ("cpu-usage", "Report the utilization of every core at the end")
+    ("hot-swap", "Reload the model without stopping when its file changes or on SIGHUP")
+    ("control-socket", "Unix socket accepting 'reload [model path]' commands", cxxopts::value<std::string>()->default_value(""))
     ("h,help", "Display help message");
 
-    std::cout << "EfficientDet detection example" << std::endl;
-    std::cout << "==============================" << std::endl;
-
     auto parsedOptions = appOptions.parse(argc, argv);
 
     if(parsedOptions.count("help")){
       std::cout << "A simple demo showcasing the use of EfficientDet model on an input file." << std::endl;
       std::cout << "Please provide the following arguments:" << std::endl;
       std::cout << "-m / --model    : Path to EfficientDet model" << std::endl;
-      std::cout << "-i / --input    : Path to input video file to be processed" << std::endl << std::endl;
+      std::cout << "-i / --input    : Path to input video file to be processed, 'synthetic:WxH:N' for N generated" << std::endl;
+      std::cout << "                  frames of size WxH (no input file needed), or 'shm:/name' for frames from a" << std::endl;
+      std::cout << "                  shared-memory ring filled by another process (see shm_producer). '-', 'pipe:<path>' or" << std::endl;
+      std::cout << "                  the path of a FIFO read uncompressed frames, see --input-format" << std::endl << std::endl;
       std::cout << "OPTIONAL ARGUMENTS" << std::endl;
       std::cout << "-b / --backend  : Specify which backend you wish to use (CPU, VX, NNAPI). Default is 'CPU'" << std::endl;
       std::cout << "-d / --delegate : Only used when VX backend is chosen. Provide path to 'vx_delegate' shared library." << std::endl;
+      std::cout << "--threads       : Number of interpreter threads. Default is 4" << std::endl;
+      std::cout << "--capture       : Input decode path. 'opencv' decodes full frames and preprocesses them on the CPU (default)," << std::endl;
+      std::cout << "                  'gst-scaled' lets a GStreamer pipeline deliver RGB frames at model resolution," << std::endl;
+      std::cout << "                  'gst-tee' additionally delivers full-resolution frames from the same decode" << std::endl;
+      std::cout << "--writer-queue  : Number of finished frames queued for the encoder thread. Default is 4" << std::endl;
+      std::cout << "--writer-drop   : Drop output frames instead of waiting when the encoder queue is full" << std::endl;
+      std::cout << "-o / --output   : Output file, GStreamer pipeline (gst-pipeline sink) or '-' for stdout (y4m sink). Default is 'out.avi'" << std::endl;
+      std::cout << "--sink          : Output sink. One of gst, gst-pipeline, ffmpeg, mjpeg, y4m, null. Default is 'gst'" << std::endl;
+      std::cout << "--codec         : Fourcc of the encoder for the gst and ffmpeg sinks (mp4v, avc1, XVID, ...). Default is 'mp4v'" << std::endl;
+      std::cout << "--preset        : Encoder speed preset for the ffmpeg sink (ultrafast, veryfast, medium, ...)" << std::endl;
+      std::cout << "--quality       : CRF for the ffmpeg sink (lower is better) or quality for the mjpeg sink (0-100)" << std::endl;
+      std::cout << "--detections    : Write detections to a file. '.csv' gives one row per detection, anything else JSON lines" << std::endl;
+      std::cout << "--score-threshold : Minimum score of detections written with --detections. Default is 0.3" << std::endl;
+      std::cout << "--segments      : Split the input into N time segments, each decoded and inferred on its own thread." << std::endl;
+      std::cout << "                  --threads is split between the segments. Default is 1 (no splitting)" << std::endl;
+      std::cout << "--keyframe-interval : GOP length of the input. Segment boundaries are aligned to it, so every segment" << std::endl;
+      std::cout << "                  starts on a keyframe" << std::endl;
+      std::cout << "--segment-video : In segment mode, write a video chunk per segment and stitch them into the output" << std::endl;
+      std::cout << "--keep-segments : Keep the per-segment video chunks after stitching" << std::endl;
+      std::cout << "--build-cache   : Decode and preprocess the input once into a tensor cache for the model's input" << std::endl;
+      std::cout << "                  resolution and type, then exit. Run it again with '-i cache:<file>'" << std::endl;
+      std::cout << "--cache-file    : Tensor cache written by --build-cache. Default is '<input>.<res>.<type>.tcache'" << std::endl;
+      std::cout << "--repeat        : Number of inference passes over a tensor cache. Default is 1" << std::endl;
+      std::cout << "--images        : Process a directory of images or a manifest file (one image path per line) instead" << std::endl;
+      std::cout << "                  of -i. Detections are written to --detections, stdout if not given" << std::endl;
+      std::cout << "--decoders      : Number of image decoder threads in --images mode. Default is 2" << std::endl;
+      std::cout << "--input-format  : Format of stdin / pipe input. 'y4m' (4:2:0 or 4:4:4, default), 'rgb24' or 'bgr24'" << std::endl;
+      std::cout << "--input-size    : Frame size of rgb24 / bgr24 input, ie. 1280x720" << std::endl;
+      std::cout << "--input-fps     : Frame rate of rgb24 / bgr24 input. Default is 30" << std::endl;
+      std::cout << "--realtime      : Read input on its own thread and always process the newest frame. Frames that" << std::endl;
+      std::cout << "                  arrive while detection is busy are dropped, so the producer is never held up." << std::endl;
+      std::cout << "                  Not supported with -i shm:<name>" << std::endl;
+      std::cout << "--batch         : Resize the model input to N frames and run one inference per N frames. Helps" << std::endl;
+      std::cout << "                  throughput of offline jobs on the CPU at the cost of latency. Default is 1" << std::endl;
+      std::cout << "--warmup        : Number of inferences on a blank input per model before the first frame, so the" << std::endl;
+      std::cout << "                  first frame does not pay for lazy kernel preparation. Default is 1" << std::endl;
+      std::cout << "--copy-input    : Copy every preprocessed frame into the input tensor. By default the tensor is" << std::endl;
+      std::cout << "                  bound to the buffers the preprocessing writes into, so no copy is needed" << std::endl;
+      std::cout << "--models        : Comma-separated variants of the model, ie. lite0,lite1,lite2 files. All are" << std::endl;
+      std::cout << "                  loaded up front and the demo switches between them to hold --target-fps or" << std::endl;
+      std::cout << "                  --target-latency (ms per frame). Replaces -m" << std::endl;
+      std::cout << "--cascade       : Second, larger model (ie. lite3). The -m model runs on every frame, frames where" << std::endl;
+      std::cout << "                  it finds --gate-classes above --gate-threshold are run through this model too" << std::endl;
+      std::cout << "--cascade-crops : Run the --cascade model on up to N crops around the flagged boxes instead of on" << std::endl;
+      std::cout << "                  the whole frame. Default is 0 (whole frame)" << std::endl;
+      std::cout << "--attention-interval : Run the model on the full frame every N frames only. In between, run it on" << std::endl;
+      std::cout << "                  up to --attention-crops crops around the tracked objects, batched into one" << std::endl;
+      std::cout << "                  inference. Default is 0 (off)" << std::endl;
+      std::cout << "--tiles         : For fixed cameras. Split the full-resolution frame into model-sized tiles and" << std::endl;
+      std::cout << "                  infer only tiles whose content changed by more than --tile-threshold gray levels," << std::endl;
+      std::cout << "                  --tile-batch tiles per inference. Static tiles keep their detections and are" << std::endl;
+      std::cout << "                  refreshed every --tile-refresh frames" << std::endl;
+      std::cout << "--memory-budget : MiB the interpreters, model mappings and frame buffers may use. The encoder" << std::endl;
+      std::cout << "                  queue, in segment mode the number of segments and with --streams the number of" << std::endl;
+      std::cout << "                  --interpreters are reduced to fit at startup. Not supported with --workers" << std::endl;
+      std::cout << "--streams       : Comma-separated inputs, each processed as its own stream instead of -i. Stream N" << std::endl;
+      std::cout << "                  writes to -o and --detections with '.streamNN' before the extension" << std::endl;
+      std::cout << "--stream-list   : File with one input stream per line, in addition to --streams" << std::endl;
+      std::cout << "--workers       : Process the streams in N worker processes forked after the model is loaded." << std::endl;
+      std::cout << "                  Workers share the model's memory, a crashed worker is restarted and its stream retried." << std::endl;
+      std::cout << "                  Default is 0: all streams run in this process, sharing one model" << std::endl;
+      std::cout << "--interpreters  : Interpreters serving the streams of this process, --threads is split between" << std::endl;
+      std::cout << "                  them. Default is 2" << std::endl;
+      std::cout << "--pool-threads  : Threads decoding, preprocessing, drawing and encoding the frames of all streams," << std::endl;
+      std::cout << "                  served round robin per stream. Default is 2" << std::endl;
+      std::cout << "--scheduler     : 'fair' serves the pool's per-stream queues round robin, 'steal' gives every pool" << std::endl;
+      std::cout << "                  thread its own deque and lets idle threads steal from busy ones. Default is fair" << std::endl;
+      std::cout << "--affinity      : CPUs of each thread role, 'role=cpus' separated by ';'. Roles are capture (--realtime" << std::endl;
+      std::cout << "                  reader, image decoders), preprocess (stream pool), interpreter (detection loop and" << std::endl;
+      std::cout << "                  TFLite thread pools) and encoder. CPUs are lists and ranges, ie. 0,2-3" << std::endl;
+      std::cout << "--sched         : Scheduling policy of each role, 'role=policy[:priority]' separated by ';'. Policies" << std::endl;
+      std::cout << "                  are other, batch, idle (priority is the nice value) and fifo, rr (1-99)." << std::endl;
+      std::cout << "                  Roles without a setting inherit the interpreter placement" << std::endl;
+      std::cout << "--cpu-usage     : Print the utilization of every core at the end, implied by --affinity and --sched" << std::endl;
+      std::cout << "--hot-swap      : Load a new interpreter in the background whenever the -m file is rewritten or" << std::endl;
+      std::cout << "                  the process gets SIGHUP, and switch to it between two frames once warmed up" << std::endl;
+      std::cout << "--control-socket : Unix socket for hot swaps. 'reload' reloads the current model, 'reload <path>'" << std::endl;
+      std::cout << "                  switches to another one; the reply tells whether it loaded" << std::endl;
+      std::cout << "--shm-results   : With -i shm:/name, write one detection record per frame to the shared-memory" << std::endl;
+      std::cout << "                  ring of this name. Records are dropped if the reader falls behind" << std::endl;
+      std::cout << "--full-decode   : Decode JPEGs at full resolution. By default large JPEGs are downscaled by the" << std::endl;
+      std::cout << "                  decoder (1/2, 1/4 or 1/8) while staying at or above the model resolution" << std::endl;
       return 0;
     }
 
     modelFile    = parsedOptions["model"].as<std::string>();
     videoFile    = parsedOptions["input"].as<std::string>();
-    backend      = parsedOptions["backend"].as<std::string>();
-    delegatePath = parsedOptions["delegate"].as<std::string>();
+    captureMode  = parsedOptions["capture"].as<std::string>();
+
+    detectorOptions.backend      = parsedOptions["backend"].as<std::string>();
+    detectorOptions.delegatePath = parsedOptions["delegate"].as<std::string>();
+    detectorOptions.numThreads   = parsedOptions["threads"].as<int>();
+
+    pipelineOptions.writerQueue    = parsedOptions["writer-queue"].as<int>();
+    pipelineOptions.writerDrop     = parsedOptions.count("writer-drop") > 0;
+    pipelineOptions.scoreThreshold = parsedOptions["score-threshold"].as<float>();
+    pipelineOptions.zeroCopyInput  = parsedOptions.count("copy-input") == 0;
+
+    sinkOptions.type    = parsedOptions["sink"].as<std::string>();
+    sinkOptions.output  = parsedOptions["output"].as<std::string>();
+    sinkOptions.codec   = parsedOptions["codec"].as<std::string>();
+    sinkOptions.preset  = parsedOptions["preset"].as<std::string>();
+    sinkOptions.quality = parsedOptions["quality"].as<int>();
+
+    detectionsFile = parsedOptions["detections"].as<std::string>();
+
+    segmentOptions.segments         = parsedOptions["segments"].as<int>();
+    segmentOptions.keyframeInterval = parsedOptions["keyframe-interval"].as<int>();
+    segmentOptions.video            = parsedOptions.count("segment-video") > 0;
+    segmentOptions.keepChunks       = parsedOptions.count("keep-segments") > 0;
+
+    buildCache = parsedOptions.count("build-cache") > 0;
+    cacheFile  = parsedOptions["cache-file"].as<std::string>();
+    repeat     = parsedOptions["repeat"].as<int>();
+
+    imagesPath            = parsedOptions["images"].as<std::string>();
+    imageOptions.decoders = parsedOptions["decoders"].as<int>();
+    imageOptions.reduced  = parsedOptions.count("full-decode") == 0;
+
+    shmResults = parsedOptions["shm-results"].as<std::string>();
+    batch      = parsedOptions["batch"].as<int>();
+    warmup     = parsedOptions["warmup"].as<int>();
+
+    memoryBudget = static_cast<size_t>(std::max(0, parsedOptions["memory-budget"].as<int>())) * 1024 * 1024;
+    segmentOptions.memoryBudget = memoryBudget;
+
+    streamList             = parsedOptions["streams"].as<std::string>();
+    streamManifest         = parsedOptions["stream-list"].as<std::string>();
+    workerOptions.workers  = parsedOptions["workers"].as<int>();
+
+    streamRunnerOptions.interpreters = parsedOptions["interpreters"].as<int>();
+    streamRunnerOptions.poolThreads  = parsedOptions["pool-threads"].as<int>();
+    streamRunnerOptions.scheduler    = parsedOptions["scheduler"].as<std::string>();
+
+    if(!parseAffinity(parsedOptions["affinity"].as<std::string>(), placement) ||
+       !parseSchedule(parsedOptions["sched"].as<std::string>(), placement)){
+      return 1;
+    }
+    cpuUsage = parsedOptions.count("cpu-usage") > 0 || !placement.empty();
+
+    std::stringstream models(parsedOptions["models"].as<std::string>());
+    std::string       variantFile;
+    while(std::getline(models, variantFile, ',')){
+      if(!variantFile.empty()){
+        variantFiles.push_back(variantFile);
+      }
+    }
+
+    confirmFile                  = parsedOptions["cascade"].as<std::string>();
+    cascadeOptions.gateThreshold = parsedOptions["gate-threshold"].as<float>();
+    cascadeOptions.crops         = parsedOptions["cascade-crops"].as<int>();
+
+    std::stringstream gateClasses(parsedOptions["gate-classes"].as<std::string>());
+    std::string       gateClass;
+    while(std::getline(gateClasses, gateClass, ',')){
+      if(gateClass.empty()){
+        continue;
+      }
+      try{
+        cascadeOptions.gateClasses.push_back(std::stoi(gateClass));
+      }
+      catch(const std::exception&){
+        std::cout << "Invalid class id '" << gateClass << "' in --gate-classes" << std::endl;
+        return 1;
+      }
+    }
+
+    attentionOptions.interval = parsedOptions["attention-interval"].as<int>();
+    attentionCrops            = parsedOptions["attention-crops"].as<int>();
+
+    tilesMode             = parsedOptions.count("tiles") > 0;
+    tileOptions.threshold = parsedOptions["tile-threshold"].as<double>();
+    tileOptions.refresh   = parsedOptions["tile-refresh"].as<int>();
+    tileBatch             = parsedOptions["tile-batch"].as<int>();
+
+    reloadOptions.controlSocket = parsedOptions["control-socket"].as<std::string>();
+    reloadOptions.watchFile     = parsedOptions.count("hot-swap") > 0;
+    reloadOptions.signal        = reloadOptions.watchFile;
+    reloadOptions.zeroCopyInput = pipelineOptions.zeroCopyInput;
+    hotSwap = reloadOptions.watchFile || !reloadOptions.controlSocket.empty();
+
+    double targetFps     = parsedOptions["target-fps"].as<double>();
+    double targetLatency = parsedOptions["target-latency"].as<double>();
+    if(!variantFiles.empty()){
+      if((targetFps > 0) == (targetLatency > 0)){
+        std::cout << "Error in parsing arguments: --models needs either --target-fps or --target-latency" << std::endl;
+        return 1;
+      }
+      qualityOptions.targetMs = targetFps > 0 ? 1000.0 / targetFps : targetLatency;
+    }
+
+    sourceOptions.inputFormat = parsedOptions["input-format"].as<std::string>();
+    sourceOptions.inputFps    = parsedOptions["input-fps"].as<double>();
+    sourceOptions.realtime    = parsedOptions.count("realtime") > 0;
+
+    std::string inputSize = parsedOptions["input-size"].as<std::string>();
+    if(!inputSize.empty()){
+      int width  = 0;
+      int height = 0;
+      if(sscanf(inputSize.c_str(), "%dx%d", &width, &height) != 2){
+        std::cout << "Error in parsing arguments: --input-size must be WxH" << std::endl;
+        return 1;
+      }
+      sourceOptions.inputSize = cv::Size(width, height);
+    }
   }
 
   catch(const cxxopts::OptionException& e){
@@ -67,57 +370,393 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
-  if(modelFile.empty() || videoFile.empty()){
-    std::cout << "Please provide path to model (-m) and input file (-i) as command line arguments" << std::endl;
+  // Image mode only produces detections
+  if(!imagesPath.empty() && detectionsFile.empty()){
+    detectionsFile = "-";
+  }
+
+  // Video or detections go to stdout, keep the log out of the stream. Decided
+  // before the first line is logged, so the stream starts with its own header.
+  if(sinkOptions.output == "-" || detectionsFile == "-"){
+    std::cout.rdbuf(std::cerr.rdbuf());
+  }
+
+  std::cout << "EfficientDet detection example" << std::endl;
+  std::cout << "==============================" << std::endl;
+
+  bool regionsMode = attentionOptions.interval > 0 || tilesMode;
+
+  if(!variantFiles.empty() || !confirmFile.empty() || regionsMode){
+    if(!imagesPath.empty() || buildCache || videoFile.rfind("cache:", 0) == 0 || segmentOptions.segments > 1){
+      std::cout << "--models, --cascade, --attention-interval and --tiles work with video input only" << std::endl;
+      return 1;
+    }
+  }
+
+  if(hotSwap){
+    if(!imagesPath.empty() || buildCache || videoFile.rfind("cache:", 0) == 0 || segmentOptions.segments > 1){
+      std::cout << "--hot-swap and --control-socket work with video input only" << std::endl;
+      return 1;
+    }
+    if(!variantFiles.empty() || regionsMode){
+      std::cout << "--hot-swap and --control-socket can not be combined with --models, --attention-interval or --tiles" << std::endl;
+      return 1;
+    }
+  }
+
+  bool streamsMode = !streamList.empty() || !streamManifest.empty();
+
+  if(streamsMode){
+    if(!videoFile.empty() || !imagesPath.empty() || buildCache || segmentOptions.segments > 1 ||
+       !variantFiles.empty() || !confirmFile.empty() || regionsMode || hotSwap || !shmResults.empty()){
+      std::cout << "--streams and --stream-list replace -i and can not be combined with other input modes, --models," << std::endl;
+      std::cout << "--cascade, --attention-interval, --tiles, --hot-swap or --shm-results" << std::endl;
+      return 1;
+    }
+    if(sinkOptions.output == "-" || sinkOptions.type == "gst-pipeline" || detectionsFile == "-"){
+      std::cout << "Streams need file outputs (-o, --detections), one per stream is derived from them" << std::endl;
+      return 1;
+    }
+    if(workerOptions.workers < 0 || batch > 1){
+      std::cout << "Streams are processed with --batch 1 and a non-negative number of --workers" << std::endl;
+      return 1;
+    }
+    if(streamRunnerOptions.scheduler != "fair" && streamRunnerOptions.scheduler != "steal"){
+      std::cout << "Unknown --scheduler " << streamRunnerOptions.scheduler << ", use fair or steal" << std::endl;
+      return 1;
+    }
+    if(workerOptions.workers > 0 && memoryBudget > 0){
+      std::cout << "--memory-budget is not supported with --workers, run the streams in this process" << std::endl;
+      return 1;
+    }
+    if(workerOptions.workers == 0 && (captureMode == "gst-scaled" || streamRunnerOptions.interpreters < 1)){
+      std::cout << "Streams in this process need full frames (no --capture gst-scaled) and at least one --interpreters" << std::endl;
+      return 1;
+    }
+  }
+  else if(workerOptions.workers > 0){
+    std::cout << "--workers needs --streams or --stream-list" << std::endl;
+    return 1;
+  }
+
+  // Frames dropped by the real-time reader would leave their ring slots
+  // untracked and tag results with the wrong frames
+  if(sourceOptions.realtime && videoFile.rfind("shm:", 0) == 0){
+    std::cout << "--realtime can not be combined with -i shm:<name>, the ring already lets the producer run ahead" << std::endl;
+    return 1;
+  }
+
+  if(attentionOptions.interval > 0 && tilesMode){
+    std::cout << "--attention-interval and --tiles can not be combined" << std::endl;
+    return 1;
+  }
+
+  if(tilesMode && (batch > 1 || tileBatch < 1)){
+    std::cout << "--tiles needs --batch 1 and a --tile-batch of at least 1" << std::endl;
+    return 1;
+  }
+
+  if(attentionOptions.interval > 0 && (batch > 1 || attentionCrops < 1)){
+    std::cout << "--attention-interval needs --batch 1 and at least one --attention-crops" << std::endl;
+    return 1;
+  }
+
+  if(!variantFiles.empty()){
+    // Sources that scale frames themselves do it for the most accurate variant
+    std::stable_sort(variantFiles.begin(), variantFiles.end(), [](const std::string& a, const std::string& b){
+      return parseModelRes(a) < parseModelRes(b);
+    });
+    modelFile = variantFiles.back();
+  }
+
+  if(modelFile.empty() || (videoFile.empty() && imagesPath.empty() && !streamsMode)){
+    std::cout << "Please provide path to model (-m) and input file (-i), images (--images) or streams (--streams) as command line arguments" << std::endl;
     std::cout << "Alternatively, you can provide -h / --help argument to display help message." << std::endl;
     return 1;
   }
 
-  if(toUpperCase(backend) == std::string("VX") && delegatePath.empty()){
+  if(toUpperCase(detectorOptions.backend) == std::string("VX") && detectorOptions.delegatePath.empty()){
     std::cout << "No VX_DELEGATE supplied ..." << std::endl;
     return 1;
   }
-  
 
-  int  CHANNELS    = 3;
-  int  MODEL_RES   = parseModelRes(modelFile);
-  bool KERAS_MODEL = parseKerasModel(modelFile);
+  if(batch < 1){
+    std::cout << "--batch must be at least 1" << std::endl;
+    return 1;
+  }
+
+  if(pipelineOptions.writerQueue < 1){
+    std::cout << "--writer-queue must be at least 1" << std::endl;
+    return 1;
+  }
+
+  if(warmup < 0){
+    std::cout << "--warmup must not be negative" << std::endl;
+    return 1;
+  }
+
+  // Count cv::Mat allocations from here on to verify the frame loop
+  MatAllocationCounter::install();
 
-  // Prepare string streams for FPS display
-  std::stringstream fpsString;
-  fpsString.precision(4);
+  // The main thread builds and runs the interpreters. Threads it starts from
+  // here on, including the TFLite thread pools, inherit its placement.
+  if(!placement.empty()){
+    setThreadPlacement(placement);
+    printThreadPlacement();
+    placeThread(THREAD_INTERPRETER);
+  }
+
+  std::unique_ptr<CpuUsageReport> cpuUsageReport(cpuUsage ? new CpuUsageReport() : nullptr);
 
-  cv::Mat img;
-  cv::Mat RGBImg;
-  cv::Mat outMat;
+  // Workers are forked, so no thread may have been started before
+  if(streamsMode){
+    std::vector<StreamJob> streams;
+    if(!listStreams(streamList, streamManifest, sinkOptions.type == "null" ? "" : sinkOptions.output,
+                    detectionsFile, streams)){
+      return -1;
+    }
 
-  std::vector<std::vector<float>> outputs;
+    sourceOptions.capture  = captureMode;
+    sourceOptions.modelRes = parseModelRes(modelFile);
+    sourceOptions.depth    = (captureMode == "gst-tee") ? pipelineOptions.writerQueue + 2 : 1;
 
-  int imgCnt = 0;
+    int res;
+    if(workerOptions.workers > 0){
+      res = runWorkerPool(streams, modelFile, detectorOptions, sourceOptions, sinkOptions,
+                          pipelineOptions, workerOptions);
+    }
+    else{
+      // Printed by runStreams() once the streams are done
+      MemoryReport memory;
+      pipelineOptions.memory           = &memory;
+      streamRunnerOptions.memoryBudget = memoryBudget;
+
+      res = runStreams(streams, modelFile, detectorOptions, sourceOptions, sinkOptions,
+                       pipelineOptions, streamRunnerOptions);
+    }
+    if(cpuUsageReport){
+      cpuUsageReport->print();
+    }
+    std::cout << "Done" << std::endl;
+    return res;
+  }
+
+  std::unique_ptr<FileDetectionSink> detections;
+  if(!detectionsFile.empty()){
+    detections.reset(new FileDetectionSink(detectionsFile));
+    if(!detections->isOpened()){
+      std::cout << "Failed to open detections file ..." << std::endl;
+      return -1;
+    }
+  }
+
+  pipelineOptions.sourceName = videoFile;
+
+  if(!imagesPath.empty()){
+    std::vector<std::string> images;
+    if(!listImages(imagesPath, images)){
+      return -1;
+    }
+
+    std::cout << "Input: " << images.size() << " images from " << imagesPath << std::endl;
+
+    Detector detector;
+    TFLITE_MINIMAL_CHECK(loadDetector(modelFile, detectorOptions, detector));
+
+    imageOptions.scoreThreshold = pipelineOptions.scoreThreshold;
+    int res = runImageBatch(images, detector, *detections, imageOptions);
+
+    if(cpuUsageReport){
+      cpuUsageReport->print();
+    }
+    std::cout << "Done" << std::endl;
+    return res < 0 ? -1 : 0;
+  }
+
+  if(buildCache){
+    // The cache layout follows the model's input tensor
+    Detector detector;
+    TFLITE_MINIMAL_CHECK(loadDetector(modelFile, DetectorOptions(), detector));
+
+    std::string cachePath = cacheFile.empty() ?
+        tensorCachePath(videoFile, detector.resolution, detector.inTensor->type) : cacheFile;
+
+    int frames = buildTensorCache(videoFile, cachePath, detector.resolution, detector.inTensor->type);
+    if(frames < 0){
+      return -1;
+    }
+
+    std::cout << "Cached " << frames << " frames in " << cachePath << std::endl;
+    return 0;
+  }
+
+  if(videoFile.rfind("cache:", 0) == 0){
+    TensorCache cache;
+    if(!cache.open(videoFile.substr(6))){
+      return -1;
+    }
+
+    // Fault the whole file in before timing, so every pass is I/O free
+    cache.preload();
+
+    std::cout << "Input: tensor cache, " << cache.frameCount() << " frames" << std::endl;
+
+    Detector detector;
+    TFLITE_MINIMAL_CHECK(loadDetector(modelFile, detectorOptions, detector));
+
+    int res = runCacheBenchmark(cache, detector, repeat, detections.get(),
+                                pipelineOptions.scoreThreshold, videoFile);
+    if(detections){
+      detections->flush();
+    }
+
+    if(cpuUsageReport){
+      cpuUsageReport->print();
+    }
+    std::cout << "Done" << std::endl;
+    return res;
+  }
+
+  if(segmentOptions.segments > 1){
+    int res = runSegments(videoFile, modelFile, detectorOptions, sinkOptions, detections.get(),
+                          pipelineOptions, segmentOptions);
+    if(cpuUsageReport){
+      cpuUsageReport->print();
+    }
+    std::cout << "Done" << std::endl;
+    return res;
+  }
+
+  // Interpreters of the video loop run one after another, so they can share
+  // one CPU thread pool instead of each keeping its own
+  if(variantFiles.size() > 1 || !confirmFile.empty() || regionsMode){
+    detectorOptions.cpuBackend = std::make_shared<tflite::ExternalCpuBackendContext>();
+  }
+
+  // Load model, or every variant of it ordered from fastest to most accurate
+  if(variantFiles.empty()){
+    variantFiles.push_back(modelFile);
+  }
+
+  std::vector<std::unique_ptr<Detector>> variants;
+  std::vector<Detector*>                 variantPtrs;
+  Detector                               confirm;
+  for(size_t i = 0; i < variantFiles.size(); i++){
+    variants.emplace_back(new Detector());
+    variantPtrs.push_back(variants.back().get());
+  }
+
+  // The quality controller times every variant after its warm-up
+  if(variants.size() > 1){
+    warmup = std::max(warmup, 1);
+  }
+
+  std::vector<Detector*>   loading = variantPtrs;
+  std::vector<std::string> loadFiles = variantFiles;
+  std::vector<int>         loadBatches(variantFiles.size(), batch);
+  if(!confirmFile.empty()){
+    loading.push_back(&confirm);
+    loadFiles.push_back(confirmFile);
+    loadBatches.push_back(1);
+  }
+
+  // Several models share one CPU backend context, so they are built and
+  // warmed up one after another. Failures are returned to the main thread,
+  // which gives up there.
+  double loadMs   = 0;
+  double warmupMs = 0;
+  auto loadModels = [&](){
+    auto loadStart = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < loading.size(); i++){
+      if(!loadDetector(loadFiles[i], detectorOptions, *loading[i]) ||
+         (loadBatches[i] > 1 && !resizeBatch(*loading[i], loadBatches[i]))){
+        std::cout << "Failed to load model " << loadFiles[i] << std::endl;
+        return false;
+      }
+    }
+    loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+    return true;
+  };
+  auto warmUpModels = [&](){
+    auto warmupStart = std::chrono::steady_clock::now();
+    for(Detector* detector : loading){
+      if(!warmUpDetector(*detector, warmup)){
+        std::cout << "Failed to warm up model " << detector->modelFile << std::endl;
+        return false;
+      }
+    }
+    warmupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - warmupStart).count();
+    return true;
+  };
+
+  // Models load while the input and output open. With a memory budget they
+  // are built first: the delegate's memory is measured as growth of the
+  // resident set, which opening the input and output would add to, and
+  // interpreters that can not fit fail before anything else is opened.
+  std::future<bool> modelsReady;
+  if(memoryBudget > 0){
+    if(!loadModels()){
+      return -1;
+    }
+
+    MemoryReport interpreters;
+    for(Detector* detector : loading){
+      interpreters.addInterpreter(*detector);
+    }
+    if(interpreters.totalBytes() > memoryBudget){
+      std::cout << "Memory budget of " << memoryBudget / (1024 * 1024) << " MiB is too small, the interpreters alone need "
+                << (interpreters.totalBytes() + 1024 * 1024 - 1) / (1024 * 1024) << " MiB" << std::endl;
+      return -1;
+    }
+
+    modelsReady = std::async(std::launch::async, warmUpModels);
+  }
+  else{
+    modelsReady = std::async(std::launch::async, [&](){ return loadModels() && warmUpModels(); });
+  }
+
+  auto openStart = std::chrono::steady_clock::now();
+
+  int MODEL_RES = parseModelRes(modelFile);
 
   // Open video file
-  cv::VideoCapture cap(videoFile);
+  sourceOptions.input    = videoFile;
+  sourceOptions.capture  = captureMode;
+  sourceOptions.modelRes = MODEL_RES;
+  // Frames of a whole batch are held until it is rendered. Full-resolution
+  // frames of gst-tee are also rendered into and queued for encoding.
+  sourceOptions.depth    = (captureMode == "gst-tee") ? pipelineOptions.writerQueue + 1 + batch : batch;
 
-  if(!cap.isOpened()){
+  std::unique_ptr<FrameSource> source = createFrameSource(sourceOptions);
+
+  if(!source || !source->isOpened()){
     std::cout << "Failed to open input file ..." << std::endl;
     return -1;
   }
 
-  double fps = cap.get(cv::CAP_PROP_FPS);
+  std::cout << "Input: " << source->describe() << std::endl;
+
+  // Frames in shared memory stay in their ring slots while they are batched
+  if(dynamic_cast<ShmFrameSource*>(source.get()) && source->pools()[0]->capacity() < batch){
+    std::cout << "--batch " << batch << " needs a shared memory ring with at least " << batch << " slots" << std::endl;
+    return -1;
+  }
+
+  double fps = source->info().fps;
   std::cout << "Input File FPS: " << fps << std::endl;
 
-  double framecount = cap.get(cv::CAP_PROP_FRAME_COUNT);
+  double framecount = source->info().frameCount;
   std::cout << "Input File Frame Count: " << framecount << std::endl;
 
-  double framewidth = cap.get(cv::CAP_PROP_FRAME_WIDTH);
+  double framewidth = source->info().frameSize.width;
   std::cout << "Input file Frame width: " << framewidth << std::endl;
 
-  double frameheight = cap.get(cv::CAP_PROP_FRAME_HEIGHT);
+  double frameheight = source->info().frameSize.height;
   std::cout << "Input file Frame height: " << frameheight << std::endl;
 
   // Parse the fourcc from input video file
   // fourcc is returned as double, need to parse
-  int fourcc = cap.get(cv::CAP_PROP_FOURCC);
+  int fourcc = source->info().fourcc;
   char first = fourcc & 255;
   char second = (fourcc >> 8) & 255;
   char third = (fourcc >> 16) & 255;
@@ -126,137 +765,195 @@ int main(int argc, char* argv[]) {
   std::cout << "Input file fourcc: " << first << second << third << fourth << std::endl;
   std::cout << "==============================" << std::endl << std::endl;
   
-  // Prepare output file
-  // Output file will have the same resolution as input file
-  // Output format is avi because mp4 is not supported
-  cv::VideoWriter  out("out.avi",
-                  cv::CAP_GSTREAMER,
-                  cv::VideoWriter::fourcc('m', 'p', '4', 'v'),
-                  cap.get(cv::CAP_PROP_FPS),
-                  cv::Size(framewidth, frameheight),
-                  true);
-
-  if(!out.isOpened()){
+  // Prepare output sink
+  // Output will have the same resolution as input file
+  std::unique_ptr<VideoSink> out = createVideoSink(sinkOptions,
+                                                   fps,
+                                                   cv::Size(framewidth, frameheight));
+
+  if(!out || !out->isOpened()){
     std::cout << "Failed to open output file ..." << std::endl;
     return -1;
   }
 
-  // Load model
-  std::unique_ptr<tflite::FlatBufferModel> model =
-      tflite::FlatBufferModel::BuildFromFile(modelFile.c_str());
-  TFLITE_MINIMAL_CHECK(model != nullptr);
-
-  tflite::ops::builtin::BuiltinOpResolver resolver;
-  tflite::InterpreterBuilder builder(*model, resolver);
-  std::unique_ptr<tflite::Interpreter> interpreter;
-  builder(&interpreter);
-  TFLITE_MINIMAL_CHECK(interpreter != nullptr);
-
-  interpreter->SetNumThreads(4);
+  std::cout << "Output: " << out->describe() << std::endl;
 
-  interpreter->SetAllowFp16PrecisionForFp32(true);
+  double openMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - openStart).count();
 
-  // When working with external delegates
-  // It is necessary to remember the pointers
-  // For successful removal of the delegate
-  TfLiteExternalDelegateOptions  ext_delegate_option;
-  TfLiteDelegate*                ext_delegate_ptr;
-
-  if (toUpperCase(backend) == std::string("NNAPI")){
-    tflite::StatefulNnApiDelegate::Options options;
-    auto delegate = tflite::evaluation::CreateNNAPIDelegate(options);
-    if (!delegate) {
-      std::cout << "NNAPI acceleration is unsupported on this platform." << std::endl;
-    } else {
-      std::cout << "Use NNAPI acceleration." << std::endl;
+  // Detections of shared-memory input can go back to the producer
+  std::unique_ptr<ShmDetectionSink> resultsRing;
+  if(!shmResults.empty()){
+    ShmFrameSource* shmSource = dynamic_cast<ShmFrameSource*>(source.get());
+    if(!shmSource || detections){
+      std::cout << "--shm-results needs -i shm:<name> and can not be combined with --detections" << std::endl;
+      return -1;
     }
 
-    if (interpreter->ModifyGraphWithDelegate(std::move(delegate)) !=
-        kTfLiteOk) {
-      std::cout << "Failed to apply NNAPI delegate." << std::endl;
-      return 1;
+    resultsRing.reset(new ShmDetectionSink(shmResults, *shmSource, 16));
+    if(!resultsRing->isOpened()){
+      return -1;
     }
   }
 
-  else if(toUpperCase(backend) == std::string("VX")){
-    ext_delegate_option = TfLiteExternalDelegateOptionsDefault(delegatePath.c_str());
-    ext_delegate_ptr = TfLiteExternalDelegateCreate(&ext_delegate_option);
-    if(!ext_delegate_ptr){
-      std::cout << "VX acceleration failed to initialize." << std::endl;
-    }
-    else{
-      std::cout << "VX acceleration enabled." << std::endl;
-    }
-
-    if(interpreter->ModifyGraphWithDelegate(ext_delegate_ptr) != kTfLiteOk){
-      std::cout << "Failed to apply VX delegate." << std::endl;
-    }
+  if(!modelsReady.get()){
+    return -1;
   }
 
-  // Allocate tensor buffers.
-  TFLITE_MINIMAL_CHECK(interpreter->AllocateTensors() == kTfLiteOk);
+  std::cout << "Startup: input and output " << openMs << " ms, models " << loadMs << " ms, "
+            << warmup << " warm-up run(s) " << warmupMs << " ms, "
+            << (memoryBudget > 0 ? "warm-up in parallel" : "in parallel") << std::endl;
 
-  TfLiteTensor* inTensor  = interpreter->input_tensor(0);
-  TfLiteTensor* outTensor = interpreter->output_tensor(0);
+  if(batch > 1){
+    std::cout << "Batch: " << batch << " frames per inference" << std::endl;
+  }
 
-  int8_t* input = reinterpret_cast<int8_t*>(inTensor->data.raw);
+  std::vector<double> inferenceMs;
+
+  std::unique_ptr<QualityController> quality;
+  if(variants.size() > 1){
+    // Timed after the warm-up, so the run is representative
+    std::vector<std::string> names;
+    for(Detector* detector : variantPtrs){
+      inferenceMs.push_back(timedInference(detector->interpreter.get()).count() / 1000.0 / batch);
+      names.push_back(detector->modelFile);
+      std::cout << "Variant " << detector->modelFile << ": " << detector->resolution << "x" << detector->resolution
+                << ", " << inferenceMs.back() << " ms per frame" << std::endl;
+    }
+    quality.reset(new QualityController(names, inferenceMs, qualityOptions));
+  }
 
-  // Evaluate on provided video file
-  while(true){
+  std::unique_ptr<Cascade> cascade;
+  if(!confirmFile.empty()){
+    cascadeOptions.scoreThreshold = pipelineOptions.scoreThreshold;
+    cascade.reset(new Cascade(confirm, cascadeOptions));
+    pipelineOptions.cascade = cascade.get();
 
-    // Capture a frame
-    cap >> img;
+    std::cout << "Cascade: " << confirmFile << " confirms "
+              << (cascadeOptions.crops > 0 ? "crops of " : "") << "flagged frames" << std::endl;
+  }
 
-    if(img.empty()){
-      std::cout << "End of file, exitting ..." << std::endl;
-      break;
-    }
+  // Crops and tiles run on a second interpreter of the most accurate model,
+  // batched
+  Detector                         cropDetector;
+  std::unique_ptr<RegionScheduler> regions;
+  if(regionsMode){
+    TFLITE_MINIMAL_CHECK(loadDetector(modelFile, detectorOptions, cropDetector, variantPtrs.back()->model));
+    TFLITE_MINIMAL_CHECK(resizeBatch(cropDetector, tilesMode ? tileBatch : attentionCrops));
+    TFLITE_MINIMAL_CHECK(warmUpDetector(cropDetector, warmup));
+  }
 
-    // OpenCV loads images in BGR format. image has to be converted to RGB.
-    cv::cvtColor(img, RGBImg, cv::COLOR_BGR2RGB);
+  if(tilesMode){
+    tileOptions.minScore = pipelineOptions.scoreThreshold;
+    regions.reset(new TileScheduler(cropDetector, tileOptions));
+    pipelineOptions.regions = regions.get();
+  }
 
-    // Resize input image to fit the model
-    cv::resize(RGBImg, img, cv::Size(MODEL_RES, MODEL_RES), 0, 0, cv::INTER_CUBIC);
+  if(attentionOptions.interval > 0){
+    attentionOptions.threshold = pipelineOptions.scoreThreshold;
+    regions.reset(new AttentionScheduler(cropDetector, attentionOptions));
+    pipelineOptions.regions = regions.get();
 
-    memcpy((void*)input, (void*) img.data, MODEL_RES * MODEL_RES * CHANNELS * sizeof(int8_t));
+    std::cout << "Attention: full frame every " << attentionOptions.interval << " frames, up to "
+              << attentionCrops << " crops in between" << std::endl;
+  }
 
-    auto inferenceTimeDuration = timedInference(interpreter.get());
+  // New models are loaded and warmed up next to the running pipeline
+  std::unique_ptr<ModelReloader> reloader;
+  if(hotSwap){
+    reloader.reset(new ModelReloader(modelFile, detectorOptions, batch, reloadOptions));
+    if(!reloader->start()){
+      return -1;
+    }
+    pipelineOptions.reloader = reloader.get();
 
-    double fps = 1 / (static_cast<int>(inferenceTimeDuration.count()) / 1000.0);
+    std::cout << "Hot swap: " << (reloadOptions.watchFile ? "watching " + modelFile + ", SIGHUP" : std::string(""))
+              << (reloadOptions.watchFile && !reloadOptions.controlSocket.empty() ? ", " : "")
+              << (reloadOptions.controlSocket.empty() ? "" : "control socket " + reloadOptions.controlSocket)
+              << std::endl;
+  }
 
-    fpsString << fps;
+  // Everything the loop will hold is known now, so a budget that is too small
+  // fails here instead of with an allocation failure during the run
+  MemoryReport memory;
+  for(Detector* detector : variantPtrs){
+    memory.addInterpreter(*detector);
+  }
+  if(cascade){
+    memory.addInterpreter(confirm);
+  }
+  if(regions){
+    memory.addInterpreter(cropDetector);
+  }
+  pipelineOptions.memory = &memory;
 
-    // Keras-converted models have different output tensors
-    if(KERAS_MODEL){
-      outputs = getOutputVectors(outTensor, 100, 4);
-      drawBoundingBoxesScaled(outputs, img, MODEL_RES);
+  if(memoryBudget > 0){
+    size_t sourceBytes = 0;
+    for(const FramePool* pool : source->pools()){
+      sourceBytes += pool->totalBytes();
     }
 
-    else{
-      outputs = getOutputVectors(outTensor, 100, 7);
-      drawBoundingBoxes(outputs, img);
+    // gst-tee frames are rendered into and queued for encoding, so its pools
+    // are sized from the encoder queue and shrink with it
+    bool   queuedSource = captureMode == "gst-tee";
+    size_t depthBytes   = sourceBytes / sourceOptions.depth;
+
+    cv::Size frameSize = source->info().frameSize;
+    auto needed = [&](){
+      size_t sourceNeeded = queuedSource ? depthBytes * (pipelineOptions.writerQueue + 1 + batch) : sourceBytes;
+      return memory.totalBytes() + sourceNeeded + loopBufferBytes(frameSize, variantPtrs, pipelineOptions);
+    };
+
+    // Each encoder queue slot holds one full-resolution frame
+    int writerQueue = pipelineOptions.writerQueue;
+    while(pipelineOptions.writerQueue > 1 && needed() > memoryBudget){
+      pipelineOptions.writerQueue--;
     }
 
-    // Convert back to BGR since OpenCV works with BGR
-    cv::cvtColor(img, outMat, cv::COLOR_RGB2BGR);
+    if(needed() > memoryBudget){
+      std::cout << "Memory budget of " << memoryBudget / (1024 * 1024) << " MiB is too small, the pipeline needs "
+                << (needed() + 1024 * 1024 - 1) / (1024 * 1024) << " MiB" << std::endl;
+      return -1;
+    }
 
-    cv::resize(outMat, outMat, cv::Size(framewidth, frameheight), 0, 0, cv::INTER_CUBIC);
+    // Nothing has been read from a file yet, reopen it with the smaller pools
+    if(queuedSource && pipelineOptions.writerQueue != writerQueue){
+      source.reset();
+      sourceOptions.depth = pipelineOptions.writerQueue + 1 + batch;
+      source = createFrameSource(sourceOptions);
+      if(!source || !source->isOpened()){
+        std::cout << "Failed to open input file ..." << std::endl;
+        return -1;
+      }
+    }
 
-    cv::putText(outMat, "FPS: " + fpsString.str(),
-                 cv::Point(15, 45), cv::FONT_HERSHEY_SIMPLEX, 1.0, CV_RGB(255, 0, 0), 2);
+    std::cout << "Memory budget: " << memoryBudget / (1024 * 1024) << " MiB, " << needed() / (1024 * 1024)
+              << " MiB accounted";
+    if(pipelineOptions.writerQueue != writerQueue){
+      std::cout << ", encoder queue reduced to " << pipelineOptions.writerQueue;
+    }
+    std::cout << std::endl;
+  }
 
-    // Clear the content of sstream
-    fpsString.str(std::string());
+  // Evaluate on provided video file
+  pipelineOptions.startTime = processStart;
+  DetectionSink* detectionSink = resultsRing ? static_cast<DetectionSink*>(resultsRing.get()) : detections.get();
+  runDetectionLoop(*source, variantPtrs, quality.get(), *out, detectionSink, pipelineOptions);
 
-    out << outMat;
+  if(resultsRing){
+    resultsRing->flush();
+  }
 
-    std::cout << "Frames processed: " << imgCnt++ << " / " << framecount << std::endl;
+  if(LatestFrameSource* realtimeSource = dynamic_cast<LatestFrameSource*>(source.get())){
+    realtimeSource->printStats();
   }
 
   // Finalize the output video
-  out.release();
+  out->release();
 
+  if(cpuUsageReport){
+    cpuUsageReport->print();
+  }
   std::cout << "Done" << std::endl;
 
   return 0;
-}
\ No newline at end of file
+}
@@ -89,18 +89,18 @@ cv::Mat readImage(const std::string& imgPath, const int width, const int height)
 }
 
 // Performs a single inference with time measurement. returns the duration
-std::chrono::milliseconds timedInference(tflite::Interpreter* interpreter)
+std::chrono::microseconds timedInference(tflite::Interpreter* interpreter)
 {
     auto inferenceTimeStart = std::chrono::high_resolution_clock::now();
 
     if(interpreter->Invoke() != kTfLiteOk){
       printf("Error happened in Invoke()! Logs will be invalid!\n");
-      return std::chrono::duration_cast<std::chrono::milliseconds>(inferenceTimeStart - inferenceTimeStart);
+      return std::chrono::duration_cast<std::chrono::microseconds>(inferenceTimeStart - inferenceTimeStart);
     }
 
     auto inferenceTimeEnd = std::chrono::high_resolution_clock::now();
 
-    return std::chrono::duration_cast<std::chrono::milliseconds>(inferenceTimeEnd - inferenceTimeStart);
+    return std::chrono::duration_cast<std::chrono::microseconds>(inferenceTimeEnd - inferenceTimeStart);
 }
 
 void printVector(const std::vector<float>& v)
@@ -134,22 +134,32 @@ std::vector<std::vector<float>> getOutputVectors(const TfLiteTensor* tensor_ptr,
   return outputs;
 }
 
+void getOutputVectors(const TfLiteTensor* tensor_ptr, const int num_outputs,
+                      const int output_size, std::vector<std::vector<float>>& outputs)
+{
+  const float* output = reinterpret_cast<const float*>(tensor_ptr->data.raw);
+
+  outputs.resize(num_outputs);
+
+  for (int i = 0; i < num_outputs; ++i)
+  {
+    outputs[i].assign(output + (i * output_size), output + ((i + 1) * output_size));
+  }
+}
+
 // Function for drawing bounding boxes into the input image
 // In this method, coordinates aren't normalized to 0-1 range
 void drawBoundingBoxes(const std::vector<std::vector<float>>& outputs, cv::Mat& image)
 {
-  std::vector<std::vector<float>> boxesToDraw;
-
-  // First output will always be drawn
-  boxesToDraw.push_back(outputs[0]);
+  // Rows are drawn in place, consecutive duplicates are skipped like in
+  // readDetections
+  for(size_t i = 0; i < outputs.size(); i++){
+    const std::vector<float>& vec = outputs[i];
 
-  for(size_t i = 1; i < outputs.size() - 1; i++){
-    if(outputs[i] != outputs[i-1]){
-      boxesToDraw.push_back(outputs[i]);
+    if(i > 0 && vec == outputs[i-1]){
+      continue;
     }
-  }
 
-  for(std::vector<float>& vec : boxesToDraw){
     int imgNum = vec[0];
     int ymin   = vec[1];
     int xmin   = vec[2];
@@ -167,18 +177,13 @@ void drawBoundingBoxes(const std::vector<std::vector<float>>& outputs, cv::Mat&
 
 void drawBoundingBoxesScaled(const std::vector<std::vector<float>>& outputs, cv::Mat& image, const int scale)
 {
-  std::vector<std::vector<float>> boxesToDraw;
+  for(size_t i = 0; i < outputs.size(); i++){
+    const std::vector<float>& vec = outputs[i];
 
-  // First output will always be drawn
-  boxesToDraw.push_back(outputs[0]);
-
-  for(size_t i = 1; i < outputs.size() - 1; i++){
-    if(outputs[i] != outputs[i-1]){
-      boxesToDraw.push_back(outputs[i]);
+    if(i > 0 && vec == outputs[i-1]){
+      continue;
     }
-  }
 
-  for(std::vector<float>& vec : boxesToDraw){
     float ymin   = vec[0] * scale;
     float xmin   = vec[1] * scale;
     float ymax   = vec[2] * scale;
@@ -189,4 +194,31 @@ void drawBoundingBoxesScaled(const std::vector<std::vector<float>>& outputs, cv:
 
     cv::rectangle(image, topRight, botLeft, cv::Scalar(0, 255, 0));
   }
-}
\ No newline at end of file
+}
+
+void drawBoundingBoxesResized(const std::vector<std::vector<float>>& outputs, const bool keras,
+                              const int modelRes, cv::Mat& image)
+{
+  // Keras models output normalized coordinates, others model input pixels
+  float scaleX = keras ? image.cols : static_cast<float>(image.cols) / modelRes;
+  float scaleY = keras ? image.rows : static_cast<float>(image.rows) / modelRes;
+  int   offset = keras ? 0 : 1;
+
+  for(size_t i = 0; i < outputs.size(); i++){
+    const std::vector<float>& vec = outputs[i];
+
+    if(i > 0 && vec == outputs[i-1]){
+      continue;
+    }
+
+    float ymin = vec[offset + 0] * scaleY;
+    float xmin = vec[offset + 1] * scaleX;
+    float ymax = vec[offset + 2] * scaleY;
+    float xmax = vec[offset + 3] * scaleX;
+
+    cv::Point topRight(xmin, ymin);
+    cv::Point botLeft(xmax, ymax);
+
+    cv::rectangle(image, topRight, botLeft, cv::Scalar(0, 255, 0));
+  }
+}
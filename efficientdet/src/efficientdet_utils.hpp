@@ -6,6 +6,7 @@
 #ifndef EFFICIENTDET_UTILS
 #define EFFICIENTDET_UTILS
 
+#include <chrono>
 #include <iostream>
 #include <vector>
 #include "opencv2/opencv.hpp"
@@ -21,11 +22,12 @@ std::string toUpperCase(const std::string& str);
 
 /*
 	Performs a single inference with time measurement. Time measurement is then
-	used to estimate FPS.
+	used to estimate FPS. Measured in microseconds, so short inferences are not
+	rounded to whole milliseconds.
 
 	interpreter: pointer to TfLite::Interpreter instance
 */
-std::chrono::milliseconds timedInference(tflite::Interpreter* interpreter);
+std::chrono::microseconds timedInference(tflite::Interpreter* interpreter);
 
 
 /*
@@ -76,6 +78,16 @@ std::vector<std::vector<float>> getOutputVectors(const TfLiteTensor* tensor_ptr,
 	const int num_outputs,const int output_size);
 
 
+/*
+  Same as above, but fills an existing vector of outputs. Once outputs has been
+  filled, repeated calls with the same sizes do not allocate.
+
+	outputs: Vector of outputs to be (re)filled
+*/
+void getOutputVectors(const TfLiteTensor* tensor_ptr, const int num_outputs,
+	const int output_size, std::vector<std::vector<float>>& outputs);
+
+
 /*
   Draw bounding boxes from outputs to image. This function expects NON-NORMALIZED 
   bounding box coordinates. 
@@ -98,6 +110,20 @@ void drawBoundingBoxes(const std::vector<std::vector<float>>& outputs, cv::Mat&
 void drawBoundingBoxesScaled(const std::vector<std::vector<float>>& outputs, cv::Mat& image, const int scale);
 
 
+/*
+  Draw bounding boxes from outputs into an image of any resolution, ie. the
+  full-resolution input frame. Coordinates are scaled from the model input
+  resolution to the image size.
+
+	outputs : Vector of outputs from getOutputVectors()
+	keras   : True for Keras-converted models (normalized coordinates)
+	modelRes: Model input resolution
+	image   : cv::Mat structure to draw the boxes into
+*/
+void drawBoundingBoxesResized(const std::vector<std::vector<float>>& outputs, const bool keras,
+                              const int modelRes, cv::Mat& image);
+
+
 // Tensorflow Lite
 #define TFLITE_MINIMAL_CHECK(x)                              \
   if (!(x)) {                                                \
@@ -0,0 +1,226 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <chrono>
+#include <iostream>
+#include "thread_placement.hpp"
+#include "executor.hpp"
+
+namespace {
+
+// Executor and deque of the pool thread running, to keep its own submissions local
+thread_local const void* currentExecutor = nullptr;
+thread_local int         currentWorker   = -1;
+
+}
+
+FairExecutor::FairExecutor(int threads, int streams)
+  : queues(streams)
+{
+  for(int i = 0; i < threads; i++){
+    workers.emplace_back(&FairExecutor::run, this);
+  }
+}
+
+FairExecutor::~FairExecutor()
+{
+  // Queued tasks still run, they may be needed to finish a stream
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  ready.notify_all();
+
+  for(std::thread& worker : workers){
+    worker.join();
+  }
+}
+
+void FairExecutor::submit(int stream, std::function<void()> task)
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    queues[stream].push_back(std::move(task));
+    queued++;
+  }
+  ready.notify_one();
+}
+
+void FairExecutor::run()
+{
+  placeThread(THREAD_PREPROCESS);
+
+  while(true){
+    std::function<void()> task;
+
+    auto waitStart = std::chrono::steady_clock::now();
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      ready.wait(guard, [this]{ return queued > 0 || stopping; });
+      if(queued == 0){
+        return;
+      }
+
+      // The next stream with work after the one served last
+      while(queues[nextQueue].empty()){
+        nextQueue = (nextQueue + 1) % queues.size();
+      }
+      task = std::move(queues[nextQueue].front());
+      queues[nextQueue].pop_front();
+      nextQueue = (nextQueue + 1) % queues.size();
+      queued--;
+    }
+
+    auto taskStart = std::chrono::steady_clock::now();
+    task();
+    auto taskEnd = std::chrono::steady_clock::now();
+
+    tasks++;
+    idleUs += std::chrono::duration_cast<std::chrono::microseconds>(taskStart - waitStart).count();
+    busyUs += std::chrono::duration_cast<std::chrono::microseconds>(taskEnd - taskStart).count();
+  }
+}
+
+void FairExecutor::printStats() const
+{
+  std::cout << "Executor (fair, " << workers.size() << " threads): " << tasks << " tasks, busy "
+            << busyUs / 1000 << " ms, idle " << idleUs / 1000 << " ms" << std::endl;
+}
+
+StealingExecutor::StealingExecutor(int threads)
+{
+  for(int i = 0; i < threads; i++){
+    queues.emplace_back(new Worker());
+  }
+  for(int i = 0; i < threads; i++){
+    workers.emplace_back(&StealingExecutor::run, this, i);
+  }
+}
+
+StealingExecutor::~StealingExecutor()
+{
+  // Queued tasks still run, they may be needed to finish a stream
+  {
+    std::lock_guard<std::mutex> guard(parkLock);
+    stopping = true;
+  }
+  parked.notify_all();
+
+  for(std::thread& worker : workers){
+    worker.join();
+  }
+}
+
+void StealingExecutor::submit(int stream, std::function<void()> task)
+{
+  size_t index = (currentExecutor == this) ? currentWorker : nextQueue++ % queues.size();
+
+  {
+    std::lock_guard<std::mutex> guard(queues[index]->lock);
+    queues[index]->tasks.push_back(std::move(task));
+  }
+  pending++;
+
+  // The lock orders this wake-up after a parking thread checked pending
+  {
+    std::lock_guard<std::mutex> guard(parkLock);
+  }
+  parked.notify_one();
+}
+
+bool StealingExecutor::take(int index, std::function<void()>& task)
+{
+  // Newest task of the own deque first
+  {
+    Worker& own = *queues[index];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if(!own.tasks.empty()){
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      pending--;
+      return true;
+    }
+  }
+
+  // Then the oldest task of the others
+  for(size_t i = 1; i < queues.size(); i++){
+    Worker& victim = *queues[(index + i) % queues.size()];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if(!victim.tasks.empty()){
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      pending--;
+      queues[index]->stolen++;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void StealingExecutor::run(int index)
+{
+  currentExecutor = this;
+  currentWorker   = index;
+  placeThread(THREAD_PREPROCESS);
+
+  auto waitStart = std::chrono::steady_clock::now();
+
+  while(true){
+    std::function<void()> task;
+
+    if(!take(index, task)){
+      std::unique_lock<std::mutex> guard(parkLock);
+      if(pending <= 0){
+        if(stopping){
+          return;
+        }
+        parks++;
+        parked.wait(guard, [this]{ return pending > 0 || stopping; });
+      }
+      continue;
+    }
+
+    auto taskStart = std::chrono::steady_clock::now();
+    task();
+    auto taskEnd = std::chrono::steady_clock::now();
+
+    queues[index]->ran++;
+    idleUs += std::chrono::duration_cast<std::chrono::microseconds>(taskStart - waitStart).count();
+    busyUs += std::chrono::duration_cast<std::chrono::microseconds>(taskEnd - taskStart).count();
+    waitStart = taskEnd;
+  }
+}
+
+void StealingExecutor::printStats() const
+{
+  uint64_t tasks  = 0;
+  uint64_t steals = 0;
+  for(const std::unique_ptr<Worker>& queue : queues){
+    tasks  += queue->ran;
+    steals += queue->stolen;
+  }
+
+  std::cout << "Executor (steal, " << workers.size() << " threads): " << tasks << " tasks, " << steals
+            << " steals, " << parks << " parks, busy " << busyUs / 1000 << " ms, idle " << idleUs / 1000
+            << " ms" << std::endl;
+
+  for(size_t i = 0; i < queues.size(); i++){
+    std::cout << "  thread " << i << ": " << queues[i]->ran << " tasks, " << queues[i]->stolen << " stolen" << std::endl;
+  }
+}
+
+std::unique_ptr<Executor> createExecutor(const std::string& kind, int threads, int streams)
+{
+  if(kind == "fair"){
+    return std::unique_ptr<Executor>(new FairExecutor(threads, streams));
+  }
+  if(kind == "steal"){
+    return std::unique_ptr<Executor>(new StealingExecutor(threads));
+  }
+
+  std::cout << "Unknown scheduler " << kind << std::endl;
+  return nullptr;
+}
@@ -0,0 +1,121 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef EXECUTOR
+#define EXECUTOR
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+	Runs short pipeline tasks (decode, preprocessing, postprocessing, drawing,
+	encoding) of several streams on a fixed set of threads. Tasks of one
+	stream may run on any thread; ordering between them is up to the caller.
+*/
+class Executor {
+public:
+  virtual ~Executor() = default;
+
+  // Queue task on behalf of stream (0 ... streams - 1)
+  virtual void submit(int stream, std::function<void()> task) = 0;
+
+  // Prints tasks run, busy and idle time of the threads
+  virtual void printStats() const = 0;
+};
+
+
+/*
+	Executor with one queue per stream. Idle threads serve the streams round
+	robin, so a stream queueing many or long tasks can not starve the others.
+
+	threads: Number of worker threads
+	streams: Number of streams submitting tasks
+*/
+class FairExecutor : public Executor {
+public:
+  FairExecutor(int threads, int streams);
+  ~FairExecutor() override;
+
+  void submit(int stream, std::function<void()> task) override;
+  void printStats() const override;
+
+private:
+  void run();
+
+  std::vector<std::deque<std::function<void()>>> queues;
+  size_t                                         nextQueue = 0;
+  size_t                                         queued    = 0;
+  bool                                           stopping  = false;
+  mutable std::mutex                             lock;
+  std::condition_variable                        ready;
+  std::vector<std::thread>                       workers;
+
+  std::atomic<uint64_t> tasks{0};
+  std::atomic<int64_t>  busyUs{0};
+  std::atomic<int64_t>  idleUs{0};
+};
+
+
+/*
+	Work-stealing executor with one deque per thread. Tasks submitted from a
+	pool thread (ie. a postprocessing task queueing the next decode) go to the
+	back of that thread's deque and run there next while its caches are warm;
+	tasks from other threads are spread round robin. A thread whose deque is
+	empty steals the oldest task of another thread before it parks, so no core
+	idles while work is queued anywhere, whatever the mix of stage costs.
+	Unlike FairExecutor it does not balance between streams.
+
+	threads: Number of worker threads
+*/
+class StealingExecutor : public Executor {
+public:
+  explicit StealingExecutor(int threads);
+  ~StealingExecutor() override;
+
+  void submit(int stream, std::function<void()> task) override;
+  void printStats() const override;
+
+private:
+  // Padded to a cache line so the threads' deque locks do not share one
+  struct alignas(64) Worker {
+    std::mutex                        lock;
+    std::deque<std::function<void()>> tasks;
+    std::atomic<uint64_t>             ran{0};
+    std::atomic<uint64_t>             stolen{0};
+  };
+
+  void run(int index);
+  bool take(int index, std::function<void()>& task);
+
+  std::vector<std::unique_ptr<Worker>> queues;
+  std::vector<std::thread>             workers;
+  std::atomic<int64_t>                 pending{0};
+  std::atomic<size_t>                  nextQueue{0};
+
+  std::mutex              parkLock;
+  std::condition_variable parked;
+  bool                    stopping = false;
+
+  std::atomic<uint64_t> parks{0};
+  std::atomic<int64_t>  busyUs{0};
+  std::atomic<int64_t>  idleUs{0};
+};
+
+
+/*
+	Creates the executor selected by kind ("fair" or "steal"). Returns nullptr
+	for an unknown kind.
+*/
+std::unique_ptr<Executor> createExecutor(const std::string& kind, int threads, int streams);
+
+#endif
@@ -0,0 +1,277 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include "frame_pool.hpp"
+
+FrameBuffer::FrameBuffer(const FrameBuffer& other)
+  : mat(other.mat), pool(other.pool), slot(other.slot)
+{
+  if(pool){
+    pool->addRef(slot);
+  }
+}
+
+FrameBuffer::FrameBuffer(FrameBuffer&& other) noexcept
+  : mat(std::move(other.mat)), pool(other.pool), slot(other.slot)
+{
+  other.pool = nullptr;
+  other.slot = -1;
+}
+
+FrameBuffer& FrameBuffer::operator=(const FrameBuffer& other)
+{
+  if(this != &other){
+    if(other.pool){
+      other.pool->addRef(other.slot);
+    }
+    release();
+    mat  = other.mat;
+    pool = other.pool;
+    slot = other.slot;
+  }
+  return *this;
+}
+
+FrameBuffer& FrameBuffer::operator=(FrameBuffer&& other) noexcept
+{
+  if(this != &other){
+    release();
+    mat  = std::move(other.mat);
+    pool = other.pool;
+    slot = other.slot;
+    other.pool = nullptr;
+    other.slot = -1;
+  }
+  return *this;
+}
+
+FrameBuffer::~FrameBuffer()
+{
+  release();
+}
+
+void FrameBuffer::release()
+{
+  if(pool){
+    pool->unref(slot, mat);
+  }
+  pool = nullptr;
+  slot = -1;
+  mat  = cv::Mat();
+}
+
+FramePool::FramePool(const std::string& name, cv::Size size, int type, int capacity)
+  : poolName(name), frameSize(size), frameType(type)
+{
+  size_t rowBytes = static_cast<size_t>(size.width) * CV_ELEM_SIZE(type);
+  size_t bytes    = rowBytes * size.height;
+
+  // Round up so consecutive buffers keep the alignment when packed
+  bytesPerBuffer = (bytes + FRAME_POOL_ALIGNMENT - 1) / FRAME_POOL_ALIGNMENT * FRAME_POOL_ALIGNMENT;
+
+  refs.reset(new std::atomic<int>[capacity]);
+  freeSlots.reserve(capacity);
+
+  for(int i = 0; i < capacity; i++){
+    void* buffer = nullptr;
+    if(posix_memalign(&buffer, FRAME_POOL_ALIGNMENT, bytesPerBuffer) != 0){
+      fprintf(stderr, "Failed to allocate %zu bytes for frame pool '%s'\n", bytesPerBuffer, name.c_str());
+      exit(1);
+    }
+    buffers.push_back(buffer);
+    refs[i] = 0;
+    // Hand out low slots first
+    freeSlots.push_back(capacity - 1 - i);
+  }
+}
+
+FramePool::FramePool(const std::string& name, cv::Size size, int type,
+                     const std::vector<void*>& external, std::function<void(int)> onRelease)
+  : poolName(name), frameSize(size), frameType(type),
+    bytesPerBuffer(static_cast<size_t>(size.width) * size.height * CV_ELEM_SIZE(type)),
+    buffers(external), ownsBuffers(false), releaseHook(std::move(onRelease))
+{
+  refs.reset(new std::atomic<int>[buffers.size()]);
+  freeSlots.reserve(buffers.size());
+
+  for(size_t i = 0; i < buffers.size(); i++){
+    refs[i] = 0;
+    freeSlots.push_back(static_cast<int>(buffers.size() - 1 - i));
+  }
+}
+
+FramePool::~FramePool()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  if(counters.inUse != 0){
+    fprintf(stderr, "Frame pool '%s' destroyed with %d buffers in use\n", poolName.c_str(), counters.inUse);
+  }
+
+  if(ownsBuffers){
+    for(void* buffer : buffers){
+      free(buffer);
+    }
+  }
+}
+
+FrameBuffer FramePool::take(int slot)
+{
+  FrameBuffer buffer;
+  buffer.mat  = cv::Mat(frameSize, frameType, buffers[slot]);
+  buffer.pool = this;
+  buffer.slot = slot;
+  refs[slot]  = 1;
+  return buffer;
+}
+
+FrameBuffer FramePool::acquire()
+{
+  std::unique_lock<std::mutex> guard(lock);
+
+  if(freeSlots.empty()){
+    counters.waits++;
+    freed.wait(guard, [this]{ return !freeSlots.empty(); });
+  }
+
+  int slot = freeSlots.back();
+  freeSlots.pop_back();
+
+  counters.acquires++;
+  counters.inUse++;
+  counters.peakInUse = std::max(counters.peakInUse, counters.inUse);
+
+  return take(slot);
+}
+
+bool FramePool::tryAcquire(FrameBuffer& buffer)
+{
+  std::unique_lock<std::mutex> guard(lock);
+
+  if(freeSlots.empty()){
+    return false;
+  }
+
+  int slot = freeSlots.back();
+  freeSlots.pop_back();
+
+  counters.acquires++;
+  counters.inUse++;
+  counters.peakInUse = std::max(counters.peakInUse, counters.inUse);
+
+  guard.unlock();
+  buffer = take(slot);
+  return true;
+}
+
+FrameBuffer FramePool::wrap(int slot)
+{
+  std::unique_lock<std::mutex> guard(lock);
+
+  freeSlots.erase(std::remove(freeSlots.begin(), freeSlots.end(), slot), freeSlots.end());
+
+  counters.acquires++;
+  counters.inUse++;
+  counters.peakInUse = std::max(counters.peakInUse, counters.inUse);
+
+  guard.unlock();
+  return take(slot);
+}
+
+void FramePool::addRef(int slot)
+{
+  refs[slot].fetch_add(1, std::memory_order_relaxed);
+}
+
+void FramePool::unref(int slot, const cv::Mat& mat)
+{
+  if(refs[slot].fetch_sub(1, std::memory_order_acq_rel) != 1){
+    return;
+  }
+
+  std::unique_lock<std::mutex> guard(lock);
+
+  // An empty mat is a regular end of stream, not a reallocation
+  if(!mat.empty() && mat.data != buffers[slot]){
+    counters.escapes++;
+  }
+
+  counters.inUse--;
+  freeSlots.push_back(slot);
+  freed.notify_one();
+
+  guard.unlock();
+
+  if(releaseHook){
+    releaseHook(slot);
+  }
+}
+
+FramePoolStats FramePool::stats() const
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return counters;
+}
+
+std::atomic<uint64_t> MatAllocationCounter::count{0};
+
+void MatAllocationCounter::install()
+{
+  static MatAllocationCounter counter;
+  cv::Mat::setDefaultAllocator(&counter);
+}
+
+uint64_t MatAllocationCounter::allocations()
+{
+  return count.load(std::memory_order_relaxed);
+}
+
+cv::UMatData* MatAllocationCounter::allocate(int dims, const int* sizes, int type, void* data,
+                                             size_t* step, cv::AccessFlag flags,
+                                             cv::UMatUsageFlags usageFlags) const
+{
+  // User-provided data (ie. pooled buffers) is only wrapped, not allocated
+  if(data == nullptr){
+    count.fetch_add(1, std::memory_order_relaxed);
+  }
+  return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+}
+
+bool MatAllocationCounter::allocate(cv::UMatData* data, cv::AccessFlag accessFlags,
+                                    cv::UMatUsageFlags usageFlags) const
+{
+  return cv::Mat::getStdAllocator()->allocate(data, accessFlags, usageFlags);
+}
+
+void MatAllocationCounter::deallocate(cv::UMatData* data) const
+{
+  cv::Mat::getStdAllocator()->deallocate(data);
+}
+
+void printFramePoolStats(const std::vector<const FramePool*>& pools,
+                         uint64_t steadyStateAllocs, int frames)
+{
+  std::cout << "Frame buffer pools:" << std::endl;
+
+  for(const FramePool* pool : pools){
+    FramePoolStats s = pool->stats();
+    std::cout << "  " << pool->name() << ": "
+              << pool->capacity() << " x " << pool->size().width << "x" << pool->size().height
+              << " (" << pool->totalBytes() / 1024 << " KiB)"
+              << ", acquires " << s.acquires
+              << ", waits " << s.waits
+              << ", peak in use " << s.peakInUse
+              << ", escaped " << s.escapes << std::endl;
+  }
+
+  std::cout << "  cv::Mat allocations after first frame: " << steadyStateAllocs;
+  if(frames > 0){
+    std::cout << " (" << static_cast<double>(steadyStateAllocs) / frames << " per frame)";
+  }
+  std::cout << std::endl;
+}
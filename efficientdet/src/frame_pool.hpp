@@ -0,0 +1,169 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef FRAME_POOL
+#define FRAME_POOL
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "opencv2/opencv.hpp"
+
+// Pooled buffers are aligned so they can be handed to SIMD kernels and
+// TfLite tensors directly.
+constexpr size_t FRAME_POOL_ALIGNMENT = 64;
+
+class FramePool;
+
+/*
+	Reference-counted handle to one buffer of a FramePool. Copies share the
+	buffer, which returns to its pool when the last handle is released.
+
+	mat: Header over the pooled memory. OpenCV functions writing into mat reuse
+	     the memory as long as size and type match the pool. If they do not,
+	     OpenCV reallocates mat and the pool counts the buffer as escaped.
+*/
+class FrameBuffer {
+public:
+  FrameBuffer() = default;
+  FrameBuffer(const FrameBuffer& other);
+  FrameBuffer(FrameBuffer&& other) noexcept;
+  FrameBuffer& operator=(const FrameBuffer& other);
+  FrameBuffer& operator=(FrameBuffer&& other) noexcept;
+  ~FrameBuffer();
+
+  bool empty() const { return pool == nullptr; }
+  void release();
+
+  cv::Mat mat;
+
+private:
+  friend class FramePool;
+
+  FramePool* pool = nullptr;
+  int        slot = -1;
+};
+
+
+struct FramePoolStats {
+  uint64_t acquires = 0;   // Buffers handed out
+  uint64_t waits    = 0;   // Acquires that had to wait for a free buffer
+  uint64_t escapes  = 0;   // Buffers whose mat was reallocated by the caller
+  int      inUse    = 0;
+  int      peakInUse = 0;
+};
+
+
+/*
+	Fixed set of preallocated, equally sized frame buffers for one pipeline
+	stage. All memory is allocated in the constructor, acquire() never
+	allocates.
+
+	name:     Stage name used in reports
+	size:     Frame size of every buffer
+	type:     OpenCV type of every buffer (ie. CV_8UC3)
+	capacity: Number of buffers, ie. how many frames of this stage can be
+	          in flight at the same time
+*/
+class FramePool {
+public:
+  FramePool(const std::string& name, cv::Size size, int type, int capacity);
+
+  /*
+		Pool over memory owned by someone else, ie. the slots of a shared-memory
+		ring. Buffers are handed out with wrap() instead of acquire(), and
+		onRelease is called with the slot index once the last handle of a
+		buffer is released.
+	*/
+  FramePool(const std::string& name, cv::Size size, int type,
+            const std::vector<void*>& external, std::function<void(int)> onRelease);
+  ~FramePool();
+
+  FramePool(const FramePool&) = delete;
+  FramePool& operator=(const FramePool&) = delete;
+
+  // Blocks until a buffer is free
+  FrameBuffer acquire();
+
+  // Returns false instead of blocking when every buffer is in use
+  bool tryAcquire(FrameBuffer& buffer);
+
+  // Hands out the given slot, which must not be in use
+  FrameBuffer wrap(int slot);
+
+  const std::string& name() const { return poolName; }
+  cv::Size size() const { return frameSize; }
+  int      type() const { return frameType; }
+  int      capacity() const { return static_cast<int>(buffers.size()); }
+  size_t   bufferBytes() const { return bytesPerBuffer; }
+  size_t   totalBytes() const { return bytesPerBuffer * buffers.size(); }
+
+  FramePoolStats stats() const;
+
+private:
+  friend class FrameBuffer;
+
+  FrameBuffer take(int slot);
+  void addRef(int slot);
+  void unref(int slot, const cv::Mat& mat);
+
+  std::string poolName;
+  cv::Size    frameSize;
+  int         frameType;
+  size_t      bytesPerBuffer;
+
+  std::vector<void*>               buffers;
+  bool                             ownsBuffers = true;
+  std::function<void(int)>         releaseHook;
+  std::unique_ptr<std::atomic<int>[]> refs;
+
+  mutable std::mutex      lock;
+  std::condition_variable freed;
+  std::vector<int>        freeSlots;
+  FramePoolStats          counters;
+};
+
+
+/*
+	Counts every cv::Mat allocation in the process by installing itself as
+	OpenCV's default allocator. Used to prove that the steady-state frame loop
+	allocates no image buffers: take a snapshot after the first frame and
+	compare it with the count at the end. Other heap allocations (ie. strings
+	or vectors) are not counted, the loop avoids them by reusing its buffers.
+*/
+class MatAllocationCounter : public cv::MatAllocator {
+public:
+  static void install();
+  static uint64_t allocations();
+
+  cv::UMatData* allocate(int dims, const int* sizes, int type, void* data,
+                         size_t* step, cv::AccessFlag flags,
+                         cv::UMatUsageFlags usageFlags) const override;
+  bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags,
+                cv::UMatUsageFlags usageFlags) const override;
+  void deallocate(cv::UMatData* data) const override;
+
+private:
+  static std::atomic<uint64_t> count;
+};
+
+
+/*
+	Prints per-stage pool statistics and the number of cv::Mat allocations
+	made after the warm-up frame.
+
+	pools:           Pools used by the frame loop
+	steadyStateAllocs: Mat allocations counted after the first frame
+	frames:          Number of frames processed after the first frame
+*/
+void printFramePoolStats(const std::vector<const FramePool*>& pools,
+                         uint64_t steadyStateAllocs, int frames);
+
+#endif
@@ -0,0 +1,194 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifdef EFFICIENTDET_GSTREAMER
+
+#include <iostream>
+#include <sstream>
+#include <gst/app/gstappsink.h>
+#include <gst/video/video.h>
+#include "gst_source.hpp"
+
+namespace {
+
+// How long a pull waits for a sample before the bus is checked for errors
+const GstClockTime PULL_TIMEOUT = 100 * GST_MSECOND;
+
+}
+
+GstPipelineSource::GstPipelineSource(const std::string& path, int modelRes, bool withFull, int depth)
+{
+  // Frame rate, count and source size are not known before the pipeline
+  // prerolls, read them from the container instead
+  cv::VideoCapture probe(path);
+  if(!probe.isOpened()){
+    return;
+  }
+  sourceInfo = readSourceInfo(probe);
+  probe.release();
+
+  gst_init(nullptr, nullptr);
+
+  // The first videoconvert is a passthrough whenever videoscale accepts the
+  // decoder's output format directly
+  std::stringstream modelBranch;
+  modelBranch << "videoconvert ! videoscale add-borders=false ! "
+              << "video/x-raw,width=" << modelRes << ",height=" << modelRes << " ! "
+              << "videoconvert ! video/x-raw,format=RGB ! "
+              << "appsink name=model sync=false max-buffers=2";
+
+  std::stringstream launch;
+  launch << "filesrc location=\"" << path << "\" ! decodebin ! ";
+
+  if(withFull){
+    launch << "tee name=t "
+           << "t. ! queue ! videoconvert ! video/x-raw,format=BGR ! appsink name=full sync=false max-buffers=2 "
+           << "t. ! queue ! " << modelBranch.str();
+  }
+  else{
+    launch << modelBranch.str();
+  }
+
+  description = "gstreamer '" + launch.str() + "'";
+
+  GError* error = nullptr;
+  pipeline = gst_parse_launch(launch.str().c_str(), &error);
+  if(error){
+    std::cout << "Failed to build GStreamer pipeline: " << error->message << std::endl;
+    g_error_free(error);
+    close();
+    return;
+  }
+
+  modelSink = gst_bin_get_by_name(GST_BIN(pipeline), "model");
+  if(withFull){
+    fullSink = gst_bin_get_by_name(GST_BIN(pipeline), "full");
+  }
+
+  if(gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE ||
+     gst_element_get_state(pipeline, nullptr, nullptr, GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_FAILURE){
+    std::cout << "Failed to start GStreamer pipeline" << std::endl;
+    close();
+    return;
+  }
+
+  modelPool.reset(new FramePool("model", cv::Size(modelRes, modelRes), CV_8UC3, depth));
+  if(withFull){
+    fullPool.reset(new FramePool("capture", sourceInfo.frameSize, CV_8UC3, depth));
+  }
+}
+
+GstPipelineSource::~GstPipelineSource()
+{
+  close();
+}
+
+void GstPipelineSource::close()
+{
+  if(modelSink){
+    gst_object_unref(modelSink);
+    modelSink = nullptr;
+  }
+  if(fullSink){
+    gst_object_unref(fullSink);
+    fullSink = nullptr;
+  }
+  if(pipeline){
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+    pipeline = nullptr;
+  }
+}
+
+bool GstPipelineSource::checkBus()
+{
+  GstBus*     bus     = gst_element_get_bus(pipeline);
+  GstMessage* message = gst_bus_pop_filtered(bus, GST_MESSAGE_ERROR);
+  gst_object_unref(bus);
+  if(!message){
+    return false;
+  }
+
+  GError* error = nullptr;
+  gchar*  debug = nullptr;
+  gst_message_parse_error(message, &error, &debug);
+  std::cout << "GStreamer error from " << GST_OBJECT_NAME(GST_MESSAGE_SRC(message)) << ": " << error->message;
+  if(debug){
+    std::cout << " (" << debug << ")";
+  }
+  std::cout << std::endl;
+
+  g_error_free(error);
+  g_free(debug);
+  gst_message_unref(message);
+  failed = true;
+  return true;
+}
+
+bool GstPipelineSource::pull(GstElement* sink, FramePool& pool, FrameBuffer& buffer)
+{
+  // A failing element stops the stream without an EOS, the appsink would
+  // wait forever. Pull with a timeout and check the bus in between.
+  GstSample* sample = nullptr;
+  while(!failed && !sample){
+    sample = gst_app_sink_try_pull_sample(GST_APP_SINK(sink), PULL_TIMEOUT);
+    if(!sample && (checkBus() || gst_app_sink_is_eos(GST_APP_SINK(sink)))){
+      return false;
+    }
+  }
+  if(!sample){
+    return false;
+  }
+
+  GstVideoInfo videoInfo;
+  GstBuffer*   gstBuffer = gst_sample_get_buffer(sample);
+  GstMapInfo   map;
+
+  if(!gst_video_info_from_caps(&videoInfo, gst_sample_get_caps(sample)) ||
+     !gst_buffer_map(gstBuffer, &map, GST_MAP_READ)){
+    gst_sample_unref(sample);
+    return false;
+  }
+
+  // GStreamer pads rows to 4 bytes, so honour the stride
+  cv::Mat mapped(GST_VIDEO_INFO_HEIGHT(&videoInfo), GST_VIDEO_INFO_WIDTH(&videoInfo), CV_8UC3,
+                 map.data, GST_VIDEO_INFO_PLANE_STRIDE(&videoInfo, 0));
+
+  buffer = pool.acquire();
+  mapped.copyTo(buffer.mat);
+
+  gst_buffer_unmap(gstBuffer, &map);
+  gst_sample_unref(sample);
+  return true;
+}
+
+bool GstPipelineSource::read(Frame& frame)
+{
+  frame.full.release();
+  frame.model.release();
+
+  if(!pull(modelSink, *modelPool, frame.model)){
+    return false;
+  }
+
+  // Both branches have to be drained, otherwise the tee stalls
+  if(fullSink && !pull(fullSink, *fullPool, frame.full)){
+    frame.model.release();
+    return false;
+  }
+
+  return true;
+}
+
+std::vector<const FramePool*> GstPipelineSource::pools() const
+{
+  std::vector<const FramePool*> result{modelPool.get()};
+  if(fullPool){
+    result.push_back(fullPool.get());
+  }
+  return result;
+}
+
+#endif
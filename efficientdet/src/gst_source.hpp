@@ -0,0 +1,60 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef GST_SOURCE
+#define GST_SOURCE
+
+#ifdef EFFICIENTDET_GSTREAMER
+
+#include <memory>
+#include <string>
+#include <gst/gst.h>
+#include "video_source.hpp"
+
+/*
+	Decodes a video file with a GStreamer pipeline that scales and converts the
+	frames before they reach the application:
+
+	  filesrc ! decodebin ! videoconvert ! videoscale ! videoconvert ! appsink (RGB, modelRes)
+
+	Scaling happens before the final conversion, so the colour conversion only
+	touches model-resolution pixels. With withFull the decoded stream is split
+	by a tee and a second appsink delivers the full-resolution BGR frame, both
+	from a single decode. An error posted by an element ends the stream and is
+	printed, instead of being taken for the end of the file.
+
+	path:     Path to the input video file
+	modelRes: Model input resolution
+	withFull: Also deliver full-resolution BGR frames
+	depth:    Number of frames the caller may hold at the same time
+*/
+class GstPipelineSource : public FrameSource {
+public:
+  GstPipelineSource(const std::string& path, int modelRes, bool withFull, int depth);
+  ~GstPipelineSource() override;
+
+  bool isOpened() const override { return pipeline != nullptr; }
+  bool read(Frame& frame) override;
+  std::string describe() const override { return description; }
+  std::vector<const FramePool*> pools() const override;
+
+private:
+  bool pull(GstElement* sink, FramePool& pool, FrameBuffer& buffer);
+  bool checkBus();
+  void close();
+
+  std::string description;
+  GstElement* pipeline  = nullptr;
+  GstElement* modelSink = nullptr;
+  GstElement* fullSink  = nullptr;
+  bool        failed    = false;
+
+  std::unique_ptr<FramePool> modelPool;
+  std::unique_ptr<FramePool> fullPool;
+};
+
+#endif
+
+#endif
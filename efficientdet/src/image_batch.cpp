@@ -0,0 +1,323 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "efficientdet_utils.hpp"
+#include "bounded_queue.hpp"
+#include "stage_stats.hpp"
+#include "thread_placement.hpp"
+#include "image_batch.hpp"
+
+namespace {
+
+struct DecodedImage {
+  std::string path;
+  cv::Mat     rgb;          // Model input, MODEL_RES x MODEL_RES RGB
+  int         factor = 1;   // IMREAD_REDUCED factor used for decoding
+};
+
+bool hasImageExtension(const std::string& name)
+{
+  size_t dot = name.find_last_of('.');
+  if(dot == std::string::npos){
+    return false;
+  }
+
+  std::string ext = toUpperCase(name.substr(dot + 1));
+  return ext == "JPG" || ext == "JPEG" || ext == "PNG" || ext == "BMP";
+}
+
+bool isJpeg(const std::string& path)
+{
+  size_t dot = path.find_last_of('.');
+  if(dot == std::string::npos){
+    return false;
+  }
+
+  std::string ext = toUpperCase(path.substr(dot + 1));
+  return ext == "JPG" || ext == "JPEG";
+}
+
+uint32_t readBigEndian(const unsigned char* bytes, int count)
+{
+  uint32_t value = 0;
+  for(int i = 0; i < count; i++){
+    value = (value << 8) | bytes[i];
+  }
+  return value;
+}
+
+// Walks the JPEG markers up to the first start-of-frame segment
+bool readJpegSize(FILE* file, cv::Size& size)
+{
+  unsigned char bytes[8];
+
+  if(fread(bytes, 1, 2, file) != 2 || bytes[0] != 0xFF || bytes[1] != 0xD8){
+    return false;
+  }
+
+  while(true){
+    int marker;
+    do{
+      marker = fgetc(file);
+    }while(marker == 0xFF);
+
+    if(marker == EOF || marker == 0xD9 || marker == 0xDA){
+      return false;
+    }
+
+    // Standalone markers without a length
+    if(marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)){
+      continue;
+    }
+
+    if(fread(bytes, 1, 2, file) != 2){
+      return false;
+    }
+    uint32_t length = readBigEndian(bytes, 2);
+    if(length < 2){
+      return false;
+    }
+
+    // SOF0 - SOF15, except DHT (C4), JPG (C8) and DAC (CC)
+    if(marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC){
+      if(fread(bytes, 1, 5, file) != 5){
+        return false;
+      }
+      size = cv::Size(readBigEndian(bytes + 3, 2), readBigEndian(bytes + 1, 2));
+      return size.width > 0 && size.height > 0;
+    }
+
+    if(fseek(file, length - 2, SEEK_CUR) != 0){
+      return false;
+    }
+
+    // Skip the 0xFF prefix of the next marker
+    if(fgetc(file) != 0xFF){
+      return false;
+    }
+  }
+}
+
+bool readPngSize(FILE* file, cv::Size& size)
+{
+  static const unsigned char SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  unsigned char bytes[24];
+
+  if(fread(bytes, 1, sizeof(bytes), file) != sizeof(bytes) ||
+     memcmp(bytes, SIGNATURE, sizeof(SIGNATURE)) != 0 || memcmp(bytes + 12, "IHDR", 4) != 0){
+    return false;
+  }
+
+  size = cv::Size(readBigEndian(bytes + 16, 4), readBigEndian(bytes + 20, 4));
+  return size.width > 0 && size.height > 0;
+}
+
+bool decodeImage(const std::string& path, int modelRes, bool reduced, DecodedImage& image)
+{
+  int flags = cv::IMREAD_COLOR;
+  image.factor = 1;
+
+  // Only the JPEG decoder scales in the DCT domain, other formats would be
+  // decoded at full size and shrunk afterwards anyway
+  cv::Size size;
+  if(reduced && isJpeg(path) && readImageSize(path, size)){
+    image.factor = reducedDecodeFactor(size, modelRes);
+    switch(image.factor){
+      case 8: flags = cv::IMREAD_REDUCED_COLOR_8; break;
+      case 4: flags = cv::IMREAD_REDUCED_COLOR_4; break;
+      case 2: flags = cv::IMREAD_REDUCED_COLOR_2; break;
+      default: break;
+    }
+  }
+
+  cv::Mat img = cv::imread(path, flags);
+  if(img.empty()){
+    return false;
+  }
+
+  // Resize before the channel swap, like the video frame loop
+  cv::Mat scaledImg;
+  cv::resize(img, scaledImg, cv::Size(modelRes, modelRes), 0, 0, cv::INTER_CUBIC);
+  cv::cvtColor(scaledImg, image.rgb, cv::COLOR_BGR2RGB);
+
+  image.path = path;
+  return true;
+}
+
+}
+
+bool listImages(const std::string& path, std::vector<std::string>& images)
+{
+  images.clear();
+
+  struct stat st;
+  if(stat(path.c_str(), &st) != 0){
+    std::cout << "Failed to open " << path << std::endl;
+    return false;
+  }
+
+  if(S_ISDIR(st.st_mode)){
+    DIR* dir = opendir(path.c_str());
+    if(!dir){
+      std::cout << "Failed to open directory " << path << std::endl;
+      return false;
+    }
+
+    while(struct dirent* entry = readdir(dir)){
+      std::string name = entry->d_name;
+      if(hasImageExtension(name)){
+        images.push_back(path + "/" + name);
+      }
+    }
+    closedir(dir);
+
+    std::sort(images.begin(), images.end());
+    return true;
+  }
+
+  std::ifstream manifest(path);
+  if(!manifest){
+    std::cout << "Failed to open manifest " << path << std::endl;
+    return false;
+  }
+
+  size_t slash = path.find_last_of('/');
+  std::string baseDir = (slash == std::string::npos) ? "" : path.substr(0, slash + 1);
+
+  std::string line;
+  while(std::getline(manifest, line)){
+    line.erase(line.find_last_not_of(" \t\r") + 1);
+    if(line.empty() || line[0] == '#'){
+      continue;
+    }
+    images.push_back(line[0] == '/' ? line : baseDir + line);
+  }
+
+  return true;
+}
+
+bool readImageSize(const std::string& path, cv::Size& size)
+{
+  FILE* file = fopen(path.c_str(), "rb");
+  if(!file){
+    return false;
+  }
+
+  bool ok = isJpeg(path) ? readJpegSize(file, size) : readPngSize(file, size);
+  fclose(file);
+  return ok;
+}
+
+int reducedDecodeFactor(cv::Size size, int modelRes)
+{
+  int shortSide = std::min(size.width, size.height);
+
+  for(int factor = 8; factor > 1; factor /= 2){
+    if(shortSide / factor >= modelRes){
+      return factor;
+    }
+  }
+
+  return 1;
+}
+
+int runImageBatch(const std::vector<std::string>& images, Detector& detector,
+                  DetectionSink& detections, const ImageBatchOptions& options)
+{
+  int MODEL_RES = detector.resolution;
+
+  BoundedQueue<DecodedImage> decoded(std::max(1, options.queueDepth));
+  std::atomic<size_t> next(0);
+  std::atomic<int>    failed(0);
+  std::atomic<int>    factorCounts[4] = {};
+
+  StageStats decodeStats("decode");
+  StageStats inferenceStats("inference");
+
+  auto start = std::chrono::steady_clock::now();
+
+  // Decoders take the next image from a shared index until all are taken
+  auto decodeWorker = [&](){
+    placeThread(THREAD_CAPTURE);
+
+    while(true){
+      size_t index = next++;
+      if(index >= images.size()){
+        return;
+      }
+
+      auto decodeStart = std::chrono::steady_clock::now();
+
+      DecodedImage image;
+      if(!decodeImage(images[index], MODEL_RES, options.reduced, image)){
+        std::cout << "Failed to read image " << images[index] << std::endl;
+        failed++;
+        continue;
+      }
+
+      decodeStats.addSince(decodeStart);
+      factorCounts[image.factor == 8 ? 3 : image.factor / 2]++;
+
+      if(!decoded.push(std::move(image))){
+        return;
+      }
+    }
+  };
+
+  std::vector<std::thread> decoders;
+  for(int i = 0; i < std::max(1, options.decoders); i++){
+    decoders.emplace_back(decodeWorker);
+  }
+
+  // Close the queue once every decoder is done, so the loop below ends
+  std::thread closer([&](){
+    for(auto& decoder : decoders){
+      decoder.join();
+    }
+    decoded.close();
+  });
+
+  std::vector<std::vector<float>> outputs;
+  std::vector<Detection>          imageDetections;
+  DecodedImage                    image;
+  int                             processed = 0;
+
+  while(decoded.pop(image)){
+    memcpy(detector.inTensor->data.raw, image.rgb.data, MODEL_RES * MODEL_RES * 3);
+
+    inferenceStats.add(timedInference(detector.interpreter.get()));
+
+    getOutputVectors(detector.outTensor, outputRows(detector), outputValues(detector), outputs);
+    readDetections(detector, outputs, options.scoreThreshold, imageDetections);
+    detections.write(image.path, 0, imageDetections);
+
+    processed++;
+  }
+
+  closer.join();
+  detections.flush();
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::cout << "Processed " << processed << " of " << images.size() << " images in " << seconds
+            << " s (" << processed / seconds << " images/s), " << failed << " failed" << std::endl;
+  std::cout << "Decode scale factors: 1/1 " << factorCounts[0] << ", 1/2 " << factorCounts[1]
+            << ", 1/4 " << factorCounts[2] << ", 1/8 " << factorCounts[3] << std::endl;
+  std::cout << "Stage timings (decode per thread, " << options.decoders << " threads):" << std::endl;
+  decodeStats.print();
+  inferenceStats.print();
+
+  return processed;
+}
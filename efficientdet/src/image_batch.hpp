@@ -0,0 +1,66 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef IMAGE_BATCH
+#define IMAGE_BATCH
+
+#include <string>
+#include <vector>
+#include "opencv2/opencv.hpp"
+#include "detection_sink.hpp"
+#include "detector.hpp"
+
+/*
+	Options of the image batch mode.
+
+	decoders:   Number of decoder threads
+	queueDepth: Number of decoded images waiting for inference
+	reduced:    Let the JPEG decoder downscale large images while decoding
+	            (cv::IMREAD_REDUCED_COLOR_2/4/8)
+*/
+struct ImageBatchOptions {
+  int   decoders       = 2;
+  int   queueDepth     = 8;
+  bool  reduced        = true;
+  float scoreThreshold = 0.3f;
+};
+
+
+/*
+	Lists the images to process. A directory gives its .jpg, .jpeg, .png and
+	.bmp files sorted by name, any other file is read as a manifest with one
+	image path per line (empty lines and lines starting with '#' are skipped).
+	Relative manifest entries are resolved against the manifest's directory.
+
+	Returns false if path can not be read.
+*/
+bool listImages(const std::string& path, std::vector<std::string>& images);
+
+
+/*
+	Reads the image size from the JPEG or PNG header without decoding. Returns
+	false for other formats or broken headers.
+*/
+bool readImageSize(const std::string& path, cv::Size& size);
+
+
+/*
+	Largest IMREAD_REDUCED factor (1, 2, 4 or 8) that keeps the shorter side of
+	an image of size at or above modelRes.
+*/
+int reducedDecodeFactor(cv::Size size, int modelRes);
+
+
+/*
+	Runs detection on every image, decoding on a pool of threads while the
+	calling thread runs inference. Results are written to detections keyed by
+	image path, in the order images finish decoding.
+
+	Returns the number of processed images, -1 on failure.
+*/
+int runImageBatch(const std::vector<std::string>& images, Detector& detector,
+                  DetectionSink& detections, const ImageBatchOptions& options);
+
+#endif
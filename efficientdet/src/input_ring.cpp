@@ -0,0 +1,52 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include "input_ring.hpp"
+
+InputRing::InputRing(const std::string& name, cv::Size size, int batch, int depth)
+  : batchSize(batch), imageBytes(static_cast<size_t>(size.width) * size.height * 3)
+{
+  std::vector<void*> images;
+
+  for(int i = 0; i < depth; i++){
+    void* block = nullptr;
+    if(posix_memalign(&block, FRAME_POOL_ALIGNMENT, blockBytes()) != 0){
+      fprintf(stderr, "Failed to allocate %zu bytes for input ring '%s'\n", blockBytes(), name.c_str());
+      exit(1);
+    }
+    blocks.push_back(block);
+
+    // Images follow each other without padding, like in the tensor
+    for(int k = 0; k < batch; k++){
+      images.push_back(static_cast<uint8_t*>(block) + k * imageBytes);
+    }
+  }
+
+  imagePool.reset(new FramePool(name, size, CV_8UC3, images, nullptr));
+  current = depth - 1;
+}
+
+InputRing::~InputRing()
+{
+  // Buffers still in use are reported by the pool
+  imagePool.reset();
+
+  for(void* block : blocks){
+    free(block);
+  }
+}
+
+void* InputRing::next()
+{
+  current = (current + 1) % static_cast<int>(blocks.size());
+  return blocks[current];
+}
+
+FrameBuffer InputRing::image(int k)
+{
+  return imagePool->wrap(current * batchSize + k);
+}
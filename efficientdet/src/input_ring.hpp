@@ -0,0 +1,62 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef INPUT_RING
+#define INPUT_RING
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "frame_pool.hpp"
+
+// Input blocks per model: one bound for the current batch, one being prepared
+// for the next
+const int INPUT_RING_DEPTH = 2;
+
+
+/*
+	Rotating set of model input blocks for zero-copy inference. A block holds
+	the images of one batch back to back, laid out like the input tensor, and
+	the tensor is pointed at it with bindInputBuffer() before Invoke().
+	Preprocessing writes every image straight into its place in the block,
+	handed out as a buffer of pool(), so nothing is copied between
+	preprocessing and inference.
+
+	Blocks are used in turn, so the block bound for one batch is not touched
+	while the next batch is prepared.
+
+	name:  Pool name used in reports
+	size:  Model input size
+	batch: Images per block
+	depth: Number of blocks
+*/
+class InputRing {
+public:
+  InputRing(const std::string& name, cv::Size size, int batch, int depth);
+  ~InputRing();
+
+  InputRing(const InputRing&) = delete;
+  InputRing& operator=(const InputRing&) = delete;
+
+  // Moves on to the next block and returns it
+  void* next();
+
+  // Image k of the current block
+  FrameBuffer image(int k);
+
+  void*  block() const { return blocks[current]; }
+  size_t blockBytes() const { return imageBytes * batchSize; }
+
+  const FramePool& pool() const { return *imagePool; }
+
+private:
+  std::vector<void*>         blocks;
+  std::unique_ptr<FramePool> imagePool;
+  int                        batchSize;
+  size_t                     imageBytes;
+  int                        current = 0;
+};
+
+#endif
@@ -0,0 +1,84 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <iostream>
+#include "thread_placement.hpp"
+#include "latest_frame_source.hpp"
+
+LatestFrameSource::LatestFrameSource(std::unique_ptr<FrameSource> wrapped)
+  : source(std::move(wrapped))
+{
+  sourceInfo = source->info();
+
+  if(source->isOpened()){
+    reader = std::thread(&LatestFrameSource::readLoop, this);
+  }
+}
+
+LatestFrameSource::~LatestFrameSource()
+{
+  // The demo may give up before the end of the stream, while the reader
+  // still waits for input
+  if(reader.joinable()){
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      stopping = true;
+    }
+    source->interrupt();
+    reader.join();
+  }
+}
+
+void LatestFrameSource::readLoop()
+{
+  placeThread(THREAD_CAPTURE);
+
+  while(true){
+    Frame frame;
+    bool ok = source->read(frame);
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    if(!ok || stopping){
+      finished = true;
+      ready.notify_one();
+      return;
+    }
+
+    // Replacing the waiting frame returns it to its pool
+    if(hasFrame){
+      framesDropped++;
+    }
+    latest   = std::move(frame);
+    hasFrame = true;
+    framesRead++;
+
+    ready.notify_one();
+  }
+}
+
+bool LatestFrameSource::read(Frame& frame)
+{
+  frame.full.release();
+  frame.model.release();
+
+  std::unique_lock<std::mutex> guard(lock);
+  ready.wait(guard, [this]{ return hasFrame || finished; });
+
+  if(!hasFrame){
+    return false;
+  }
+
+  frame    = std::move(latest);
+  hasFrame = false;
+  return true;
+}
+
+void LatestFrameSource::printStats() const
+{
+  std::lock_guard<std::mutex> guard(lock);
+  std::cout << "Real-time input: " << framesRead << " frames read, " << framesDropped
+            << " dropped" << std::endl;
+}
@@ -0,0 +1,58 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef LATEST_FRAME_SOURCE
+#define LATEST_FRAME_SOURCE
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "video_source.hpp"
+
+/*
+	Real-time wrapper around another source. A reader thread pulls frames as
+	fast as the wrapped source delivers them and keeps only the newest one;
+	read() returns that frame and every frame the detection loop was too slow
+	for is dropped. A slow detection loop therefore never backs up the
+	producer (ie. the process writing into a pipe).
+
+	The wrapped source needs a depth of two more frames than the caller holds:
+	one waiting for read() and one being filled by the reader thread.
+
+	Destroying the source before the end of the stream interrupts the wrapped
+	source, so a reader waiting for input that never comes does not block it.
+*/
+class LatestFrameSource : public FrameSource {
+public:
+  explicit LatestFrameSource(std::unique_ptr<FrameSource> wrapped);
+  ~LatestFrameSource() override;
+
+  bool isOpened() const override { return source->isOpened(); }
+  bool read(Frame& frame) override;
+  std::string describe() const override { return source->describe() + ", real-time (newest frame only)"; }
+  std::vector<const FramePool*> pools() const override { return source->pools(); }
+
+  // Prints the number of frames read from the wrapped source and dropped
+  void printStats() const;
+
+private:
+  void readLoop();
+
+  std::unique_ptr<FrameSource> source;
+  std::thread                  reader;
+
+  mutable std::mutex      lock;
+  std::condition_variable ready;
+  Frame                   latest;
+  bool                    hasFrame      = false;
+  bool                    finished      = false;
+  bool                    stopping      = false;
+  uint64_t                framesRead    = 0;
+  uint64_t                framesDropped = 0;
+};
+
+#endif
@@ -0,0 +1,155 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "memory_usage.hpp"
+
+namespace {
+
+// Lowest and highest address of the tensors in one arena
+struct Extent {
+  uintptr_t low  = UINTPTR_MAX;
+  uintptr_t high = 0;
+
+  void add(const TfLiteTensor* tensor)
+  {
+    uintptr_t start = reinterpret_cast<uintptr_t>(tensor->data.raw);
+    low  = std::min(low, start);
+    high = std::max(high, start + tensor->bytes);
+  }
+
+  size_t bytes() const { return high > low ? high - low : 0; }
+};
+
+std::string mebibytes(size_t bytes)
+{
+  std::stringstream text;
+  text.precision(3);
+  text << bytes / (1024.0 * 1024.0) << " MiB";
+  return text.str();
+}
+
+}
+
+InterpreterMemory interpreterMemory(const Detector& detector)
+{
+  InterpreterMemory memory;
+  Extent arena;
+  Extent persistent;
+
+  for(size_t i = 0; i < detector.interpreter->tensors_size(); i++){
+    const TfLiteTensor* tensor = detector.interpreter->tensor(static_cast<int>(i));
+    if(!tensor->data.raw || tensor->bytes == 0){
+      continue;
+    }
+
+    // Read-only tensors live in the model mapping, custom allocations belong
+    // to whoever bound them
+    switch(tensor->allocation_type){
+      case kTfLiteArenaRw:           arena.add(tensor);                      break;
+      case kTfLiteArenaRwPersistent: persistent.add(tensor);                 break;
+      case kTfLiteDynamic:           memory.dynamicBytes += tensor->bytes;   break;
+      default:                                                               break;
+    }
+  }
+
+  memory.arenaBytes      = arena.bytes();
+  memory.persistentBytes = persistent.bytes();
+  memory.delegateBytes   = detector.delegateBytes;
+
+  if(detector.model && detector.model->allocation()){
+    memory.modelBytes = detector.model->allocation()->bytes();
+  }
+
+  return memory;
+}
+
+size_t residentBytes()
+{
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if(!statm){
+    return 0;
+  }
+
+  unsigned long size     = 0;
+  unsigned long resident = 0;
+  int fields = fscanf(statm, "%lu %lu", &size, &resident);
+  fclose(statm);
+
+  return fields == 2 ? resident * static_cast<size_t>(sysconf(_SC_PAGESIZE)) : 0;
+}
+
+size_t peakResidentBytes()
+{
+  struct rusage usage;
+  if(getrusage(RUSAGE_SELF, &usage) != 0){
+    return 0;
+  }
+
+  // Kilobytes on Linux
+  return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
+
+void MemoryReport::addInterpreter(const Detector& detector)
+{
+  InterpreterMemory memory = interpreterMemory(detector);
+  std::string name = detector.modelFile.substr(detector.modelFile.find_last_of('/') + 1);
+
+  std::stringstream detail;
+  detail << "arena " << mebibytes(memory.arenaBytes) << ", persistent " << mebibytes(memory.persistentBytes)
+         << ", dynamic " << mebibytes(memory.dynamicBytes) << ", delegate " << mebibytes(memory.delegateBytes);
+  entries.push_back({"interpreter " + name, memory.ownBytes(), detail.str()});
+
+  const void* model = detector.model.get();
+  if(std::find(models.begin(), models.end(), model) == models.end()){
+    models.push_back(model);
+    entries.push_back({"model " + name, memory.modelBytes, "mapped"});
+  }
+}
+
+void MemoryReport::addPools(const std::vector<const FramePool*>& pools)
+{
+  for(const FramePool* pool : pools){
+    std::stringstream detail;
+    detail << pool->capacity() << " x " << pool->size().width << "x" << pool->size().height;
+    entries.push_back({"frames " + pool->name(), pool->totalBytes(), detail.str()});
+  }
+}
+
+void MemoryReport::add(const std::string& name, size_t bytes)
+{
+  entries.push_back({name, bytes, ""});
+}
+
+size_t MemoryReport::totalBytes() const
+{
+  size_t total = 0;
+  for(const Entry& entry : entries){
+    total += entry.bytes;
+  }
+  return total;
+}
+
+void MemoryReport::print() const
+{
+  std::cout << "Memory:" << std::endl;
+
+  for(const Entry& entry : entries){
+    std::cout << "  " << entry.name << ": " << mebibytes(entry.bytes);
+    if(!entry.detail.empty()){
+      std::cout << " (" << entry.detail << ")";
+    }
+    std::cout << std::endl;
+  }
+
+  std::cout << "  accounted " << mebibytes(totalBytes()) << ", process resident " << mebibytes(residentBytes())
+            << ", peak resident " << mebibytes(peakResidentBytes()) << std::endl;
+}
@@ -0,0 +1,75 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef MEMORY_USAGE
+#define MEMORY_USAGE
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "detector.hpp"
+#include "frame_pool.hpp"
+
+/*
+	Memory held by one interpreter, read from its tensors.
+
+	arenaBytes:      Extent of the tensor arena. Activations share it, so this
+	                 is less than the sum of their sizes.
+	persistentBytes: Extent of the persistent arena (kernel state)
+	dynamicBytes:    Tensors allocated on their own, ie. dynamic shapes
+	modelBytes:      Size of the model mapping (weights), shared by every
+	                 interpreter of the same FlatBufferModel
+	delegateBytes:   Growth of the resident set while the delegate was
+	                 applied, see Detector::delegateBytes
+*/
+struct InterpreterMemory {
+  size_t arenaBytes      = 0;
+  size_t persistentBytes = 0;
+  size_t dynamicBytes    = 0;
+  size_t modelBytes      = 0;
+  size_t delegateBytes   = 0;
+
+  // Everything but the model mapping
+  size_t ownBytes() const { return arenaBytes + persistentBytes + dynamicBytes + delegateBytes; }
+};
+
+InterpreterMemory interpreterMemory(const Detector& detector);
+
+
+/*
+	Resident set size of the process now and at its peak, 0 if unknown.
+*/
+size_t residentBytes();
+size_t peakResidentBytes();
+
+
+/*
+	Memory accounted to one pipeline: its interpreters, model mappings and
+	frame buffer pools. A model shared by several interpreters is counted
+	once.
+*/
+class MemoryReport {
+public:
+  void addInterpreter(const Detector& detector);
+  void addPools(const std::vector<const FramePool*>& pools);
+  void add(const std::string& name, size_t bytes);
+
+  size_t totalBytes() const;
+
+  // Prints every entry, the total and the resident set of the process
+  void print() const;
+
+private:
+  struct Entry {
+    std::string name;
+    size_t      bytes;
+    std::string detail;
+  };
+
+  std::vector<Entry>       entries;
+  std::vector<const void*> models;
+};
+
+#endif
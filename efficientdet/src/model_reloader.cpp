@@ -0,0 +1,393 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "model_reloader.hpp"
+
+namespace {
+
+// Writers often close or rename several times in a row, wait until the file
+// stays quiet this long before loading it
+const int SETTLE_MS = 300;
+
+// Warm-up runs before the interpreter is handed over; the first invokes pay
+// for lazy allocations and packing of the weights
+const int WARMUP_RUNS = 2;
+
+// A control socket client has this long to send its command
+const int CLIENT_TIMEOUT_MS = 1000;
+
+// eventfd written from the SIGHUP handler
+int hangupFd = -1;
+
+void onHangup(int)
+{
+  uint64_t one = 1;
+  ssize_t written = write(hangupFd, &one, sizeof(one));
+  (void)written;
+}
+
+void drain(int fd)
+{
+  uint64_t value;
+  ssize_t n = read(fd, &value, sizeof(value));
+  (void)n;
+}
+
+std::string directoryOf(const std::string& path)
+{
+  size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+}
+
+std::string fileNameOf(const std::string& path)
+{
+  return path.substr(path.find_last_of('/') + 1);
+}
+
+}
+
+ModelReloader::ModelReloader(const std::string& modelFile, const DetectorOptions& options, int batch,
+                             const ReloadOptions& reload)
+  : currentFile(modelFile), detectorOptions(options), batchSize(batch), reloadOptions(reload)
+{
+  // The running interpreter may use the shared context at the same time
+  detectorOptions.cpuBackend.reset();
+}
+
+ModelReloader::~ModelReloader()
+{
+  if(worker.joinable()){
+    wake(stopFd);
+    worker.join();
+  }
+
+  if(reloadOptions.signal && hangupFd >= 0){
+    signal(SIGHUP, SIG_DFL);
+    close(hangupFd);
+    hangupFd = -1;
+  }
+
+  if(socketFd >= 0){
+    close(socketFd);
+    unlink(reloadOptions.controlSocket.c_str());
+  }
+
+  for(int fd : {stopFd, retireFd, inotifyFd}){
+    if(fd >= 0){
+      close(fd);
+    }
+  }
+}
+
+bool ModelReloader::start()
+{
+  stopFd   = eventfd(0, EFD_CLOEXEC);
+  retireFd = eventfd(0, EFD_CLOEXEC);
+  if(stopFd < 0 || retireFd < 0){
+    std::cout << "Failed to create reloader events: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  if(reloadOptions.watchFile){
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(inotifyFd < 0 || !watch(currentFile)){
+      std::cout << "Failed to watch " << currentFile << ": " << strerror(errno) << std::endl;
+      return false;
+    }
+  }
+
+  if(reloadOptions.signal){
+    if(hangupFd >= 0){
+      std::cout << "Only one model reloader can handle SIGHUP" << std::endl;
+      return false;
+    }
+
+    hangupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onHangup;
+    action.sa_flags   = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if(hangupFd < 0 || sigaction(SIGHUP, &action, nullptr) != 0){
+      std::cout << "Failed to install the SIGHUP handler: " << strerror(errno) << std::endl;
+      return false;
+    }
+  }
+
+  if(!reloadOptions.controlSocket.empty()){
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(reloadOptions.controlSocket.size() >= sizeof(address.sun_path)){
+      std::cout << "Control socket path too long: " << reloadOptions.controlSocket << std::endl;
+      return false;
+    }
+    strcpy(address.sun_path, reloadOptions.controlSocket.c_str());
+
+    // A socket left behind by an earlier run would make bind() fail
+    unlink(address.sun_path);
+
+    socketFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(socketFd < 0 ||
+       bind(socketFd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 ||
+       listen(socketFd, 4) != 0){
+      std::cout << "Failed to open control socket " << reloadOptions.controlSocket << ": "
+                << strerror(errno) << std::endl;
+      return false;
+    }
+  }
+
+  worker = std::thread(&ModelReloader::run, this);
+  return true;
+}
+
+bool ModelReloader::watch(const std::string& path)
+{
+  if(watchId >= 0){
+    inotify_rm_watch(inotifyFd, watchId);
+  }
+
+  // Watching the directory also sees a new file renamed over the model
+  watchId     = inotify_add_watch(inotifyFd, directoryOf(path).c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+  watchedName = fileNameOf(path);
+  return watchId >= 0;
+}
+
+void ModelReloader::wake(int fd)
+{
+  uint64_t one = 1;
+  ssize_t written = write(fd, &one, sizeof(one));
+  (void)written;
+}
+
+void ModelReloader::run()
+{
+  enum { STOP, RETIRE, HANGUP, WATCH, SOCKET };
+
+  struct pollfd fds[5];
+  fds[STOP]   = {stopFd, POLLIN, 0};
+  fds[RETIRE] = {retireFd, POLLIN, 0};
+  fds[HANGUP] = {reloadOptions.signal ? hangupFd : -1, POLLIN, 0};
+  fds[WATCH]  = {inotifyFd, POLLIN, 0};
+  fds[SOCKET] = {socketFd, POLLIN, 0};
+
+  while(true){
+    if(poll(fds, 5, -1) < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      std::cout << "Model reloader stopped: " << strerror(errno) << std::endl;
+      return;
+    }
+
+    if(fds[STOP].revents){
+      return;
+    }
+
+    if(fds[RETIRE].revents){
+      drain(retireFd);
+
+      std::vector<std::unique_ptr<ReloadedModel>> destroy;
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        destroy.swap(retired);
+      }
+    }
+
+    if(fds[HANGUP].revents){
+      drain(hangupFd);
+
+      std::string message;
+      load(currentFile, message);
+      std::cout << "SIGHUP: " << message << std::endl;
+    }
+
+    if(fds[WATCH].revents){
+      handleWatch();
+    }
+
+    if(fds[SOCKET].revents){
+      handleClient();
+    }
+  }
+}
+
+void ModelReloader::handleWatch()
+{
+  bool changed = false;
+
+  // Keep reading until the directory has been quiet for SETTLE_MS
+  struct pollfd fd = {inotifyFd, POLLIN, 0};
+  do{
+    alignas(struct inotify_event) char buffer[4096];
+    ssize_t length;
+    while((length = read(inotifyFd, buffer, sizeof(buffer))) > 0){
+      for(char* ptr = buffer; ptr < buffer + length; ){
+        struct inotify_event* event = reinterpret_cast<struct inotify_event*>(ptr);
+        if(event->len > 0 && watchedName == event->name){
+          changed = true;
+        }
+        ptr += sizeof(struct inotify_event) + event->len;
+      }
+    }
+  } while(changed && poll(&fd, 1, SETTLE_MS) > 0);
+
+  if(changed){
+    std::string message;
+    load(currentFile, message);
+    std::cout << "Model file changed: " << message << std::endl;
+  }
+}
+
+void ModelReloader::handleClient()
+{
+  int client = accept4(socketFd, nullptr, nullptr, SOCK_CLOEXEC);
+  if(client < 0){
+    return;
+  }
+
+  struct timeval timeout;
+  timeout.tv_sec  = CLIENT_TIMEOUT_MS / 1000;
+  timeout.tv_usec = (CLIENT_TIMEOUT_MS % 1000) * 1000;
+  setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  std::string line;
+  char c;
+  while(line.size() < 4096 && read(client, &c, 1) == 1 && c != '\n'){
+    line += c;
+  }
+  if(!line.empty() && line.back() == '\r'){
+    line.pop_back();
+  }
+
+  std::string message;
+  if(line == "reload"){
+    load(currentFile, message);
+  }
+  else if(line.compare(0, 7, "reload ") == 0){
+    load(line.substr(7), message);
+  }
+  else{
+    message = "unknown command '" + line + "', expected 'reload [model path]'";
+  }
+
+  std::cout << "Control socket: " << message << std::endl;
+
+  message += "\n";
+  ssize_t written = write(client, message.data(), message.size());
+  (void)written;
+  close(client);
+}
+
+bool ModelReloader::load(const std::string& path, std::string& message)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  std::unique_ptr<ReloadedModel> model(new ReloadedModel);
+  model->detector.reset(new Detector);
+  Detector& detector = *model->detector;
+
+  bool ok = loadDetector(path, detectorOptions, detector);
+  if(ok && batchSize > 1){
+    ok = resizeBatch(detector, batchSize);
+  }
+
+  // Binding the input re-plans the tensors, so it goes before the warm-up and
+  // the loop only has to point the tensor at the next block
+  if(ok){
+    cv::Size modelSize(detector.resolution, detector.resolution);
+    model->scaledPool.reset(new FramePool("scaled", modelSize, CV_8UC3, detector.batch));
+
+    if(reloadOptions.zeroCopyInput){
+      model->inputRing.reset(new InputRing("input", modelSize, detector.batch, INPUT_RING_DEPTH));
+      if(!bindInputBuffer(detector, model->inputRing->block(), model->inputRing->blockBytes())){
+        std::cout << "Input tensor of " << path << " can not be bound, copying input" << std::endl;
+        model->inputRing.reset();
+      }
+    }
+    if(!model->inputRing){
+      model->modelPool.reset(new FramePool("model", modelSize, CV_8UC3, detector.batch));
+    }
+
+    std::string name = fileNameOf(path);
+    model->name = name.substr(0, name.rfind(".tflite"));
+  }
+
+  ok = ok && warmUpDetector(detector, WARMUP_RUNS);
+
+  if(!ok){
+    failures++;
+    message = "failed to load " + path + ", keeping the running model";
+    return false;
+  }
+
+  int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start).count();
+  lastLoadMs = ms;
+  loads++;
+
+  // A model that was never picked up is replaced by the newer one and
+  // destroyed here, outside of the lock
+  std::unique_ptr<ReloadedModel> unused;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    unused = std::move(pending);
+    pending = std::move(model);
+  }
+
+  if(path != currentFile){
+    currentFile = path;
+    if(inotifyFd >= 0 && !watch(currentFile)){
+      std::cout << "Failed to watch " << currentFile << ": " << strerror(errno) << std::endl;
+    }
+  }
+
+  message = "loaded " + path + " in " + std::to_string(ms) + " ms, swapping at the next frame";
+  return true;
+}
+
+std::unique_ptr<ReloadedModel> ModelReloader::take()
+{
+  // The loader only holds the lock to move a pointer, but the loop must not
+  // wait for it either way
+  std::unique_lock<std::mutex> guard(lock, std::try_to_lock);
+  if(!guard.owns_lock() || !pending){
+    return nullptr;
+  }
+
+  swaps++;
+  return std::move(pending);
+}
+
+void ModelReloader::retire(std::unique_ptr<ReloadedModel> model)
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    retired.push_back(std::move(model));
+  }
+  wake(retireFd);
+}
+
+void ModelReloader::printStats() const
+{
+  std::cout << "Model reloads: " << loads << " loaded, " << failures << " failed, " << swaps << " swapped";
+  if(loads > 0){
+    std::cout << ", last load " << lastLoadMs << " ms";
+  }
+  std::cout << std::endl;
+}
@@ -0,0 +1,127 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef MODEL_RELOADER
+#define MODEL_RELOADER
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "detector.hpp"
+#include "frame_pool.hpp"
+#include "input_ring.hpp"
+
+/*
+	What triggers a reload.
+
+	watchFile:     Reload when the model file is rewritten or replaced (inotify
+	               on its directory, so atomic renames are seen as well)
+	signal:        Reload on SIGHUP
+	controlSocket: Path of a Unix socket accepting "reload" or
+	               "reload <model path>" lines, empty for none
+	zeroCopyInput: Bind the input tensor of new models to an input ring, as
+	               PipelineOptions::zeroCopyInput does for the running one
+*/
+struct ReloadOptions {
+  bool        watchFile     = true;
+  bool        signal        = true;
+  std::string controlSocket;
+  bool        zeroCopyInput = true;
+};
+
+
+/*
+	A replacement model with the buffers the detection loop needs for it, all
+	allocated on the loader thread so the loop only swaps them in.
+
+	name:       Model file name without directory and extension
+	scaledPool: Frames resized to the model input
+	modelPool:  Model input images, nullptr if the input tensor is bound to
+	            inputRing
+	inputRing:  Input blocks the input tensor is bound to, nullptr if the
+	            input is copied into the tensor
+*/
+struct ReloadedModel {
+  std::unique_ptr<Detector>  detector;
+  std::string                name;
+  std::unique_ptr<FramePool> scaledPool;
+  std::unique_ptr<FramePool> modelPool;
+  std::unique_ptr<InputRing> inputRing;
+};
+
+
+/*
+	Replaces the model of a running pipeline without stopping it. A background
+	thread waits for a trigger, loads the new FlatBufferModel, builds an
+	interpreter for it, allocates and binds its input buffers, warms it up and
+	hands it over as a ReloadedModel. The detection loop picks it up with
+	take() between two batches and returns the replaced model with retire(),
+	so the old interpreter and buffers are also destroyed off the loop.
+
+	Loading never holds a lock the detection loop waits on; a model that fails
+	to load or to warm up is reported and the running one is kept.
+
+	modelFile: Model the pipeline starts with
+	options:   Interpreter options of the new interpreters. A shared CPU
+	           backend context is not used, the warm-up runs while the loop
+	           invokes the running interpreter.
+	batch:     Batch size the new interpreters are resized to
+*/
+class ModelReloader {
+public:
+  ModelReloader(const std::string& modelFile, const DetectorOptions& options, int batch,
+                const ReloadOptions& reloadOptions);
+  ~ModelReloader();
+
+  // Sets up the triggers and starts the loader thread. Returns false on
+  // failure.
+  bool start();
+
+  // Model loaded since the last call, nullptr if none. Never blocks.
+  std::unique_ptr<ReloadedModel> take();
+
+  // Hands a replaced model back for destruction on the loader thread
+  void retire(std::unique_ptr<ReloadedModel> model);
+
+  // Prints the number of loads, failures and swaps and the last load time
+  void printStats() const;
+
+private:
+  void run();
+  void handleWatch();
+  void handleClient();
+  bool load(const std::string& path, std::string& message);
+  bool watch(const std::string& path);
+  void wake(int fd);
+
+  std::string     currentFile;
+  DetectorOptions detectorOptions;
+  int             batchSize;
+  ReloadOptions   reloadOptions;
+
+  int stopFd    = -1;   // eventfd, ends the loader thread
+  int retireFd  = -1;   // eventfd, retired detectors to destroy
+  int inotifyFd = -1;
+  int watchId   = -1;
+  int socketFd  = -1;
+  std::string watchedName;
+
+  std::thread worker;
+
+  std::mutex                                  lock;
+  std::unique_ptr<ReloadedModel>              pending;
+  std::vector<std::unique_ptr<ReloadedModel>> retired;
+
+  std::atomic<uint64_t> loads{0};
+  std::atomic<uint64_t> failures{0};
+  std::atomic<uint64_t> swaps{0};
+  std::atomic<int64_t>  lastLoadMs{0};
+};
+
+#endif
@@ -0,0 +1,331 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "pipe_source.hpp"
+
+namespace {
+
+// Larger pipe buffer, so the producer is not woken up for every 64 kB
+const int PIPE_BUFFER_BYTES = 1 << 20;
+
+// Longest stream or frame header accepted
+const size_t MAX_HEADER_BYTES = 4096;
+
+// Value of a W or H header token, -1 if it is not a positive number
+int headerNumber(const std::string& token)
+{
+  const char* digits = token.c_str() + 1;
+  char*       end    = nullptr;
+
+  errno = 0;
+  long value = strtol(digits, &end, 10);
+  if(end == digits || *end != '\0' || errno != 0 || value <= 0 || value > 1 << 16){
+    return -1;
+  }
+  return static_cast<int>(value);
+}
+
+}
+
+bool isPipeInput(const std::string& input)
+{
+  if(input == "-" || input.rfind("pipe:", 0) == 0){
+    return true;
+  }
+
+  struct stat st;
+  return stat(input.c_str(), &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+PipeSource::PipeSource(const std::string& path, const std::string& format, cv::Size frameSize,
+                       double fps, int depth)
+  : inputPath(path.rfind("pipe:", 0) == 0 ? path.substr(5) : path), inputFormat(format)
+{
+  if(inputPath == "-"){
+    fd = STDIN_FILENO;
+  }
+  else{
+    fd = open(inputPath.c_str(), O_RDONLY);
+    ownsFd = true;
+  }
+
+  if(fd < 0){
+    return;
+  }
+
+  stopFd = eventfd(0, EFD_CLOEXEC);
+  if(stopFd < 0){
+    std::cout << "Failed to create the pipe stop event: " << strerror(errno) << std::endl;
+    return;
+  }
+
+  fcntl(fd, F_SETPIPE_SZ, PIPE_BUFFER_BYTES);
+
+  sourceInfo.fps        = fps;
+  sourceInfo.frameCount = 0;
+  sourceInfo.frameSize  = frameSize;
+  sourceInfo.fourcc     = 0;
+
+  if(inputFormat == "y4m"){
+    if(!readHeader()){
+      return;
+    }
+    frameSize = sourceInfo.frameSize;
+
+    // Planes are read as one block: Y followed by U and V
+    cv::Size planesSize(frameSize.width, chroma444 ? frameSize.height * 3 : frameSize.height * 3 / 2);
+    rawPool.reset(new FramePool("y4m", planesSize, CV_8UC1, 1));
+    if(chroma444){
+      yuvPool.reset(new FramePool("yuv444", frameSize, CV_8UC3, 1));
+    }
+  }
+  else if(inputFormat == "rgb24"){
+    rawPool.reset(new FramePool("rgb24", frameSize, CV_8UC3, 1));
+  }
+  else if(inputFormat != "bgr24"){
+    std::cout << "Unknown input format '" << inputFormat << "'. Use one of y4m, rgb24, bgr24" << std::endl;
+    return;
+  }
+
+  if(frameSize.width <= 0 || frameSize.height <= 0){
+    std::cout << "Raw input needs a frame size (--input-size WxH)" << std::endl;
+    return;
+  }
+
+  capturePool.reset(new FramePool("capture", frameSize, CV_8UC3, depth));
+}
+
+PipeSource::~PipeSource()
+{
+  if(ownsFd && fd >= 0){
+    close(fd);
+  }
+  if(stopFd >= 0){
+    close(stopFd);
+  }
+}
+
+void PipeSource::interrupt()
+{
+  uint64_t one = 1;
+  ssize_t written = write(stopFd, &one, sizeof(one));
+  (void)written;
+}
+
+// Waits for input or interrupt(), returns -1 once interrupted
+ssize_t PipeSource::readSome(void* data, size_t bytes)
+{
+  struct pollfd fds[2] = {{fd, POLLIN, 0}, {stopFd, POLLIN, 0}};
+
+  while(true){
+    if(poll(fds, 2, -1) < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      return -1;
+    }
+    if(fds[1].revents){
+      return -1;
+    }
+
+    ssize_t n = ::read(fd, data, bytes);
+    if(n < 0 && errno == EINTR){
+      continue;
+    }
+    return n;
+  }
+}
+
+bool PipeSource::readExact(void* data, size_t bytes)
+{
+  uint8_t* out = reinterpret_cast<uint8_t*>(data);
+
+  // Payload read along with the last header comes first
+  size_t buffered = std::min(bytes, lookaheadEnd - lookaheadStart);
+  memcpy(out, lookahead + lookaheadStart, buffered);
+  lookaheadStart += buffered;
+  out            += buffered;
+  bytes          -= buffered;
+
+  while(bytes > 0){
+    ssize_t n = readSome(out, bytes);
+    if(n <= 0){
+      return false;
+    }
+    out   += n;
+    bytes -= n;
+  }
+
+  return true;
+}
+
+// Reads up to the next newline in chunks. line keeps its capacity, so frame
+// headers do not allocate.
+bool PipeSource::readLine(std::string& line)
+{
+  line.clear();
+
+  while(line.size() < MAX_HEADER_BYTES){
+    if(lookaheadStart == lookaheadEnd){
+      ssize_t n = readSome(lookahead, sizeof(lookahead));
+      if(n <= 0){
+        return false;
+      }
+      lookaheadStart = 0;
+      lookaheadEnd   = n;
+    }
+
+    const char* begin   = lookahead + lookaheadStart;
+    const char* newline = static_cast<const char*>(memchr(begin, '\n', lookaheadEnd - lookaheadStart));
+    const char* end     = newline ? newline : lookahead + lookaheadEnd;
+
+    line.append(begin, end);
+    lookaheadStart = (end - lookahead) + (newline ? 1 : 0);
+    if(newline){
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// "YUV4MPEG2 W1920 H1080 F30000:1001 Ip A1:1 C420jpeg"
+bool PipeSource::readHeader()
+{
+  std::string line;
+  if(!readLine(line)){
+    std::cout << "Input ended before the YUV4MPEG2 header" << std::endl;
+    return false;
+  }
+
+  std::istringstream tokens(line);
+  std::string token;
+  tokens >> token;
+  if(token != "YUV4MPEG2"){
+    std::cout << "Input is not a YUV4MPEG2 stream" << std::endl;
+    return false;
+  }
+
+  int width  = 0;
+  int height = 0;
+  std::string colorspace = "420jpeg";
+
+  while(tokens >> token){
+    switch(token[0]){
+      case 'W': width  = headerNumber(token); break;
+      case 'H': height = headerNumber(token); break;
+      case 'C': colorspace = token.substr(1); break;
+      case 'F': {
+        int num = 0;
+        int den = 1;
+        if(sscanf(token.c_str(), "F%d:%d", &num, &den) == 2 && den > 0){
+          sourceInfo.fps = static_cast<double>(num) / den;
+        }
+        break;
+      }
+      default: break;
+    }
+  }
+
+  if(colorspace == "444"){
+    chroma444 = true;
+  }
+  else if(colorspace.compare(0, 3, "420") != 0){
+    std::cout << "Unsupported Y4M colorspace C" << colorspace << ", use 420 or 444" << std::endl;
+    return false;
+  }
+
+  if(width <= 0 || height <= 0 || (!chroma444 && (width % 2 || height % 2))){
+    std::cout << "Unsupported Y4M frame size " << width << "x" << height << std::endl;
+    return false;
+  }
+
+  sourceInfo.frameSize = cv::Size(width, height);
+  return true;
+}
+
+// "FRAME" plus optional parameters up to the newline
+bool PipeSource::readFrameHeader()
+{
+  return readLine(headerLine) && headerLine.compare(0, 5, "FRAME") == 0;
+}
+
+bool PipeSource::read(Frame& frame)
+{
+  frame.model.release();
+  frame.full = capturePool->acquire();
+
+  cv::Size frameSize = sourceInfo.frameSize;
+
+  if(inputFormat == "bgr24"){
+    // Already the pipeline's format, read into the frame itself
+    if(!readExact(frame.full.mat.data, frameSize.area() * 3)){
+      frame.full.release();
+      return false;
+    }
+    return true;
+  }
+
+  if(inputFormat == "y4m" && !readFrameHeader()){
+    frame.full.release();
+    return false;
+  }
+
+  FrameBuffer raw = rawPool->acquire();
+  if(!readExact(raw.mat.data, raw.mat.total() * raw.mat.elemSize())){
+    frame.full.release();
+    return false;
+  }
+
+  if(inputFormat == "rgb24"){
+    cv::cvtColor(raw.mat, frame.full.mat, cv::COLOR_RGB2BGR);
+  }
+  else if(!chroma444){
+    cv::cvtColor(raw.mat, frame.full.mat, cv::COLOR_YUV2BGR_I420);
+  }
+  else{
+    int h = frameSize.height;
+    cv::Mat planes[3] = {raw.mat(cv::Rect(0, 0, frameSize.width, h)),
+                         raw.mat(cv::Rect(0, h, frameSize.width, h)),
+                         raw.mat(cv::Rect(0, 2 * h, frameSize.width, h))};
+
+    // Interleave the planes, then convert
+    FrameBuffer yuv = yuvPool->acquire();
+    std::vector<cv::Mat> channels(planes, planes + 3);
+    cv::merge(channels, yuv.mat);
+    cv::cvtColor(yuv.mat, frame.full.mat, cv::COLOR_YUV2BGR);
+  }
+
+  return true;
+}
+
+std::string PipeSource::describe() const
+{
+  return (inputPath == "-" ? std::string("stdin") : "pipe " + inputPath) + " (" + inputFormat +
+         (chroma444 ? " 4:4:4" : "") + ")";
+}
+
+std::vector<const FramePool*> PipeSource::pools() const
+{
+  std::vector<const FramePool*> result;
+  for(const FramePool* pool : {rawPool.get(), yuvPool.get(), capturePool.get()}){
+    if(pool){
+      result.push_back(pool);
+    }
+  }
+  return result;
+}
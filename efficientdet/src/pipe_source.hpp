@@ -0,0 +1,74 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef PIPE_SOURCE
+#define PIPE_SOURCE
+
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include "video_source.hpp"
+
+/*
+	Reads uncompressed frames from stdin or a named pipe, so the demo can sit
+	behind ffmpeg or gst-launch in a shell pipeline.
+
+	path:      "-" for stdin, otherwise a FIFO or file
+	format:    y4m   - YUV4MPEG2 stream, 4:2:0 or 4:4:4, size and rate from its header
+	           rgb24 - packed RGB frames of frameSize
+	           bgr24 - packed BGR frames of frameSize
+	frameSize: Frame size of raw formats
+	fps:       Frame rate of raw formats
+	depth:     Number of frames the caller may hold at the same time
+
+	Frame payloads are read with as few, large read() calls as possible,
+	straight into aligned pool buffers. Y4M headers are read in chunks, the
+	payload bytes read along with them are taken from that chunk first.
+*/
+class PipeSource : public FrameSource {
+public:
+  PipeSource(const std::string& path, const std::string& format, cv::Size frameSize, double fps, int depth);
+  ~PipeSource() override;
+
+  bool isOpened() const override { return fd >= 0 && capturePool != nullptr; }
+  bool read(Frame& frame) override;
+  std::string describe() const override;
+  std::vector<const FramePool*> pools() const override;
+  void interrupt() override;
+
+private:
+  bool readHeader();
+  bool readFrameHeader();
+  bool readLine(std::string& line);
+  bool readExact(void* data, size_t bytes);
+  ssize_t readSome(void* data, size_t bytes);
+
+  std::string                inputPath;
+  std::string                inputFormat;
+  int                        fd = -1;
+  int                        stopFd = -1;   // eventfd, set by interrupt()
+  bool                       ownsFd = false;
+  bool                       chroma444 = false;
+
+  // Bytes read past the end of a header line, consumed before the fd
+  char        lookahead[4096];
+  size_t      lookaheadStart = 0;
+  size_t      lookaheadEnd   = 0;
+  std::string headerLine;
+
+  // Raw read buffers, converted into capturePool unless the input already
+  // is BGR, in which case frames are read into capturePool directly
+  std::unique_ptr<FramePool> rawPool;
+  std::unique_ptr<FramePool> yuvPool;
+  std::unique_ptr<FramePool> capturePool;
+};
+
+
+/*
+	True for "-", "pipe:<path>" and paths of named pipes.
+*/
+bool isPipeInput(const std::string& input);
+
+#endif
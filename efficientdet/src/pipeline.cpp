@@ -0,0 +1,458 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "opencv2/opencv.hpp"
+#include "efficientdet_utils.hpp"
+#include "frame_pool.hpp"
+#include "input_ring.hpp"
+#include "model_reloader.hpp"
+#include "quality_controller.hpp"
+#include "stage_stats.hpp"
+#include "video_writer.hpp"
+#include "pipeline.hpp"
+
+namespace {
+
+// Model file name without directory and extension, shown in the frame
+std::string variantName(const Detector& detector)
+{
+  std::string name = detector.modelFile.substr(detector.modelFile.find_last_of('/') + 1);
+  return name.substr(0, name.rfind(".tflite"));
+}
+
+}
+
+size_t loopBufferBytes(cv::Size frameSize, const std::vector<Detector*>& variants, const PipelineOptions& options)
+{
+  // Mirrors the pools set up in runDetectionLoop()
+  size_t bytes = static_cast<size_t>(frameSize.width) * frameSize.height * 3 * (options.writerQueue + 2);
+
+  for(const Detector* variant : variants){
+    size_t imageBytes = static_cast<size_t>(variant->resolution) * variant->resolution * 3;
+    int    inputs     = options.zeroCopyInput ? variant->batch * INPUT_RING_DEPTH : variant->batch;
+    bytes += imageBytes * (variant->batch + inputs);
+  }
+
+  return bytes;
+}
+
+int runDetectionLoop(FrameSource& source, Detector& detector, VideoSink& sink,
+                     DetectionSink* detections, const PipelineOptions& options)
+{
+  return runDetectionLoop(source, {&detector}, nullptr, sink, detections, options);
+}
+
+int runDetectionLoop(FrameSource& source, const std::vector<Detector*>& variants, QualityController* quality,
+                     VideoSink& sink, DetectionSink* detections, const PipelineOptions& options)
+{
+  int CHANNELS  = 3;
+  int MAX_BATCH = 1;
+  for(const Detector* variant : variants){
+    MAX_BATCH = std::max(MAX_BATCH, variant->batch);
+  }
+
+  // FPS text, formatted in place so drawing it does not allocate
+  char fpsText[32];
+
+  std::vector<std::vector<float>>              outputs;
+  std::vector<std::vector<std::vector<float>>> imageOutputs;
+  std::vector<Detection>                       frameDetections;
+  std::vector<Detection>                       replacedDetections;
+
+  int imgCnt = 0;
+  int modelSwaps = 0;
+  uint64_t allocsAfterFirstFrame = 0;
+
+  double framecount = source.info().frameCount;
+
+  // Every stage writes into its own preallocated buffers, so no stage changes
+  // the shape of another stage's frame and the loop stops allocating after
+  // the first frame. Each model variant has its own input resolution and
+  // therefore its own preprocessing buffers.
+  cv::Size frameSize = source.info().frameSize;
+
+  // Frames of a batch are kept until they are rendered. The model input is
+  // written into blocks of an input ring that the input tensor is bound to,
+  // or copied into the tensor if the interpreter does not accept that.
+  std::vector<std::unique_ptr<FramePool>> scaledPools(variants.size());
+  std::vector<std::unique_ptr<FramePool>> modelPools(variants.size());
+  std::vector<std::unique_ptr<InputRing>> inputRings(variants.size());
+  std::vector<std::string>                variantLabels(variants.size());
+
+  for(size_t i = 0; i < variants.size(); i++){
+    Detector* variant = variants[i];
+    cv::Size modelSize(variant->resolution, variant->resolution);
+    std::string suffix = variants.size() > 1 ? " " + std::to_string(variant->resolution) : "";
+    scaledPools[i].reset(new FramePool("scaled" + suffix, modelSize, CV_8UC3, variant->batch));
+
+    std::unique_ptr<InputRing> ring;
+    if(options.zeroCopyInput){
+      ring.reset(new InputRing("input" + suffix, modelSize, variant->batch, INPUT_RING_DEPTH));
+      if(!bindInputBuffer(*variant, ring->block(), ring->blockBytes())){
+        std::cout << "Input tensor of " << variant->modelFile << " can not be bound, copying input" << std::endl;
+        ring.reset();
+      }
+    }
+
+    modelPools[i].reset(ring ? nullptr : new FramePool("model" + suffix, modelSize, CV_8UC3, variant->batch));
+    inputRings[i] = std::move(ring);
+    variantLabels[i] = "Model: " + variantName(*variant);
+  }
+
+  // Output buffers are held by the encoder queue, plus one being encoded and
+  // one being drawn into
+  FramePool outputPool ("output",  frameSize, CV_8UC3, options.writerQueue + 2);
+
+  std::vector<Frame>       batchFrames(MAX_BATCH);
+  std::vector<FrameBuffer> batchScaled(MAX_BATCH);
+  std::vector<FrameBuffer> batchModel(MAX_BATCH);
+
+  // Encoding runs on its own thread from here on
+  AsyncVideoWriter writer(sink, options.writerQueue, options.writerDrop);
+  StageStats decodeStats("decode");
+  StageStats preprocessStats("preprocess");
+  StageStats inferenceStats(MAX_BATCH > 1 ? "inference (batch of " + std::to_string(MAX_BATCH) + ")" : "inference");
+  StageStats renderStats("render");
+
+  bool endOfStream = false;
+
+  auto jobStart = options.startTime == std::chrono::steady_clock::time_point() ?
+                  std::chrono::steady_clock::now() : options.startTime;
+  double firstDetectionMs = 0;
+
+  // Evaluate on provided video file
+  while(!endOfStream){
+
+    // A reloaded model replaces the first variant between batches, when none
+    // of the previous batch's buffers are in use any more. Its buffers were
+    // allocated and bound by the reloader, which also destroys the replaced
+    // interpreter and buffers.
+    if(options.reloader){
+      std::unique_ptr<ReloadedModel> reloaded = options.reloader->take();
+      if(reloaded){
+        std::swap(*variants[0], *reloaded->detector);
+        scaledPools[0].swap(reloaded->scaledPool);
+        modelPools[0].swap(reloaded->modelPool);
+        inputRings[0].swap(reloaded->inputRing);
+        variantLabels[0] = "Model: " + reloaded->name;
+        options.reloader->retire(std::move(reloaded));
+        modelSwaps++;
+
+        if(options.progress){
+          std::cout << "Swapped model to " << variants[0]->modelFile << " at frame " << imgCnt << std::endl;
+        }
+      }
+    }
+
+    // The quality controller only switches variants between batches
+    int       variant     = quality ? quality->current() : 0;
+    Detector& detector    = *variants[variant];
+    int       MODEL_RES   = detector.resolution;
+    bool      KERAS_MODEL = detector.keras;
+    int       BATCH       = detector.batch;
+    cv::Size  modelSize(MODEL_RES, MODEL_RES);
+    FramePool& scaledPool = *scaledPools[variant];
+    InputRing* inputRing  = inputRings[variant].get();
+
+    int8_t* input = reinterpret_cast<int8_t*>(detector.inTensor->data.raw);
+    size_t  inputFrameBytes = MODEL_RES * MODEL_RES * CHANNELS * sizeof(int8_t);
+
+    // Images of this batch go into the next block of the ring. A model frame
+    // from the source can back the input tensor itself.
+    void* boundInput = nullptr;
+    if(inputRing){
+      boundInput = inputRing->next();
+    }
+
+    auto batchStart = std::chrono::steady_clock::now();
+
+    // Capture and preprocess up to BATCH frames into the input tensor
+    int  count          = 0;
+    bool regionsHandled = false;
+    std::chrono::microseconds inferenceTimeDuration(0);
+
+    for(; count < BATCH; count++){
+      Frame& frame = batchFrames[count];
+
+      auto stageStart = std::chrono::steady_clock::now();
+
+      if(!source.read(frame)){
+        if(options.progress){
+          std::cout << "End of file, exitting ..." << std::endl;
+        }
+        endOfStream = true;
+        break;
+      }
+
+      decodeStats.addSince(stageStart);
+      stageStart = std::chrono::steady_clock::now();
+
+      // Region schedulers work on the full frame and may skip the model input
+      // altogether (batches of one only)
+      if(options.regions && !frame.full.empty() &&
+         options.regions->detect(frame.full.mat, replacedDetections)){
+        inferenceTimeDuration = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - stageStart);
+        regionsHandled = true;
+        count++;
+        break;
+      }
+
+      // Sources scaling in the decoder deliver the model input directly
+      bool         sourceScaled = !frame.model.empty();
+      FrameBuffer& scaledImg    = batchScaled[count];
+      FrameBuffer& RGBImg       = batchModel[count];
+
+      RGBImg = std::move(frame.model);
+
+      // Buffer the model input of this frame is written into
+      auto inputSlot = [&](){
+        return inputRing ? inputRing->image(count) : modelPools[variant]->acquire();
+      };
+
+      if(sourceScaled){
+        bool bindable = inputRing && BATCH == 1 && RGBImg.mat.size() == modelSize && RGBImg.mat.isContinuous() &&
+                        reinterpret_cast<uintptr_t>(RGBImg.mat.data) % FRAME_POOL_ALIGNMENT == 0;
+
+        if(bindable){
+          boundInput = RGBImg.mat.data;
+        }
+        else if(RGBImg.mat.size() != modelSize){
+          // The source scales for one variant only, the others need another resize
+          FrameBuffer resized = inputSlot();
+          cv::resize(RGBImg.mat, resized.mat, modelSize, 0, 0, cv::INTER_CUBIC);
+          RGBImg = std::move(resized);
+        }
+        else if(inputRing){
+          FrameBuffer packed = inputSlot();
+          RGBImg.mat.copyTo(packed.mat);
+          RGBImg = std::move(packed);
+        }
+      }
+
+      if(!sourceScaled){
+        // Resize input image to fit the model. Resizing before the channel swap
+        // gives the same result while converting far fewer pixels.
+        scaledImg = scaledPool.acquire();
+        cv::resize(frame.full.mat, scaledImg.mat, modelSize, 0, 0, cv::INTER_CUBIC);
+
+        // The cascade and region schedulers crop from the full frame
+        if(!options.cascade && !options.regions){
+          frame.full.release();
+        }
+
+        // OpenCV loads images in BGR format. image has to be converted to RGB.
+        RGBImg = inputSlot();
+        cv::cvtColor(scaledImg.mat, RGBImg.mat, cv::COLOR_BGR2RGB);
+      }
+
+      if(!inputRing){
+        memcpy((void*)(input + count * inputFrameBytes), (void*) RGBImg.mat.data, inputFrameBytes);
+      }
+
+      preprocessStats.addSince(stageStart);
+    }
+
+    if(count == 0){
+      break;
+    }
+
+    if(!regionsHandled){
+      // Point the input tensor at this batch, no copy left before Invoke()
+      if(boundInput){
+        TFLITE_MINIMAL_CHECK(bindInputBuffer(detector, boundInput, BATCH * inputFrameBytes));
+      }
+
+      // A partial last batch leaves stale images in the remaining slots, their
+      // outputs are ignored
+      inferenceTimeDuration = timedInference(detector.interpreter.get());
+      inferenceStats.add(inferenceTimeDuration);
+
+      // Keras-converted models have different output tensors
+      getOutputVectors(detector.outTensor, outputRows(detector) * BATCH, outputValues(detector), outputs);
+
+      if(BATCH > 1){
+        splitBatchOutputs(detector, outputs, count, imageOutputs);
+      }
+    }
+
+    // Everything before the first results is startup cost for short jobs
+    if(imgCnt == 0){
+      firstDetectionMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - jobStart).count();
+    }
+
+    double fps = count / (std::max<int64_t>(1, inferenceTimeDuration.count()) / 1000000.0);
+
+    for(int k = 0; k < count; k++){
+      const std::vector<std::vector<float>>& frameOutputs = (BATCH > 1) ? imageOutputs[k] : outputs;
+
+      Frame&       frame     = batchFrames[k];
+      FrameBuffer& scaledImg = batchScaled[k];
+      FrameBuffer& RGBImg    = batchModel[k];
+
+      FrameBuffer outMat;
+
+      // Frames handled by a region scheduler or flagged by the cascade take
+      // those detections instead of the model outputs
+      bool replaced = regionsHandled;
+      if(!replaced && options.cascade){
+        bool rgb = frame.full.empty();
+        replaced = options.cascade->process(detector, frameOutputs, k, rgb ? RGBImg.mat : frame.full.mat,
+                                            rgb, replacedDetections);
+      }
+
+      if(!replaced && (detections || options.regions)){
+        readDetections(detector, frameOutputs, options.scoreThreshold, frameDetections, k);
+      }
+
+      if(detections){
+        detections->write(options.sourceName, options.frameOffset + imgCnt,
+                          replaced ? replacedDetections : frameDetections);
+      }
+
+      if(options.regions && !regionsHandled && !frame.full.empty()){
+        options.regions->fullFrame(frame.full.mat, replaced ? replacedDetections : frameDetections);
+      }
+
+      auto stageStart = std::chrono::steady_clock::now();
+
+      if(!frame.full.empty()){
+        // Full-resolution frame from the decoder, draw straight into it
+        if(replaced){
+          drawDetections(replacedDetections, frame.full.mat);
+        }
+        else{
+          drawBoundingBoxesResized(frameOutputs, KERAS_MODEL, MODEL_RES, frame.full.mat);
+        }
+        // The scaled pool only holds one batch, the next one needs it back
+        scaledImg.release();
+        RGBImg.release();
+        outMat = std::move(frame.full);
+      }
+
+      else{
+        if(replaced){
+          drawDetections(replacedDetections, RGBImg.mat);
+        }
+
+        else if(KERAS_MODEL){
+          drawBoundingBoxesScaled(frameOutputs, RGBImg.mat, MODEL_RES);
+        }
+
+        else{
+          drawBoundingBoxes(frameOutputs, RGBImg.mat);
+        }
+
+        // Convert back to BGR since OpenCV works with BGR. The scaled buffer is
+        // free again at this point and has the right shape.
+        if(scaledImg.empty()){
+          scaledImg = scaledPool.acquire();
+        }
+        cv::cvtColor(RGBImg.mat, scaledImg.mat, cv::COLOR_RGB2BGR);
+        RGBImg.release();
+
+        outMat = outputPool.acquire();
+        cv::resize(scaledImg.mat, outMat.mat, frameSize, 0, 0, cv::INTER_CUBIC);
+        scaledImg.release();
+      }
+
+      snprintf(fpsText, sizeof(fpsText), "FPS: %.4g", fps);
+      cv::putText(outMat.mat, fpsText,
+                   cv::Point(15, 45), cv::FONT_HERSHEY_SIMPLEX, 1.0, CV_RGB(255, 0, 0), 2);
+
+      if(quality){
+        cv::putText(outMat.mat, variantLabels[variant],
+                     cv::Point(15, 85), cv::FONT_HERSHEY_SIMPLEX, 1.0, CV_RGB(255, 0, 0), 2);
+      }
+
+      renderStats.addSince(stageStart);
+
+      writer.write(std::move(outMat));
+
+      // The first frame warms up OpenCV and TfLite internals, every later
+      // frame is expected to run without cv::Mat allocations.
+      if(imgCnt == 0){
+        allocsAfterFirstFrame = MatAllocationCounter::allocations();
+      }
+
+      imgCnt++;
+
+      if(options.progress){
+        std::cout << "Frames processed: " << imgCnt - 1 << " / " << framecount << std::endl;
+      }
+    }
+
+    if(quality){
+      double frameMs = std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - batchStart).count() / count;
+      double inferenceMs = inferenceTimeDuration.count() / 1000.0 / count;
+      for(int k = 0; k < count; k++){
+        quality->addFrame(frameMs, inferenceMs);
+      }
+    }
+  }
+
+  // Encode the remaining queued frames
+  writer.flush();
+
+  if(options.report){
+    if(imgCnt > 0){
+      std::cout << "Time to first detection: " << firstDetectionMs << " ms" << std::endl;
+    }
+
+    std::cout << "Stage timings:" << std::endl;
+    decodeStats.print();
+    preprocessStats.print();
+    inferenceStats.print();
+    renderStats.print();
+    writer.printStats();
+
+    if(quality){
+      quality->printStats();
+    }
+
+    if(options.cascade){
+      options.cascade->printStats();
+    }
+
+    if(options.regions){
+      options.regions->printStats();
+    }
+
+    if(options.reloader){
+      options.reloader->printStats();
+    }
+
+    if(imgCnt > 0){
+      std::vector<const FramePool*> pools = source.pools();
+      for(size_t i = 0; i < variants.size(); i++){
+        pools.push_back(scaledPools[i].get());
+        pools.push_back(inputRings[i] ? &inputRings[i]->pool() : modelPools[i].get());
+      }
+      pools.push_back(&outputPool);
+      // Pools of a swapped model are allocated while the loop runs
+      if(modelSwaps > 0){
+        std::cout << "Allocations include the buffers of " << modelSwaps << " model swap(s)" << std::endl;
+      }
+      printFramePoolStats(pools,
+                          MatAllocationCounter::allocations() - allocsAfterFirstFrame, imgCnt - 1);
+
+      if(options.memory){
+        options.memory->addPools(pools);
+        options.memory->print();
+      }
+    }
+  }
+
+  return imgCnt;
+}
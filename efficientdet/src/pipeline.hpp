@@ -0,0 +1,92 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef PIPELINE
+#define PIPELINE
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include "cascade.hpp"
+#include "detection_sink.hpp"
+#include "detector.hpp"
+#include "memory_usage.hpp"
+#include "model_reloader.hpp"
+#include "quality_controller.hpp"
+#include "region_scheduler.hpp"
+#include "video_sink.hpp"
+#include "video_source.hpp"
+
+/*
+	Options of the per-frame detection loop.
+
+	writerQueue:    Number of finished frames queued for the encoder thread
+	writerDrop:     Drop frames instead of waiting when the encoder queue is full
+	scoreThreshold: Minimum score of detections passed to the detection sink
+	progress:       Print a progress line per frame
+	report:         Print stage timings and pool statistics at the end
+	sourceName:     Name of the input passed to the detection sink
+	frameOffset:    Index of the first frame of source within sourceName
+	cascade:        Confirm stage for frames the detector flags, nullptr to
+	                use the detector's own results only
+	zeroCopyInput:  Preprocess straight into buffers the input tensor is bound
+	                to instead of copying into the tensor
+	regions:        Region scheduler that may handle frames without a
+	                full-frame inference, nullptr to infer every frame.
+	                Needs a detector batch size of 1.
+	startTime:      Start of the job, the time to the first detection is
+	                measured from it. Defaults to the start of the loop.
+	reloader:       Source of replacement models for the first variant, taken
+	                between batches, nullptr to keep the models
+	memory:         Report the source's and the loop's frame buffers are added
+	                to and printed with the stage timings, nullptr for none
+*/
+struct PipelineOptions {
+  int              writerQueue    = 4;
+  bool             writerDrop     = false;
+  float            scoreThreshold = 0.3f;
+  bool             progress       = true;
+  bool             report         = true;
+  std::string      sourceName;
+  int              frameOffset    = 0;
+  bool             zeroCopyInput  = true;
+  Cascade*         cascade        = nullptr;
+  RegionScheduler* regions        = nullptr;
+  ModelReloader*   reloader       = nullptr;
+  MemoryReport*    memory         = nullptr;
+
+  std::chrono::steady_clock::time_point startTime;
+};
+
+
+/*
+	Run detection on every frame of source, draw the bounding boxes and pass the
+	frames to sink. Detections are also written to detections if not nullptr.
+
+	Returns the number of processed frames.
+*/
+int runDetectionLoop(FrameSource& source, Detector& detector, VideoSink& sink,
+                     DetectionSink* detections, const PipelineOptions& options);
+
+
+/*
+	Same as above, with several variants of the model (ie. lite0, lite1,
+	lite2) ordered from fastest to most accurate. quality picks the variant of
+	every batch from the measured frame times; preprocessing follows the
+	resolution of the active variant. With quality nullptr the first variant
+	is used.
+*/
+int runDetectionLoop(FrameSource& source, const std::vector<Detector*>& variants, QualityController* quality,
+                     VideoSink& sink, DetectionSink* detections, const PipelineOptions& options);
+
+
+/*
+	Bytes of the frame buffers runDetectionLoop() allocates for frames of
+	frameSize, variants and options, not counting the source's own buffers.
+	Lets a memory budget be checked before the loop starts.
+*/
+size_t loopBufferBytes(cv::Size frameSize, const std::vector<Detector*>& variants, const PipelineOptions& options);
+
+#endif
@@ -0,0 +1,94 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <iostream>
+#include "quality_controller.hpp"
+
+QualityController::QualityController(const std::vector<std::string>& names,
+                                     const std::vector<double>& inferenceMs, const QualityOptions& options)
+  : qualityOptions(options), variantNames(names), inferenceAvg(inferenceMs),
+    frames(names.size(), 0), frameTotalMs(names.size(), 0.0)
+{
+}
+
+double QualityController::predictedMs(int variant) const
+{
+  return overheadAvg + inferenceAvg[variant];
+}
+
+void QualityController::switchTo(int variant)
+{
+  std::cout << "Quality: " << variantNames[active] << " -> " << variantNames[variant]
+            << " (frame " << frameAvg << " ms, target " << qualityOptions.targetMs << " ms)" << std::endl;
+
+  active      = variant;
+  sinceSwitch = 0;
+  switches++;
+}
+
+bool QualityController::addFrame(double frameMs, double inferenceMs)
+{
+  frames[active]++;
+  frameTotalMs[active] += frameMs;
+
+  // Moving average over roughly one window, restarted on every switch so the
+  // previous variant's frames do not count
+  double alpha = 2.0 / (qualityOptions.window + 1);
+  if(sinceSwitch == 0){
+    frameAvg = frameMs;
+  }
+  else{
+    frameAvg += alpha * (frameMs - frameAvg);
+  }
+
+  double overheadMs = std::max(0.0, frameMs - inferenceMs);
+  if(sinceSwitch == 0 && switches == 0){
+    overheadAvg = overheadMs;
+  }
+  else{
+    overheadAvg += alpha * (overheadMs - overheadAvg);
+  }
+  inferenceAvg[active] += alpha * (inferenceMs - inferenceAvg[active]);
+
+  sinceSwitch++;
+  if(sinceSwitch < qualityOptions.window){
+    return false;
+  }
+
+  int last = static_cast<int>(variantNames.size()) - 1;
+
+  if(active > 0 && frameAvg > qualityOptions.targetMs * qualityOptions.downMargin){
+    // Skip variants that are predicted to miss the target as well
+    int next = active - 1;
+    while(next > 0 && predictedMs(next) > qualityOptions.targetMs){
+      next--;
+    }
+    switchTo(next);
+    return true;
+  }
+
+  if(active < last && sinceSwitch >= qualityOptions.upCooldown &&
+     predictedMs(active + 1) < qualityOptions.targetMs * qualityOptions.upMargin){
+    switchTo(active + 1);
+    return true;
+  }
+
+  return false;
+}
+
+void QualityController::printStats() const
+{
+  std::cout << "Quality variants (target " << qualityOptions.targetMs << " ms per frame, "
+            << switches << " switches):" << std::endl;
+
+  for(size_t i = 0; i < variantNames.size(); i++){
+    std::cout << "  " << variantNames[i] << ": " << frames[i] << " frames";
+    if(frames[i] > 0){
+      std::cout << ", mean " << frameTotalMs[i] / frames[i] << " ms";
+    }
+    std::cout << ", inference estimate " << inferenceAvg[i] << " ms" << std::endl;
+  }
+}
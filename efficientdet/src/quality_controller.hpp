@@ -0,0 +1,82 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef QUALITY_CONTROLLER
+#define QUALITY_CONTROLLER
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+	How the quality controller reacts to frame times.
+
+	targetMs:   Frame time to hold, ie. 1000 / target FPS
+	window:     Number of frames measured after a switch before the next
+	            decision
+	downMargin: Step down to a faster variant once the average frame time
+	            exceeds targetMs * downMargin
+	upMargin:   Step up to a more accurate variant only if its predicted frame
+	            time stays below targetMs * upMargin
+	upCooldown: Minimum number of frames on a variant before stepping up
+*/
+struct QualityOptions {
+  double targetMs   = 33.3;
+  int    window     = 15;
+  double downMargin = 1.05;
+  double upMargin   = 0.85;
+  int    upCooldown = 60;
+};
+
+
+/*
+	Picks one of several model variants, ordered from fastest to most accurate,
+	so that the frame time stays at a target. Decisions use a moving average of
+	the measured frame time; the gap between downMargin and upMargin and the
+	cooldown keep the controller from oscillating between two variants.
+
+	The frame time of a variant that is not active is predicted from the
+	current non-inference overhead plus the last inference time measured for
+	that variant.
+
+	names:       Variant names used in reports
+	inferenceMs: Initial inference time estimate of every variant
+	options:     Controller settings
+*/
+class QualityController {
+public:
+  QualityController(const std::vector<std::string>& names, const std::vector<double>& inferenceMs,
+                    const QualityOptions& options);
+
+  // Variant to use for the next frame
+  int current() const { return active; }
+
+  // Reports one frame of the current variant. Returns true if the variant
+  // changed.
+  bool addFrame(double frameMs, double inferenceMs);
+
+  // Prints frames and mean frame time per variant and the number of switches
+  void printStats() const;
+
+private:
+  double predictedMs(int variant) const;
+  void   switchTo(int variant);
+
+  QualityOptions           qualityOptions;
+  std::vector<std::string> variantNames;
+  std::vector<double>      inferenceAvg;
+  double                   frameAvg    = 0;
+  double                   overheadAvg = 0;
+  // Starts with the fastest variant and steps up while there is headroom,
+  // so the first frames do not miss the target
+  int                      active      = 0;
+  int                      sinceSwitch = 0;
+  uint64_t                 switches    = 0;
+
+  std::vector<uint64_t> frames;
+  std::vector<double>   frameTotalMs;
+};
+
+#endif
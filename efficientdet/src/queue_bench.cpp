@@ -0,0 +1,246 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+/*
+	Microbenchmark of the queues handing frames between pipeline threads:
+	BoundedQueue (mutex and condition variables), SpscRing and MpmcRing.
+
+	Throughput: producers push --items items through a queue of --capacity
+	slots to consumers as fast as possible.
+	Handoff latency: one item bounces between two threads over two queues
+	--rounds times; half of each round trip is one handoff.
+
+	./queue_bench --items 2000000 --cpus 2,3
+	./queue_bench --spins 0       (park right away, like a condition variable)
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bounded_queue.hpp"
+#include "ring_queue.hpp"
+#include "cxxopts.hpp"
+
+namespace {
+
+struct BenchOptions {
+  int64_t          items     = 1000000;
+  int              rounds    = 100000;
+  int              capacity  = 8;
+  int              spins     = RING_SPINS;
+  int              producers = 2;
+  int              consumers = 2;
+  std::vector<int> cpus;
+};
+
+// Thread index modulo the --cpus list, no pinning without a list
+void pinThread(const BenchOptions& options, int index)
+{
+  if(options.cpus.empty()){
+    return;
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(options.cpus[index % options.cpus.size()], &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+template <typename Queue>
+uint64_t queueParks(const Queue& queue) { return queue.parks(); }
+
+// Condition variable waits are not counted
+uint64_t queueParks(const BoundedQueue<int64_t>&) { return 0; }
+
+template <typename Queue>
+void throughput(const std::string& name, std::function<Queue*()> create, int producers, int consumers,
+                const BenchOptions& options)
+{
+  std::unique_ptr<Queue> queue(create());
+  int64_t perProducer = options.items / producers;
+
+  std::atomic<int64_t> received{0};
+  std::vector<std::thread> threads;
+
+  for(int i = 0; i < consumers; i++){
+    threads.emplace_back([&, i]{
+      pinThread(options, producers + i);
+      int64_t item;
+      int64_t count = 0;
+      while(queue->pop(item)){
+        count++;
+      }
+      received += count;
+    });
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> producerThreads;
+  for(int i = 0; i < producers; i++){
+    producerThreads.emplace_back([&, i]{
+      pinThread(options, i);
+      for(int64_t item = 0; item < perProducer; item++){
+        queue->push(item);
+      }
+    });
+  }
+
+  for(std::thread& thread : producerThreads){
+    thread.join();
+  }
+  queue->close();
+  for(std::thread& thread : threads){
+    thread.join();
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::cout << name << " " << producers << "x" << consumers << ": "
+            << received / seconds / 1e6 << " M items/s (" << seconds * 1e9 / std::max<int64_t>(received, 1)
+            << " ns/item), parks " << queueParks(*queue) << std::endl;
+}
+
+template <typename Queue>
+void latency(const std::string& name, std::function<Queue*()> create, const BenchOptions& options)
+{
+  std::unique_ptr<Queue> ping(create());
+  std::unique_ptr<Queue> pong(create());
+
+  std::thread echo([&]{
+    pinThread(options, 1);
+    int64_t item;
+    while(ping->pop(item)){
+      pong->push(item);
+    }
+  });
+
+  pinThread(options, 0);
+
+  std::vector<double> handoffs;
+  handoffs.reserve(options.rounds);
+
+  for(int i = 0; i < options.rounds; i++){
+    auto sent = std::chrono::steady_clock::now();
+    int64_t item = i;
+    ping->push(item);
+    pong->pop(item);
+    handoffs.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - sent).count() / 2);
+  }
+
+  ping->close();
+  echo.join();
+
+  // Restore the main thread for the next test
+  if(!options.cpus.empty()){
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(int cpu = 0; cpu < CPU_SETSIZE; cpu++){
+      CPU_SET(cpu, &set);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+
+  std::sort(handoffs.begin(), handoffs.end());
+  double sum = 0;
+  for(double handoff : handoffs){
+    sum += handoff;
+  }
+
+  std::cout << name << " handoff: mean " << sum / handoffs.size() << " ns, p50 "
+            << handoffs[handoffs.size() / 2] << " ns, p99 " << handoffs[handoffs.size() * 99 / 100]
+            << " ns, max " << handoffs.back() << " ns, parks " << queueParks(*ping) + queueParks(*pong) << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  BenchOptions options;
+
+  try{
+    cxxopts::Options appOptions("queue_bench", "Measures handoff latency and throughput of the frame queues.");
+
+    appOptions.add_options()
+    ("items", "Number of items per throughput test", cxxopts::value<int64_t>()->default_value("1000000"))
+    ("rounds", "Number of round trips per latency test", cxxopts::value<int>()->default_value("100000"))
+    ("capacity", "Queue capacity", cxxopts::value<int>()->default_value("8"))
+    ("spins", "Polls before a blocked ring operation parks, -1 never parks", cxxopts::value<int>()->default_value(std::to_string(RING_SPINS)))
+    ("producers", "Producer threads of the MPMC tests", cxxopts::value<int>()->default_value("2"))
+    ("consumers", "Consumer threads of the MPMC tests", cxxopts::value<int>()->default_value("2"))
+    ("cpus", "Comma-separated CPUs the test threads are pinned to, in turn", cxxopts::value<std::string>()->default_value(""))
+    ("h,help", "Display help message");
+
+    auto parsedOptions = appOptions.parse(argc, argv);
+
+    if(parsedOptions.count("help")){
+      std::cout << appOptions.help() << std::endl;
+      return 0;
+    }
+
+    options.items     = parsedOptions["items"].as<int64_t>();
+    options.rounds    = parsedOptions["rounds"].as<int>();
+    options.capacity  = parsedOptions["capacity"].as<int>();
+    options.spins     = parsedOptions["spins"].as<int>();
+    options.producers = parsedOptions["producers"].as<int>();
+    options.consumers = parsedOptions["consumers"].as<int>();
+
+    std::stringstream cpus(parsedOptions["cpus"].as<std::string>());
+    std::string       cpu;
+    while(std::getline(cpus, cpu, ',')){
+      if(!cpu.empty()){
+        options.cpus.push_back(std::stoi(cpu));
+      }
+    }
+  }
+
+  catch(const cxxopts::OptionException& e){
+    std::cout << "Error in parsing arguments: " << e.what() << std::endl;
+    return 1;
+  }
+
+  if(options.items < 1 || options.rounds < 1 || options.capacity < 1 || options.producers < 1 || options.consumers < 1){
+    std::cout << "--items, --rounds, --capacity, --producers and --consumers must be at least 1" << std::endl;
+    return 1;
+  }
+
+  size_t capacity = options.capacity;
+  int    spins    = options.spins;
+
+  std::function<BoundedQueue<int64_t>*()> bounded = [&]{ return new BoundedQueue<int64_t>(capacity); };
+  std::function<SpscRing<int64_t>*()>     spsc    = [&]{ return new SpscRing<int64_t>(capacity, spins); };
+  std::function<MpmcRing<int64_t>*()>     mpmc    = [&]{ return new MpmcRing<int64_t>(capacity, spins); };
+
+  std::cout << "Capacity " << capacity << ", " << spins << " spins";
+  if(!options.cpus.empty()){
+    std::cout << ", pinned to CPUs";
+    for(int cpu : options.cpus){
+      std::cout << " " << cpu;
+    }
+  }
+  std::cout << std::endl;
+
+  throughput<BoundedQueue<int64_t>>("bounded", bounded, 1, 1, options);
+  throughput<SpscRing<int64_t>>("spsc   ", spsc, 1, 1, options);
+  throughput<MpmcRing<int64_t>>("mpmc   ", mpmc, 1, 1, options);
+  throughput<BoundedQueue<int64_t>>("bounded", bounded, options.producers, options.consumers, options);
+  throughput<MpmcRing<int64_t>>("mpmc   ", mpmc, options.producers, options.consumers, options);
+
+  latency<BoundedQueue<int64_t>>("bounded", bounded, options);
+  latency<SpscRing<int64_t>>("spsc   ", spsc, options);
+  latency<MpmcRing<int64_t>>("mpmc   ", mpmc, options);
+
+  return 0;
+}
@@ -0,0 +1,38 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef REGION_SCHEDULER
+#define REGION_SCHEDULER
+
+#include <vector>
+#include "opencv2/opencv.hpp"
+#include "detector.hpp"
+
+/*
+	Replaces the full-frame inference of the detection loop by inference on
+	regions of the frame, ie. crops around tracked objects or changed tiles.
+	The detection loop asks detect() first and runs its own full-frame
+	inference only if the scheduler did not handle the frame.
+
+	Detections are normalized to the frame.
+*/
+class RegionScheduler {
+public:
+  virtual ~RegionScheduler() = default;
+
+  /*
+		Detect objects in frame (BGR) from regions only. Returns false if the
+		frame needs a full-frame inference instead.
+	*/
+  virtual bool detect(const cv::Mat& frame, std::vector<Detection>& detections) = 0;
+
+  // Result of a full-frame inference of frame
+  virtual void fullFrame(const cv::Mat& frame, const std::vector<Detection>& detections) = 0;
+
+  // Prints how frames were handled and region inference timings
+  virtual void printStats() const = 0;
+};
+
+#endif
@@ -0,0 +1,382 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef RING_QUEUE
+#define RING_QUEUE
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Indices written by different threads are kept this far apart, so the
+// producer and consumer do not invalidate each other's cache line
+constexpr size_t RING_CACHE_LINE = 64;
+
+// Polls of a blocked push() or pop() before the thread parks
+constexpr int RING_SPINS = 256;
+
+/*
+	Waiting strategy of the ring queues: poll the condition spins times, then
+	park on a condition variable. The other side only takes the mutex to wake
+	a parked thread, an uncontended handoff is a few atomic operations.
+
+	spins: Polls before parking, 0 parks right away, -1 never parks (polls
+	       and yields forever, for cores dedicated to one stage)
+*/
+class RingWaiter {
+public:
+  template <typename Ready>
+  void wait(Ready ready, int spins)
+  {
+    for(int i = 0; spins < 0 || i < spins; i++){
+      if(ready()){
+        return;
+      }
+      if(spins < 0 || i >= spins / 2){
+        std::this_thread::yield();
+      }
+      else{
+        cpuRelax();
+      }
+    }
+
+    // Announce the wait before the last check, wake() either sees the waiter
+    // or the check sees the other side's update
+    std::unique_lock<std::mutex> guard(lock);
+    waiters.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(!ready()){
+      parks++;
+      signal.wait(guard, ready);
+    }
+    waiters.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // Call after every update a waiting thread may be waiting for
+  void wake()
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(waiters.load(std::memory_order_relaxed) > 0){
+      {
+        std::lock_guard<std::mutex> guard(lock);
+      }
+      signal.notify_all();
+    }
+  }
+
+  uint64_t parked() const { return parks; }
+
+private:
+  static void cpuRelax()
+  {
+#if defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield");
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  }
+
+  std::atomic<int>        waiters{0};
+  std::atomic<uint64_t>   parks{0};
+  std::mutex              lock;
+  std::condition_variable signal;
+};
+
+
+/*
+	Lock-free FIFO for exactly one producer and one consumer thread, ie.
+	between two stages of a linear pipeline. Same interface as BoundedQueue:
+	once close() is called, push() fails and pop() drains the remaining items
+	before it starts failing as well. Storage is allocated once.
+
+	capacity: Maximum number of queued items
+	spins:    Polls of a blocked push() or pop() before it parks, see RingWaiter
+*/
+template <typename T>
+class SpscRing {
+public:
+  explicit SpscRing(size_t capacity, int spins = RING_SPINS)
+    : items(std::max<size_t>(capacity, 1)), spinCount(spins) {}
+
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  // Blocks while the queue is full. Returns false if the queue was closed.
+  bool push(T item)
+  {
+    while(!tryPush(item)){
+      if(closed.load(std::memory_order_acquire)){
+        return false;
+      }
+      notFull.wait([this]{
+        return closed.load(std::memory_order_acquire) ||
+               producer.tail - consumer.head.load(std::memory_order_acquire) < items.size();
+      }, spinCount);
+    }
+    return true;
+  }
+
+  // Returns false instead of blocking when the queue is full or closed
+  bool tryPush(T& item)
+  {
+    if(closed.load(std::memory_order_relaxed)){
+      return false;
+    }
+
+    size_t tail = producer.tail;
+    if(tail - producer.cachedHead == items.size()){
+      producer.cachedHead = consumer.head.load(std::memory_order_acquire);
+      if(tail - producer.cachedHead == items.size()){
+        return false;
+      }
+    }
+
+    items[tail % items.size()] = std::move(item);
+    producer.tail = tail + 1;
+    published.store(tail + 1, std::memory_order_release);
+    notEmpty.wake();
+    return true;
+  }
+
+  // Blocks while the queue is empty. Returns false once closed and drained.
+  bool pop(T& item)
+  {
+    while(!tryPop(item)){
+      if(closed.load(std::memory_order_acquire)){
+        // Items pushed before close() are visible now
+        return tryPop(item);
+      }
+      notEmpty.wait([this]{
+        return closed.load(std::memory_order_acquire) ||
+               published.load(std::memory_order_acquire) != consumer.head.load(std::memory_order_relaxed);
+      }, spinCount);
+    }
+    return true;
+  }
+
+  // Returns false instead of blocking when the queue is empty
+  bool tryPop(T& item)
+  {
+    size_t head = consumer.head.load(std::memory_order_relaxed);
+    if(head == consumer.cachedTail){
+      consumer.cachedTail = published.load(std::memory_order_acquire);
+      if(head == consumer.cachedTail){
+        return false;
+      }
+    }
+
+    T& slot = items[head % items.size()];
+    item = std::move(slot);
+    slot = T();
+    consumer.head.store(head + 1, std::memory_order_release);
+    notFull.wake();
+    return true;
+  }
+
+  void close()
+  {
+    closed.store(true, std::memory_order_seq_cst);
+    notFull.wake();
+    notEmpty.wake();
+  }
+
+  size_t size() const
+  {
+    return published.load(std::memory_order_acquire) - consumer.head.load(std::memory_order_acquire);
+  }
+
+  size_t capacity() const { return items.size(); }
+
+  // Number of times a blocked push() or pop() had to park
+  uint64_t parks() const { return notFull.parked() + notEmpty.parked(); }
+
+private:
+  // Producer-only state, the consumer's head is re-read only when the
+  // cached copy says the queue is full
+  struct alignas(RING_CACHE_LINE) Producer {
+    size_t tail       = 0;
+    size_t cachedHead = 0;
+  };
+
+  struct alignas(RING_CACHE_LINE) Consumer {
+    std::atomic<size_t> head{0};
+    size_t              cachedTail = 0;
+  };
+
+  std::vector<T> items;
+  int            spinCount;
+
+  Producer producer;
+  alignas(RING_CACHE_LINE) std::atomic<size_t> published{0};
+  Consumer consumer;
+  alignas(RING_CACHE_LINE) std::atomic<bool>   closed{false};
+
+  RingWaiter notFull;
+  RingWaiter notEmpty;
+};
+
+
+/*
+	Bounded lock-free FIFO for any number of producers and consumers, ie. to
+	hand work to a pool of threads. Every slot carries a sequence number that
+	tells producers and consumers whose turn it is (D. Vyukov's bounded MPMC
+	queue), so threads only contend on the head or tail index they move.
+	Same interface and close() semantics as SpscRing.
+
+	capacity: Maximum number of queued items, at least 2
+	spins:    Polls of a blocked push() or pop() before it parks, see RingWaiter
+*/
+template <typename T>
+class MpmcRing {
+public:
+  explicit MpmcRing(size_t capacity, int spins = RING_SPINS)
+    : slots(std::max<size_t>(capacity, 2)), spinCount(spins)
+  {
+    for(size_t i = 0; i < slots.size(); i++){
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpmcRing(const MpmcRing&) = delete;
+  MpmcRing& operator=(const MpmcRing&) = delete;
+
+  // Blocks while the queue is full. Returns false if the queue was closed.
+  bool push(T item)
+  {
+    while(!tryPush(item)){
+      if(closed.load(std::memory_order_acquire)){
+        return false;
+      }
+      notFull.wait([this]{
+        return closed.load(std::memory_order_acquire) || size() < slots.size();
+      }, spinCount);
+    }
+    return true;
+  }
+
+  // Returns false instead of blocking when the queue is full or closed
+  bool tryPush(T& item)
+  {
+    if(closed.load(std::memory_order_relaxed)){
+      return false;
+    }
+
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    Slot*  slot;
+    while(true){
+      slot = &slots[position % slots.size()];
+      size_t   sequence = slot->sequence.load(std::memory_order_acquire);
+      intptr_t lag      = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+      if(lag == 0){
+        if(enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)){
+          break;
+        }
+      }
+      else if(lag < 0){
+        // The slot still holds an item from the previous lap
+        return false;
+      }
+      else{
+        position = enqueuePosition.load(std::memory_order_relaxed);
+      }
+    }
+
+    slot->value = std::move(item);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    notEmpty.wake();
+    return true;
+  }
+
+  // Blocks while the queue is empty. Returns false once closed and drained.
+  bool pop(T& item)
+  {
+    while(!tryPop(item)){
+      if(closed.load(std::memory_order_acquire)){
+        // Items pushed before close() are visible now
+        return tryPop(item);
+      }
+      notEmpty.wait([this]{
+        return closed.load(std::memory_order_acquire) || size() > 0;
+      }, spinCount);
+    }
+    return true;
+  }
+
+  // Returns false instead of blocking when the queue is empty
+  bool tryPop(T& item)
+  {
+    size_t position = dequeuePosition.load(std::memory_order_relaxed);
+    Slot*  slot;
+    while(true){
+      slot = &slots[position % slots.size()];
+      size_t   sequence = slot->sequence.load(std::memory_order_acquire);
+      intptr_t lag      = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+
+      if(lag == 0){
+        if(dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)){
+          break;
+        }
+      }
+      else if(lag < 0){
+        // Not yet written
+        return false;
+      }
+      else{
+        position = dequeuePosition.load(std::memory_order_relaxed);
+      }
+    }
+
+    item = std::move(slot->value);
+    slot->value = T();
+    slot->sequence.store(position + slots.size(), std::memory_order_release);
+    notFull.wake();
+    return true;
+  }
+
+  void close()
+  {
+    closed.store(true, std::memory_order_seq_cst);
+    notFull.wake();
+    notEmpty.wake();
+  }
+
+  // Approximate while other threads push or pop
+  size_t size() const
+  {
+    size_t dequeued = dequeuePosition.load(std::memory_order_acquire);
+    size_t enqueued = enqueuePosition.load(std::memory_order_acquire);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+  }
+
+  size_t capacity() const { return slots.size(); }
+
+  // Number of times a blocked push() or pop() had to park
+  uint64_t parks() const { return notFull.parked() + notEmpty.parked(); }
+
+private:
+  struct alignas(RING_CACHE_LINE) Slot {
+    std::atomic<size_t> sequence{0};
+    T                   value;
+  };
+
+  std::vector<Slot> slots;
+  int               spinCount;
+
+  alignas(RING_CACHE_LINE) std::atomic<size_t> enqueuePosition{0};
+  alignas(RING_CACHE_LINE) std::atomic<size_t> dequeuePosition{0};
+  alignas(RING_CACHE_LINE) std::atomic<bool>   closed{false};
+
+  RingWaiter notFull;
+  RingWaiter notEmpty;
+};
+
+#endif
@@ -0,0 +1,355 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <spawn.h>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include "opencv2/opencv.hpp"
+#include "memory_usage.hpp"
+#include "video_source.hpp"
+#include "segment_runner.hpp"
+
+extern char** environ;
+
+namespace {
+
+struct Segment {
+  int    index;
+  int    start;
+  int    length;
+  std::string chunkPath;
+
+  std::unique_ptr<VideoSink> sink;
+  MemoryDetectionSink        detections;
+  int    frames = 0;
+  double seconds = 0;
+  bool   ok = false;
+};
+
+// out.avi -> out.seg03.avi
+std::string chunkName(const std::string& output, int index)
+{
+  char suffix[16];
+  snprintf(suffix, sizeof(suffix), ".seg%02d", index);
+
+  size_t dot = output.find_last_of('.');
+  if(dot == std::string::npos || output.find('/', dot) != std::string::npos){
+    return output + suffix;
+  }
+
+  return output.substr(0, dot) + suffix + output.substr(dot);
+}
+
+// Segment boundaries, aligned down to keyframes when the GOP length is known
+std::vector<int> splitFrames(int frameCount, int segments, int keyframeInterval)
+{
+  std::vector<int> bounds{0};
+
+  for(int i = 1; i < segments; i++){
+    int bound = static_cast<int>(static_cast<int64_t>(frameCount) * i / segments);
+    if(keyframeInterval > 0){
+      bound -= bound % keyframeInterval;
+    }
+    if(bound > bounds.back()){
+      bounds.push_back(bound);
+    }
+  }
+
+  bounds.push_back(frameCount);
+  return bounds;
+}
+
+// Sinks are opened on the calling thread before the segments start: the
+// ffmpeg sink passes its encoder options through the environment. A segment
+// without a sink fails without running.
+void openSegmentSink(Segment& segment, SinkOptions sinkOptions, const SourceInfo& info)
+{
+  if(segment.chunkPath.empty()){
+    sinkOptions.type = "null";
+  }
+  else{
+    sinkOptions.output = segment.chunkPath;
+  }
+
+  segment.sink = createVideoSink(sinkOptions, info.fps, info.frameSize);
+  if(!segment.sink || !segment.sink->isOpened()){
+    std::cout << "Segment " << segment.index << ": failed to open output file ..." << std::endl;
+    segment.sink.reset();
+  }
+}
+
+void processSegment(Segment& segment, const std::string& input, const std::string& modelFile,
+                    std::shared_ptr<tflite::FlatBufferModel> model,
+                    const DetectorOptions& detectorOptions, PipelineOptions pipelineOptions)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  if(!segment.sink){
+    return;
+  }
+
+  VideoFileSource source(input, 1, segment.start, segment.length);
+  if(!source.isOpened()){
+    std::cout << "Segment " << segment.index << ": failed to open input file ..." << std::endl;
+    return;
+  }
+
+  Detector detector;
+  if(!loadDetector(modelFile, detectorOptions, detector, model)){
+    return;
+  }
+
+  pipelineOptions.sourceName  = input;
+  pipelineOptions.frameOffset = segment.start;
+  pipelineOptions.progress    = false;
+  pipelineOptions.report      = false;
+
+  segment.frames = runDetectionLoop(source, detector, *segment.sink, &segment.detections, pipelineOptions);
+  segment.sink->release();
+
+  segment.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  segment.ok      = segment.frames == segment.length;
+
+  if(!segment.ok){
+    std::cout << "Segment " << segment.index << ": decoded " << segment.frames
+              << " of " << segment.length << " frames" << std::endl;
+  }
+}
+
+// Y4M chunks all start with the same stream header, the frames of the later
+// chunks are appended to the first one as they are
+bool concatenateY4m(const std::vector<std::unique_ptr<Segment>>& segments, const std::string& output)
+{
+  std::ofstream out(output, std::ios::binary);
+  if(!out){
+    std::cout << "Failed to open output file ..." << std::endl;
+    return false;
+  }
+
+  for(size_t i = 0; i < segments.size(); i++){
+    std::ifstream chunk(segments[i]->chunkPath, std::ios::binary);
+    std::string   header;
+    if(!chunk || !std::getline(chunk, header)){
+      std::cout << "Failed to open segment " << segments[i]->chunkPath << std::endl;
+      return false;
+    }
+
+    if(i == 0){
+      out << header << '\n';
+    }
+    if(chunk.peek() != std::ifstream::traits_type::eof()){
+      out << chunk.rdbuf();
+    }
+  }
+
+  out.close();
+  return !out.fail();
+}
+
+// Remux the chunks into the output with ffmpeg's concat demuxer, which copies
+// the encoded packets instead of decoding and encoding them again
+bool remuxChunks(const std::vector<std::unique_ptr<Segment>>& segments, const std::string& output)
+{
+  std::string listPath = output + ".segments.txt";
+  {
+    std::ofstream list(listPath);
+    for(const auto& segment : segments){
+      char path[PATH_MAX];
+      if(!realpath(segment->chunkPath.c_str(), path)){
+        std::cout << "Failed to open segment " << segment->chunkPath << std::endl;
+        return false;
+      }
+
+      // Quotes within the path are closed, escaped and reopened
+      std::string quoted;
+      for(const char* c = path; *c; c++){
+        quoted += (*c == '\'') ? std::string("'\\''") : std::string(1, *c);
+      }
+      list << "file '" << quoted << "'\n";
+    }
+    if(!list){
+      std::cout << "Failed to write segment list " << listPath << std::endl;
+      return false;
+    }
+  }
+
+  const char* argv[] = {"ffmpeg", "-loglevel", "error", "-y", "-f", "concat", "-safe", "0",
+                        "-i", listPath.c_str(), "-c", "copy", output.c_str(), nullptr};
+
+  pid_t pid;
+  int   status = -1;
+  int   error  = posix_spawnp(&pid, "ffmpeg", nullptr, nullptr, const_cast<char* const*>(argv), environ);
+  if(error == 0){
+    waitpid(pid, &status, 0);
+  }
+  std::remove(listPath.c_str());
+
+  if(error != 0){
+    std::cout << "Failed to run ffmpeg to stitch the chunks: " << strerror(error) << std::endl;
+    return false;
+  }
+  if(!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+    std::cout << "ffmpeg failed to stitch the chunks" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+}
+
+int runSegments(const std::string& input, const std::string& modelFile,
+                const DetectorOptions& detectorOptions, const SinkOptions& sinkOptions,
+                DetectionSink* detections, const PipelineOptions& pipelineOptions,
+                const SegmentOptions& segmentOptions)
+{
+  cv::VideoCapture probe(input);
+  if(!probe.isOpened()){
+    std::cout << "Failed to open input file ..." << std::endl;
+    return -1;
+  }
+
+  SourceInfo info = readSourceInfo(probe);
+  probe.release();
+
+  int frameCount = static_cast<int>(info.frameCount);
+  if(frameCount <= 0){
+    std::cout << "Segment mode needs a known frame count, the input does not report one" << std::endl;
+    return -1;
+  }
+
+  if(segmentOptions.video && (sinkOptions.output == "-" || sinkOptions.type == "gst-pipeline")){
+    std::cout << "Segment video needs a file output (-o) with the gst, ffmpeg, mjpeg or y4m sink" << std::endl;
+    return -1;
+  }
+
+  std::shared_ptr<tflite::FlatBufferModel> model = loadModel(modelFile);
+  if(!model){
+    return -1;
+  }
+
+  // Every segment holds its own interpreter and frame buffers, the model
+  // mapping is shared. A probe interpreter tells how much one segment needs.
+  int segmentLimit = segmentOptions.segments;
+  if(segmentOptions.memoryBudget > 0){
+    Detector probe;
+    if(!loadDetector(modelFile, detectorOptions, probe, model)){
+      return -1;
+    }
+
+    InterpreterMemory probeMemory = interpreterMemory(probe);
+    size_t sourceBytes  = static_cast<size_t>(info.frameSize.width) * info.frameSize.height * 3;
+    size_t segmentBytes = probeMemory.ownBytes() + sourceBytes + loopBufferBytes(info.frameSize, {&probe}, pipelineOptions);
+    size_t budget       = segmentOptions.memoryBudget;
+
+    segmentLimit = budget > probeMemory.modelBytes ?
+                   static_cast<int>(std::min<size_t>(segmentLimit, (budget - probeMemory.modelBytes) / segmentBytes)) : 0;
+    if(segmentLimit < 1){
+      std::cout << "Memory budget of " << budget / (1024 * 1024) << " MiB is too small for one segment, it needs "
+                << (probeMemory.modelBytes + segmentBytes) / (1024 * 1024) << " MiB" << std::endl;
+      return -1;
+    }
+
+    std::cout << "Memory budget: " << budget / (1024 * 1024) << " MiB, " << segmentBytes / (1024 * 1024)
+              << " MiB per segment, " << probeMemory.modelBytes / (1024 * 1024) << " MiB model, "
+              << segmentLimit << " segment(s)" << std::endl;
+  }
+
+  std::vector<int> bounds = splitFrames(frameCount, segmentLimit, segmentOptions.keyframeInterval);
+  int segmentCount = static_cast<int>(bounds.size()) - 1;
+
+  // Split the thread budget, so the segments do not oversubscribe the cores
+  DetectorOptions segmentDetectorOptions = detectorOptions;
+  segmentDetectorOptions.numThreads = std::max(1, detectorOptions.numThreads / segmentCount);
+
+  std::cout << "Processing " << frameCount << " frames in " << segmentCount << " segments, "
+            << segmentDetectorOptions.numThreads << " interpreter thread(s) each" << std::endl;
+
+  std::vector<std::unique_ptr<Segment>> segments;
+  for(int i = 0; i < segmentCount; i++){
+    std::unique_ptr<Segment> segment(new Segment());
+    segment->index  = i;
+    segment->start  = bounds[i];
+    segment->length = bounds[i + 1] - bounds[i];
+    if(segmentOptions.video){
+      segment->chunkPath = chunkName(sinkOptions.output, i);
+    }
+    openSegmentSink(*segment, sinkOptions, info);
+    segments.push_back(std::move(segment));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> workers;
+  for(auto& segment : segments){
+    workers.emplace_back(processSegment, std::ref(*segment), std::cref(input), std::cref(modelFile),
+                         model, std::cref(segmentDetectorOptions), pipelineOptions);
+  }
+
+  for(auto& worker : workers){
+    worker.join();
+  }
+
+  // Interpreters and buffers of the segments are gone, the peak shows what
+  // they took together
+  std::cout << "Peak resident memory: " << peakResidentBytes() / (1024 * 1024) << " MiB" << std::endl;
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  bool ok = true;
+  int  frames = 0;
+  for(const auto& segment : segments){
+    std::cout << "Segment " << segment->index << ": frames " << segment->start << " - "
+              << segment->start + segment->length - 1 << ", " << segment->frames << " processed in "
+              << segment->seconds << " s" << std::endl;
+    ok = ok && segment->ok;
+    frames += segment->frames;
+  }
+
+  std::cout << "Processed " << frames << " frames in " << seconds << " s ("
+            << frames / seconds << " FPS)" << std::endl;
+
+  // Stitch results back together in frame order
+  if(detections){
+    for(const auto& segment : segments){
+      segment->detections.replay(*detections);
+    }
+    detections->flush();
+  }
+
+  if(segmentOptions.video && ok){
+    auto stitchStart = std::chrono::steady_clock::now();
+    ok = sinkOptions.type == "y4m" ? concatenateY4m(segments, sinkOptions.output)
+                                   : remuxChunks(segments, sinkOptions.output);
+
+    if(!ok){
+      std::cout << "Chunks are kept as " << segments.front()->chunkPath << " to "
+                << segments.back()->chunkPath << std::endl;
+    }
+    else{
+      std::cout << "Stitched " << segmentCount << " chunks into " << sinkOptions.output << " in "
+                << std::chrono::duration<double>(std::chrono::steady_clock::now() - stitchStart).count()
+                << " s" << std::endl;
+    }
+
+    if(ok && !segmentOptions.keepChunks){
+      for(const auto& segment : segments){
+        std::remove(segment->chunkPath.c_str());
+      }
+    }
+  }
+
+  return ok ? 0 : -1;
+}
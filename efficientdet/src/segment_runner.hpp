@@ -0,0 +1,52 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef SEGMENT_RUNNER
+#define SEGMENT_RUNNER
+
+#include <string>
+#include "detection_sink.hpp"
+#include "detector.hpp"
+#include "pipeline.hpp"
+#include "video_sink.hpp"
+
+/*
+	Options of the parallel segment mode.
+
+	segments:         Number of segments processed in parallel
+	keyframeInterval: GOP length of the input. When set, segment boundaries are
+	                  aligned to multiples of it, so every segment starts on a
+	                  keyframe and no frames are decoded twice.
+	video:            Write a video chunk per segment and stitch the chunks into
+	                  the output in order
+	keepChunks:       Keep the per-segment chunks after stitching
+	memoryBudget:     Bytes the interpreters and frame buffers of all segments
+	                  may use, fewer segments are run if they do not fit. 0
+	                  for no limit.
+*/
+struct SegmentOptions {
+  int    segments         = 1;
+  int    keyframeInterval = 0;
+  bool   video            = false;
+  bool   keepChunks       = false;
+  size_t memoryBudget     = 0;
+};
+
+
+/*
+	Split the input video into time segments and process them in parallel, each
+	with its own capture, preprocessing and interpreter. All interpreters share
+	one FlatBufferModel and split detectorOptions.numThreads between them.
+	Detections are written to detections in frame order once all segments are
+	done.
+
+	Returns 0 on success.
+*/
+int runSegments(const std::string& input, const std::string& modelFile,
+                const DetectorOptions& detectorOptions, const SinkOptions& sinkOptions,
+                DetectionSink* detections, const PipelineOptions& pipelineOptions,
+                const SegmentOptions& segmentOptions);
+
+#endif
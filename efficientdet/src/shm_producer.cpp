@@ -0,0 +1,193 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+/*
+	Reference producer for the shared-memory input of efficientdet_demo.
+	Decodes a video straight into the slots of a frame ring and, optionally,
+	reads the detections the demo writes back and reports the round-trip
+	latency per frame.
+
+	./shm_producer -i cars_short.mp4 --ring /efficientdet_frames --results /efficientdet_results
+	./efficientdet_demo -m efficientdet-lite0.tflite -i shm:/efficientdet_frames \
+	                    --shm-results /efficientdet_results --sink null
+*/
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include "opencv2/opencv.hpp"
+#include "shm_ring.hpp"
+#include "cxxopts.hpp"
+
+namespace {
+
+void readResults(const std::string& name, std::atomic<bool>& producing, std::atomic<uint64_t>& published)
+{
+  std::unique_ptr<ShmRing> ring = ShmRing::open(name, 30000);
+  if(!ring){
+    return;
+  }
+
+  uint64_t received   = 0;
+  uint64_t detections = 0;
+  double   latencySum = 0;
+  double   latencyMax = 0;
+
+  while(true){
+    ShmSlotHeader slot;
+    const ShmDetections* record = reinterpret_cast<const ShmDetections*>(ring->read(slot, 1000));
+
+    if(!record){
+      // Done once the producer stopped and every published frame came back,
+      // or the demo closed the ring
+      if(ring->isClosed() || (!producing && received >= published)){
+        break;
+      }
+      continue;
+    }
+
+    double latencyMs = (shmTimestampNs() - slot.timestampNs) / 1e6;
+    latencySum += latencyMs;
+    latencyMax  = std::max(latencyMax, latencyMs);
+    detections += record->count;
+    received++;
+
+    ring->release();
+  }
+
+  std::cout << "Results: " << received << " frames, " << detections << " detections, latency mean "
+            << (received ? latencySum / received : 0.0) << " ms, max " << latencyMax << " ms" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  std::string input;
+  std::string ringName;
+  std::string resultsName;
+  int         slots;
+  int         modelRes;
+  double      fps;
+  bool        loop;
+
+  try{
+    cxxopts::Options appOptions("shm_producer", "Feeds video frames to efficientdet_demo through shared memory.");
+
+    appOptions.add_options()
+    ("i,input", "Input video file", cxxopts::value<std::string>()->default_value(""))
+    ("ring", "Name of the frame ring", cxxopts::value<std::string>()->default_value("/efficientdet_frames"))
+    ("results", "Name of the results ring to read, empty to ignore results", cxxopts::value<std::string>()->default_value(""))
+    ("slots", "Number of ring slots", cxxopts::value<int>()->default_value("4"))
+    ("model-res", "Publish RGB frames at this model resolution instead of full BGR frames", cxxopts::value<int>()->default_value("0"))
+    ("fps", "Publish at this rate, 0 publishes as fast as the consumer takes frames", cxxopts::value<double>()->default_value("0"))
+    ("loop", "Restart the video at its end")
+    ("h,help", "Display help message");
+
+    auto parsedOptions = appOptions.parse(argc, argv);
+
+    if(parsedOptions.count("help")){
+      std::cout << appOptions.help() << std::endl;
+      return 0;
+    }
+
+    input       = parsedOptions["input"].as<std::string>();
+    ringName    = parsedOptions["ring"].as<std::string>();
+    resultsName = parsedOptions["results"].as<std::string>();
+    slots       = parsedOptions["slots"].as<int>();
+    modelRes    = parsedOptions["model-res"].as<int>();
+    fps         = parsedOptions["fps"].as<double>();
+    loop        = parsedOptions.count("loop") > 0;
+  }
+
+  catch(const cxxopts::OptionException& e){
+    std::cout << "Error in parsing arguments: " << e.what() << std::endl;
+    return 1;
+  }
+
+  cv::VideoCapture cap(input);
+  if(!cap.isOpened()){
+    std::cout << "Failed to open input file ..." << std::endl;
+    return -1;
+  }
+
+  cv::Size frameSize(cap.get(cv::CAP_PROP_FRAME_WIDTH), cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+  cv::Size ringSize = modelRes > 0 ? cv::Size(modelRes, modelRes) : frameSize;
+
+  ShmRingConfig config;
+  config.format    = modelRes > 0 ? SHM_FORMAT_RGB24 : SHM_FORMAT_BGR24;
+  config.slotCount = slots;
+  config.slotBytes = static_cast<uint64_t>(ringSize.width) * ringSize.height * 3;
+  config.width     = ringSize.width;
+  config.height    = ringSize.height;
+  config.fps       = fps > 0 ? fps : cap.get(cv::CAP_PROP_FPS);
+
+  std::unique_ptr<ShmRing> ring = ShmRing::create(ringName, config);
+  if(!ring){
+    return -1;
+  }
+
+  std::cout << "Publishing " << ringSize.width << "x" << ringSize.height
+            << (modelRes > 0 ? " RGB" : " BGR") << " frames to " << ringName << std::endl;
+
+  std::atomic<bool>     producing(true);
+  std::atomic<uint64_t> published(0);
+  std::thread           results;
+  if(!resultsName.empty()){
+    results = std::thread(readResults, std::cref(resultsName), std::ref(producing), std::ref(published));
+  }
+
+  cv::Mat decoded;
+  cv::Mat scaled;
+  auto    period = std::chrono::duration<double>(fps > 0 ? 1.0 / fps : 0.0);
+  auto    next   = std::chrono::steady_clock::now();
+
+  while(true){
+    // Waits while the consumer holds every slot, fails once it went away
+    void* payload = ring->reserve(-1);
+    if(!payload){
+      break;
+    }
+
+    cv::Mat slot(ringSize, CV_8UC3, payload);
+
+    // Full frames are written into the slot without an intermediate buffer
+    bool ok = modelRes > 0 ? cap.read(decoded) : cap.read(slot);
+    if(!ok && loop){
+      cap.set(cv::CAP_PROP_POS_FRAMES, 0);
+      ok = modelRes > 0 ? cap.read(decoded) : cap.read(slot);
+    }
+    if(!ok){
+      break;
+    }
+
+    if(modelRes > 0){
+      cv::resize(decoded, scaled, ringSize, 0, 0, cv::INTER_CUBIC);
+      cv::cvtColor(scaled, slot, cv::COLOR_BGR2RGB);
+    }
+
+    if(fps > 0){
+      next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+      std::this_thread::sleep_until(next);
+    }
+
+    ring->publish(config.slotBytes, published, shmTimestampNs());
+    published++;
+  }
+
+  std::cout << "Published " << published << " frames" << std::endl;
+
+  // The consumer drains the remaining slots and ends at the closed ring
+  producing = false;
+  ring->close();
+
+  if(results.joinable()){
+    results.join();
+  }
+
+  // Removing the name on exit is safe, a consumer keeps its mapping
+  return 0;
+}
@@ -0,0 +1,322 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "shm_ring.hpp"
+
+namespace {
+
+const uint64_t SHM_PAGE_ALIGN      = 4096;
+const uint64_t SHM_SLOT_ALIGN      = 64;
+const int      SHM_SPIN_COUNT      = 200;
+// Sleeps are bounded, so a closed ring or a dead peer is noticed even if
+// the wake-up was missed
+const int      SHM_WAIT_SLICE_MS   = 100;
+const int      SHM_OPEN_POLL_MS    = 10;
+
+uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+uint32_t nextPowerOfTwo(uint32_t value)
+{
+  uint32_t result = 1;
+  while(result < value){
+    result <<= 1;
+  }
+  return result;
+}
+
+void futexWait(std::atomic<uint32_t>* word, uint32_t expected, int timeoutMs)
+{
+  struct timespec timeout;
+  timeout.tv_sec  = timeoutMs / 1000;
+  timeout.tv_nsec = (timeoutMs % 1000) * 1000000L;
+
+  // Not FUTEX_PRIVATE_FLAG, the word is shared between processes
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+}
+
+void futexWake(std::atomic<uint32_t>* word)
+{
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+/*
+	Waits until ready() holds. Spins briefly first, since the other side is
+	usually only microseconds away, then sleeps on word with waiting set so
+	the other side knows to wake us up.
+*/
+template <typename Ready>
+bool waitUntil(std::atomic<uint32_t>& word, std::atomic<uint32_t>& waiting, Ready ready, int timeoutMs)
+{
+  for(int i = 0; i < SHM_SPIN_COUNT; i++){
+    if(ready()){
+      return true;
+    }
+  }
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+  while(true){
+    uint32_t seen = word.load();
+    waiting.store(1);
+
+    if(ready()){
+      waiting.store(0);
+      return true;
+    }
+
+    int sliceMs = SHM_WAIT_SLICE_MS;
+    if(timeoutMs >= 0){
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now()).count();
+      if(left <= 0){
+        waiting.store(0);
+        return ready();
+      }
+      sliceMs = std::min<int>(sliceMs, left);
+    }
+
+    futexWait(&word, seen, sliceMs);
+    waiting.store(0);
+  }
+}
+
+}
+
+uint64_t shmTimestampNs()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+}
+
+std::unique_ptr<ShmRing> ShmRing::create(const std::string& name, const ShmRingConfig& config)
+{
+  if(config.slotCount == 0 || config.slotBytes == 0){
+    std::cout << "Shared memory ring " << name << " needs at least one non-empty slot" << std::endl;
+    return nullptr;
+  }
+
+  // A ring left behind by a crashed process would never be initialized again
+  shm_unlink(name.c_str());
+
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if(fd < 0){
+    std::cout << "Failed to create shared memory ring " << name << std::endl;
+    return nullptr;
+  }
+
+  // Power of two slot count, so slot indices stay continuous when the
+  // sequence counters wrap
+  uint32_t slotCount  = nextPowerOfTwo(config.slotCount);
+  uint64_t slotStride = alignUp(SHM_SLOT_ALIGN + config.slotBytes, SHM_SLOT_ALIGN);
+  uint64_t dataOffset = alignUp(sizeof(ShmRingHeader), SHM_PAGE_ALIGN);
+  size_t   size       = dataOffset + slotStride * slotCount;
+
+  std::unique_ptr<ShmRing> ring(new ShmRing());
+  ring->ringName    = name;
+  ring->owner       = true;
+  ring->mappingSize = size;
+
+  if(ftruncate(fd, size) != 0){
+    std::cout << "Failed to size shared memory ring " << name << std::endl;
+    ::close(fd);
+    return nullptr;
+  }
+
+  ring->mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+
+  if(ring->mapping == MAP_FAILED){
+    ring->mapping = nullptr;
+    std::cout << "Failed to map shared memory ring " << name << std::endl;
+    return nullptr;
+  }
+
+  ShmRingHeader* header = new (ring->mapping) ShmRingHeader();
+  header->version    = SHM_RING_VERSION;
+  header->format     = config.format;
+  header->slotCount  = slotCount;
+  header->slotBytes  = config.slotBytes;
+  header->slotStride = slotStride;
+  header->dataOffset = dataOffset;
+  header->width      = config.width;
+  header->height     = config.height;
+  header->fps        = config.fps;
+  header->writeSeq.store(0);
+  header->readerWaiting.store(0);
+  header->readSeq.store(0);
+  header->writerWaiting.store(0);
+  header->closed.store(0);
+
+  // Readers poll for the magic, it marks the header as complete
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = SHM_RING_MAGIC;
+
+  ring->ringHeader = header;
+  return ring;
+}
+
+std::unique_ptr<ShmRing> ShmRing::open(const std::string& name, int timeoutMs)
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+  while(true){
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if(fd >= 0){
+      struct stat st;
+      if(fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(ShmRingHeader)){
+        void* mapping = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+
+        if(mapping != MAP_FAILED){
+          ShmRingHeader* header = reinterpret_cast<ShmRingHeader*>(mapping);
+          uint32_t magic = header->magic;
+          std::atomic_thread_fence(std::memory_order_acquire);
+
+          if(magic == SHM_RING_MAGIC){
+            if(header->version != SHM_RING_VERSION ||
+               header->dataOffset + header->slotStride * header->slotCount > static_cast<size_t>(st.st_size)){
+              std::cout << "Shared memory ring " << name << " has an incompatible layout" << std::endl;
+              munmap(mapping, st.st_size);
+              return nullptr;
+            }
+
+            std::unique_ptr<ShmRing> ring(new ShmRing());
+            ring->ringName    = name;
+            ring->mapping     = mapping;
+            ring->mappingSize = st.st_size;
+            ring->ringHeader  = header;
+            ring->readCursor  = header->readSeq.load();
+            return ring;
+          }
+
+          munmap(mapping, st.st_size);
+        }
+      }
+      else{
+        ::close(fd);
+      }
+    }
+
+    if(timeoutMs >= 0 && std::chrono::steady_clock::now() >= deadline){
+      std::cout << "Shared memory ring " << name << " did not appear" << std::endl;
+      return nullptr;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(SHM_OPEN_POLL_MS));
+  }
+}
+
+ShmRing::~ShmRing()
+{
+  if(mapping){
+    munmap(mapping, mappingSize);
+  }
+  if(owner){
+    shm_unlink(ringName.c_str());
+  }
+}
+
+ShmSlotHeader* ShmRing::slotHeader(uint32_t index) const
+{
+  uint8_t* base = reinterpret_cast<uint8_t*>(mapping) + ringHeader->dataOffset;
+  return reinterpret_cast<ShmSlotHeader*>(base + static_cast<uint64_t>(index) * ringHeader->slotStride);
+}
+
+void* ShmRing::payload(uint32_t index) const
+{
+  return reinterpret_cast<uint8_t*>(slotHeader(index)) + SHM_SLOT_ALIGN;
+}
+
+void* ShmRing::reserve(int timeoutMs)
+{
+  ShmRingHeader& header = *ringHeader;
+  uint32_t seq = header.writeSeq.load(std::memory_order_relaxed);
+
+  auto ready = [&](){
+    return header.closed.load() || seq - header.readSeq.load() < header.slotCount;
+  };
+
+  if(!waitUntil(header.readSeq, header.writerWaiting, ready, timeoutMs) || header.closed.load()){
+    return nullptr;
+  }
+
+  currentSlot = seq & (header.slotCount - 1);
+  return payload(currentSlot);
+}
+
+void ShmRing::publish(uint64_t bytes, uint64_t sequence, uint64_t timestampNs)
+{
+  ShmRingHeader& header = *ringHeader;
+  ShmSlotHeader* slot   = slotHeader(currentSlot);
+
+  slot->sequence    = sequence;
+  slot->timestampNs = timestampNs;
+  slot->bytes       = bytes;
+
+  header.writeSeq.fetch_add(1);
+  if(header.readerWaiting.load()){
+    futexWake(&header.writeSeq);
+  }
+}
+
+void* ShmRing::read(ShmSlotHeader& slot, int timeoutMs)
+{
+  ShmRingHeader& header = *ringHeader;
+  uint32_t seq = readCursor;
+
+  auto ready = [&](){
+    return header.writeSeq.load() != seq || header.closed.load();
+  };
+
+  if(!waitUntil(header.writeSeq, header.readerWaiting, ready, timeoutMs) || header.writeSeq.load() == seq){
+    return nullptr;
+  }
+
+  currentSlot = seq & (header.slotCount - 1);
+  slot        = *slotHeader(currentSlot);
+  readCursor++;
+
+  return payload(currentSlot);
+}
+
+void ShmRing::release()
+{
+  ShmRingHeader& header = *ringHeader;
+
+  header.readSeq.fetch_add(1);
+  if(header.writerWaiting.load()){
+    futexWake(&header.readSeq);
+  }
+}
+
+void ShmRing::close()
+{
+  ringHeader->closed.store(1);
+  futexWake(&ringHeader->writeSeq);
+  futexWake(&ringHeader->readSeq);
+}
+
+bool ShmRing::isClosed() const
+{
+  return ringHeader->closed.load() != 0;
+}
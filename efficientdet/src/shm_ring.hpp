@@ -0,0 +1,172 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef SHM_RING
+#define SHM_RING
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+constexpr uint32_t SHM_RING_MAGIC   = 0x52534445;  // "EDSR"
+constexpr uint32_t SHM_RING_VERSION = 1;
+
+// Maximum number of detections in one results ring record
+constexpr int SHM_MAX_DETECTIONS = 100;
+
+enum ShmPayloadFormat : uint32_t {
+  SHM_FORMAT_BGR24      = 0,   // width x height BGR frame, rows packed
+  SHM_FORMAT_RGB24      = 1,   // width x height RGB frame at model resolution
+  SHM_FORMAT_DETECTIONS = 2    // ShmDetections record
+};
+
+
+/*
+	Shared header at the start of the ring. The producer and the consumer each
+	own one sequence counter, kept on separate cache lines. Both are futex
+	words: a side that has to wait sets its waiting flag and sleeps on the
+	other side's counter, the other side only makes the wake-up syscall when
+	the flag is set.
+*/
+struct ShmRingHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t format;
+  uint32_t slotCount;
+  uint64_t slotBytes;     // Payload capacity of one slot
+  uint64_t slotStride;    // Distance between slots, multiple of 64
+  uint64_t dataOffset;    // Offset of slot 0, page aligned
+  int32_t  width;
+  int32_t  height;
+  double   fps;
+
+  alignas(64) std::atomic<uint32_t> writeSeq;      // Slots published by the producer
+  std::atomic<uint32_t>             readerWaiting;
+  alignas(64) std::atomic<uint32_t> readSeq;       // Slots released by the consumer
+  std::atomic<uint32_t>             writerWaiting;
+  alignas(64) std::atomic<uint32_t> closed;
+};
+
+
+/*
+	Per-slot header, the payload follows at the next 64 byte boundary.
+
+	sequence:    Number of the slot in publishing order, starting at 0
+	timestampNs: CLOCK_MONOTONIC time set by the producer, comparable between
+	             processes on the same machine
+	bytes:       Size of the payload
+*/
+struct ShmSlotHeader {
+  uint64_t sequence;
+  uint64_t timestampNs;
+  uint64_t bytes;
+};
+
+
+struct ShmDetection {
+  float   ymin;
+  float   xmin;
+  float   ymax;
+  float   xmax;
+  float   score;
+  int32_t label;
+};
+
+
+/*
+	Payload of a results ring slot. The slot sequence and timestamp are copied
+	from the input frame the detections belong to.
+*/
+struct ShmDetections {
+  uint32_t     count;
+  uint32_t     reserved;
+  ShmDetection items[SHM_MAX_DETECTIONS];
+};
+
+
+/*
+	Layout of a new ring.
+
+	slotCount: Number of slots
+	slotBytes: Payload capacity of one slot
+*/
+struct ShmRingConfig {
+  uint32_t format    = SHM_FORMAT_BGR24;
+  uint32_t slotCount = 4;
+  uint64_t slotBytes = 0;
+  int32_t  width     = 0;
+  int32_t  height    = 0;
+  double   fps       = 0;
+};
+
+
+/*
+	Single-producer, single-consumer ring of fixed-size slots in POSIX shared
+	memory. Payloads are written and read in place, nothing is copied by the
+	ring itself.
+
+	Producer: reserve() a slot, fill the payload, publish() it.
+	Consumer: read() slots in order and release() them in the same order once
+	          the payload is no longer needed. Several slots may be held at
+	          the same time.
+
+	Timeouts are in milliseconds, -1 waits forever.
+*/
+class ShmRing {
+public:
+  // Creates name (ie. "/efficientdet_frames"), replacing a stale ring. The
+  // creator removes the name again when the ring is destroyed.
+  static std::unique_ptr<ShmRing> create(const std::string& name, const ShmRingConfig& config);
+
+  // Opens a ring created by another process, waiting up to timeoutMs for it
+  static std::unique_ptr<ShmRing> open(const std::string& name, int timeoutMs);
+
+  ~ShmRing();
+
+  ShmRing(const ShmRing&) = delete;
+  ShmRing& operator=(const ShmRing&) = delete;
+
+  const ShmRingHeader& header() const { return *ringHeader; }
+
+  // Producer side. reserve() returns nullptr on timeout or when closed.
+  void* reserve(int timeoutMs);
+  void  publish(uint64_t bytes, uint64_t sequence, uint64_t timestampNs);
+
+  // Consumer side. read() returns nullptr on timeout or once the ring is
+  // closed and drained.
+  void* read(ShmSlotHeader& slot, int timeoutMs);
+  void  release();
+
+  // Index of the slot returned by the last reserve() or read()
+  uint32_t lastSlot() const { return currentSlot; }
+
+  // Payload address of slot index, for wrapping slots up front
+  void* payload(uint32_t index) const;
+
+  // Wakes up both sides, further reserve() calls fail and read() drains
+  void close();
+  bool isClosed() const;
+
+private:
+  ShmRing() = default;
+
+  ShmSlotHeader* slotHeader(uint32_t index) const;
+
+  std::string    ringName;
+  bool           owner       = false;
+  void*          mapping     = nullptr;
+  size_t         mappingSize = 0;
+  ShmRingHeader* ringHeader  = nullptr;
+  uint32_t       readCursor  = 0;
+  uint32_t       currentSlot = 0;
+};
+
+
+// CLOCK_MONOTONIC in nanoseconds, for ShmSlotHeader timestamps
+uint64_t shmTimestampNs();
+
+#endif
@@ -0,0 +1,196 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <iostream>
+#include "shm_source.hpp"
+
+namespace {
+
+// Time to wait for the producer to appear and, later, for the next frame
+// before the stream counts as ended
+const int SHM_OPEN_TIMEOUT_MS  = 10000;
+const int SHM_FRAME_TIMEOUT_MS = 5000;
+
+}
+
+ShmFrameSource::ShmFrameSource(const std::string& name, int modelRes)
+  : ringName(name)
+{
+  std::unique_ptr<ShmRing> opened = ShmRing::open(name, SHM_OPEN_TIMEOUT_MS);
+  if(!opened){
+    return;
+  }
+
+  const ShmRingHeader& header = opened->header();
+  cv::Size frameSize(header.width, header.height);
+  size_t   frameBytes = static_cast<size_t>(header.width) * header.height * 3;
+
+  if(header.format == SHM_FORMAT_RGB24){
+    if(header.width != modelRes || header.height != modelRes){
+      std::cout << "Shared memory ring " << name << " delivers RGB frames of " << header.width << "x"
+                << header.height << ", the model needs " << modelRes << "x" << modelRes << std::endl;
+      return;
+    }
+    modelFrames = true;
+  }
+  else if(header.format != SHM_FORMAT_BGR24){
+    std::cout << "Shared memory ring " << name << " does not carry frames" << std::endl;
+    return;
+  }
+
+  if(header.width <= 0 || header.height <= 0 || header.slotBytes < frameBytes){
+    std::cout << "Shared memory ring " << name << " has slots too small for its frame size" << std::endl;
+    return;
+  }
+
+  sourceInfo.fps        = header.fps;
+  sourceInfo.frameCount = 0;
+  sourceInfo.frameSize  = frameSize;
+  sourceInfo.fourcc     = 0;
+
+  // Every ring slot becomes a pool buffer, so frames are never copied
+  std::vector<void*> slots;
+  for(uint32_t i = 0; i < header.slotCount; i++){
+    slots.push_back(opened->payload(i));
+  }
+
+  released.assign(header.slotCount, false);
+  releaseCursor = opened->header().readSeq.load() & (header.slotCount - 1);
+
+  // Headers are kept per slot, so reading without a results ring costs nothing
+  slotHeaders.assign(header.slotCount, ShmSlotHeader{});
+  takeCursor = releaseCursor;
+
+  slotPool.reset(new FramePool("shm " + name, frameSize, CV_8UC3, slots,
+                               [this](int slot){ onRelease(slot); }));
+  ring = std::move(opened);
+}
+
+ShmFrameSource::~ShmFrameSource()
+{
+  // Lets the producer stop instead of waiting for free slots
+  if(ring){
+    ring->close();
+  }
+}
+
+bool ShmFrameSource::read(Frame& frame)
+{
+  frame.full.release();
+  frame.model.release();
+
+  ShmSlotHeader slot;
+  if(!ring->read(slot, SHM_FRAME_TIMEOUT_MS)){
+    return false;
+  }
+
+  int index = static_cast<int>(ring->lastSlot());
+  {
+    std::lock_guard<std::mutex> guard(slotLock);
+    slotHeaders[index] = slot;
+  }
+
+  FrameBuffer buffer = slotPool->wrap(index);
+
+  if(modelFrames){
+    frame.model = std::move(buffer);
+  }
+  else{
+    frame.full = std::move(buffer);
+  }
+
+  return true;
+}
+
+ShmSlotHeader ShmFrameSource::takeSlot()
+{
+  std::lock_guard<std::mutex> guard(slotLock);
+
+  // Slots are read in ring order
+  ShmSlotHeader slot = slotHeaders[takeCursor];
+  takeCursor = (takeCursor + 1) & (static_cast<uint32_t>(slotHeaders.size()) - 1);
+  return slot;
+}
+
+void ShmFrameSource::onRelease(int slot)
+{
+  std::lock_guard<std::mutex> guard(releaseLock);
+
+  released[slot] = true;
+
+  // Hand slots back in ring order only
+  uint32_t mask = static_cast<uint32_t>(released.size()) - 1;
+  while(released[releaseCursor]){
+    released[releaseCursor] = false;
+    ring->release();
+    releaseCursor = (releaseCursor + 1) & mask;
+  }
+}
+
+std::string ShmFrameSource::describe() const
+{
+  return "shared memory " + ringName + " (" + (modelFrames ? "RGB, model resolution" : "BGR") + ", " +
+         std::to_string(ring->header().slotCount) + " slots)";
+}
+
+std::vector<const FramePool*> ShmFrameSource::pools() const
+{
+  return {slotPool.get()};
+}
+
+ShmDetectionSink::ShmDetectionSink(const std::string& name, ShmFrameSource& source, int slots)
+  : frameSource(source)
+{
+  ShmRingConfig config;
+  config.format    = SHM_FORMAT_DETECTIONS;
+  config.slotCount = std::max(1, slots);
+  config.slotBytes = sizeof(ShmDetections);
+
+  ring = ShmRing::create(name, config);
+}
+
+ShmDetectionSink::~ShmDetectionSink()
+{
+  if(ring){
+    ring->close();
+  }
+}
+
+void ShmDetectionSink::write(const std::string& source, int frame, const std::vector<Detection>& detections)
+{
+  std::lock_guard<std::mutex> guard(lock);
+
+  // Taken before a record may be dropped, so the next record is tagged with
+  // its own frame
+  ShmSlotHeader input = frameSource.takeSlot();
+
+  // Never block the detection loop on the reader
+  ShmDetections* record = reinterpret_cast<ShmDetections*>(ring->reserve(0));
+  if(!record){
+    dropped++;
+    return;
+  }
+
+  size_t count = std::min<size_t>(detections.size(), SHM_MAX_DETECTIONS);
+
+  record->count    = static_cast<uint32_t>(count);
+  record->reserved = 0;
+  for(size_t i = 0; i < count; i++){
+    const Detection& detection = detections[i];
+    record->items[i] = ShmDetection{detection.ymin, detection.xmin, detection.ymax, detection.xmax,
+                                    detection.score, detection.label};
+  }
+
+  ring->publish(sizeof(ShmDetections), input.sequence, input.timestampNs);
+  written++;
+}
+
+void ShmDetectionSink::flush()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  std::cout << "Results ring: " << written << " records written, " << dropped
+            << " dropped (reader behind)" << std::endl;
+}
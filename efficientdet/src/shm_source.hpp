@@ -0,0 +1,89 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef SHM_SOURCE
+#define SHM_SOURCE
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "detection_sink.hpp"
+#include "shm_ring.hpp"
+#include "video_source.hpp"
+
+/*
+	Reads frames from a shared-memory ring filled by another process. Frames
+	point straight into the ring slots, a slot is handed back to the producer
+	once the pipeline releases the frame.
+
+	SHM_FORMAT_BGR24 rings deliver full frames, SHM_FORMAT_RGB24 rings must be
+	at model resolution and deliver model input frames.
+
+	name:     Ring name, ie. /efficientdet_frames
+	modelRes: Model input resolution
+*/
+class ShmFrameSource : public FrameSource {
+public:
+  ShmFrameSource(const std::string& name, int modelRes);
+  ~ShmFrameSource() override;
+
+  bool isOpened() const override { return ring != nullptr; }
+  bool read(Frame& frame) override;
+  std::string describe() const override;
+  std::vector<const FramePool*> pools() const override;
+
+  // Slot header of the oldest frame read but not yet taken. Frames are
+  // processed in read order, also when several are in flight per batch, and
+  // a slot is only read again after its frame was released
+  ShmSlotHeader takeSlot();
+
+private:
+  void onRelease(int slot);
+
+  std::string                ringName;
+  std::unique_ptr<ShmRing>   ring;
+  std::unique_ptr<FramePool> slotPool;
+  bool                       modelFrames = false;
+  std::mutex                 slotLock;
+  std::vector<ShmSlotHeader> slotHeaders;
+  uint32_t                   takeCursor = 0;
+
+  // Slots may come back out of order, the ring is released in order
+  std::mutex        releaseLock;
+  std::vector<bool> released;
+  uint32_t          releaseCursor = 0;
+};
+
+
+/*
+	Writes detections to a shared-memory ring (SHM_FORMAT_DETECTIONS), one
+	ShmDetections record per frame, tagged with the sequence and timestamp of
+	the input frame. A reader that falls behind loses records instead of
+	stalling the detection loop.
+
+	name:   Ring name, ie. /efficientdet_results
+	source: Source of the frames the detections belong to
+	slots:  Number of records the reader may lag behind
+*/
+class ShmDetectionSink : public DetectionSink {
+public:
+  ShmDetectionSink(const std::string& name, ShmFrameSource& source, int slots);
+  ~ShmDetectionSink() override;
+
+  bool isOpened() const { return ring != nullptr; }
+
+  void write(const std::string& source, int frame, const std::vector<Detection>& detections) override;
+  void flush() override;
+
+private:
+  std::mutex               lock;
+  std::unique_ptr<ShmRing> ring;
+  ShmFrameSource&          frameSource;
+  uint64_t                 written = 0;
+  uint64_t                 dropped = 0;
+};
+
+#endif
@@ -0,0 +1,66 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <iostream>
+#include "stage_stats.hpp"
+
+StageStats::StageStats(const std::string& name)
+  : stageName(name)
+{
+}
+
+void StageStats::add(std::chrono::microseconds duration)
+{
+  int64_t us = duration.count();
+
+  std::lock_guard<std::mutex> guard(lock);
+
+  minUs = (samples == 0) ? us : std::min(minUs, us);
+  maxUs = std::max(maxUs, us);
+  totalUs += us;
+  samples++;
+}
+
+void StageStats::addSince(std::chrono::steady_clock::time_point start)
+{
+  add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start));
+}
+
+uint64_t StageStats::count() const
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return samples;
+}
+
+double StageStats::meanMs() const
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return samples ? (totalUs / 1000.0) / samples : 0.0;
+}
+
+double StageStats::maxMs() const
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return maxUs / 1000.0;
+}
+
+double StageStats::totalMs() const
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return totalUs / 1000.0;
+}
+
+void StageStats::print() const
+{
+  std::lock_guard<std::mutex> guard(lock);
+
+  double mean = samples ? (totalUs / 1000.0) / samples : 0.0;
+
+  std::cout << "  " << stageName << ": mean " << mean << " ms"
+            << ", min " << minUs / 1000.0 << " ms"
+            << ", max " << maxUs / 1000.0 << " ms"
+            << " (" << samples << " samples)" << std::endl;
+}
@@ -0,0 +1,48 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef STAGE_STATS
+#define STAGE_STATS
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/*
+	Accumulates timings of one pipeline stage (count, mean, min, max). Safe to
+	update from the stage's own thread while others read it.
+
+	name: Stage name used in reports
+*/
+class StageStats {
+public:
+  explicit StageStats(const std::string& name);
+
+  void add(std::chrono::microseconds duration);
+
+  // Convenience for measuring a stage from a start point until now
+  void addSince(std::chrono::steady_clock::time_point start);
+
+  uint64_t count() const;
+  double   meanMs() const;
+  double   maxMs() const;
+  double   totalMs() const;
+
+  const std::string& name() const { return stageName; }
+
+  // Prints "<name>: mean x ms, min y ms, max z ms (n samples)"
+  void print() const;
+
+private:
+  std::string        stageName;
+  mutable std::mutex lock;
+  uint64_t           samples = 0;
+  int64_t            totalUs = 0;
+  int64_t            minUs   = 0;
+  int64_t            maxUs   = 0;
+};
+
+#endif
@@ -0,0 +1,88 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "stream_list.hpp"
+
+namespace {
+
+// out.avi -> out.stream03.avi
+std::string streamFileName(const std::string& path, int index)
+{
+  if(path.empty()){
+    return path;
+  }
+
+  char suffix[16];
+  snprintf(suffix, sizeof(suffix), ".stream%02d", index);
+
+  size_t dot = path.find_last_of('.');
+  if(dot == std::string::npos || path.find('/', dot) != std::string::npos){
+    return path + suffix;
+  }
+
+  return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+// Inputs like synthetic:WxH:N or shm:/name are not files
+bool isFilePath(const std::string& input)
+{
+  return input != "-" && input.find(':') == std::string::npos;
+}
+
+}
+
+bool listStreams(const std::string& list, const std::string& manifest, const std::string& output,
+                 const std::string& detections, std::vector<StreamJob>& streams)
+{
+  std::vector<std::string> inputs;
+
+  std::stringstream items(list);
+  std::string       item;
+  while(std::getline(items, item, ',')){
+    if(!item.empty()){
+      inputs.push_back(item);
+    }
+  }
+
+  if(!manifest.empty()){
+    std::ifstream file(manifest);
+    if(!file){
+      std::cout << "Failed to open stream list " << manifest << std::endl;
+      return false;
+    }
+
+    size_t slash = manifest.find_last_of('/');
+    std::string baseDir = (slash == std::string::npos) ? "" : manifest.substr(0, slash + 1);
+
+    std::string line;
+    while(std::getline(file, line)){
+      line.erase(line.find_last_not_of(" \t\r") + 1);
+      if(line.empty() || line[0] == '#'){
+        continue;
+      }
+      inputs.push_back(line[0] == '/' || !isFilePath(line) ? line : baseDir + line);
+    }
+  }
+
+  if(inputs.empty()){
+    std::cout << "No input streams given" << std::endl;
+    return false;
+  }
+
+  streams.clear();
+  for(size_t i = 0; i < inputs.size(); i++){
+    StreamJob stream;
+    stream.input      = inputs[i];
+    stream.output     = streamFileName(output, static_cast<int>(i));
+    stream.detections = streamFileName(detections, static_cast<int>(i));
+    streams.push_back(stream);
+  }
+
+  return true;
+}
@@ -0,0 +1,44 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef STREAM_LIST
+#define STREAM_LIST
+
+#include <string>
+#include <vector>
+
+/*
+	One input of a multi-stream run and where its results go.
+
+	input:      Anything -i accepts
+	output:     Video output of this stream, empty for none
+	detections: Detections file of this stream, empty for none
+*/
+struct StreamJob {
+  std::string input;
+  std::string output;
+  std::string detections;
+};
+
+
+/*
+	Collect the inputs of a multi-stream run. Stream i writes its video to
+	output and its detections to detections with ".streamNN" inserted before
+	the extension (out.avi -> out.stream03.avi).
+
+	list:       Comma-separated inputs, may be empty
+	manifest:   File with one input per line, may be empty. Empty lines and
+	            lines starting with '#' are skipped, relative file paths are
+	            relative to the manifest.
+	output:     Base name of the video outputs, empty for none
+	detections: Base name of the detections files, empty for none
+	streams:    Filled with the streams of list followed by those of manifest
+
+	Returns false if the manifest can not be read or no stream is given.
+*/
+bool listStreams(const std::string& list, const std::string& manifest, const std::string& output,
+                 const std::string& detections, std::vector<StreamJob>& streams);
+
+#endif
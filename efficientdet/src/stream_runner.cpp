@@ -0,0 +1,347 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "opencv2/opencv.hpp"
+#include "ring_queue.hpp"
+#include "detection_sink.hpp"
+#include "efficientdet_utils.hpp"
+#include "executor.hpp"
+#include "memory_usage.hpp"
+#include "stage_stats.hpp"
+#include "stream_runner.hpp"
+
+namespace {
+
+// Everything one stream owns. Only one task of a stream runs at a time, so
+// none of it needs a lock.
+struct StreamState {
+  explicit StreamState(const StreamJob& job)
+    : job(job), latency(job.input)
+  {
+  }
+
+  StreamJob                          job;
+  std::unique_ptr<FrameSource>       source;
+  std::unique_ptr<VideoSink>         sink;
+  std::unique_ptr<FileDetectionSink> detections;
+
+  Frame   frame;
+  cv::Mat scaled;
+  cv::Mat rgb;
+  std::vector<std::vector<float>> outputs;
+  std::vector<Detection>          found;
+
+  int        frames = 0;
+  bool       failed = false;
+  StageStats latency;
+
+  std::chrono::steady_clock::time_point captured;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point end;
+};
+
+bool openStream(StreamState& stream, SourceOptions sourceOptions, SinkOptions sinkOptions)
+{
+  sourceOptions.input = stream.job.input;
+  stream.source = createFrameSource(sourceOptions);
+  if(!stream.source || !stream.source->isOpened()){
+    std::cout << "Failed to open input " << stream.job.input << std::endl;
+    return false;
+  }
+
+  if(stream.job.output.empty()){
+    sinkOptions.type = "null";
+  }
+  sinkOptions.output = stream.job.output;
+
+  stream.sink = createVideoSink(sinkOptions, stream.source->info().fps, stream.source->info().frameSize);
+  if(!stream.sink || !stream.sink->isOpened()){
+    std::cout << "Failed to open output " << stream.job.output << std::endl;
+    return false;
+  }
+
+  if(!stream.job.detections.empty()){
+    stream.detections.reset(new FileDetectionSink(stream.job.detections));
+    if(!stream.detections->isOpened()){
+      std::cout << "Failed to open detections file " << stream.job.detections << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+}
+
+int runStreams(const std::vector<StreamJob>& streams, const std::string& modelFile,
+               const DetectorOptions& detectorOptions, const SourceOptions& sourceOptions,
+               const SinkOptions& sinkOptions, const PipelineOptions& pipelineOptions,
+               const StreamRunnerOptions& options)
+{
+  std::shared_ptr<tflite::FlatBufferModel> model = loadModel(modelFile);
+  if(!model){
+    return -1;
+  }
+
+  // Streams open first, so the memory budget knows what their buffers take:
+  // the source pools plus the scaled and RGB model input of each stream
+  std::vector<std::unique_ptr<StreamState>> states;
+  size_t streamBytes = 0;
+  for(const StreamJob& job : streams){
+    states.emplace_back(new StreamState(job));
+    if(!openStream(*states.back(), sourceOptions, sinkOptions)){
+      states.back()->failed = true;
+      continue;
+    }
+
+    for(const FramePool* pool : states.back()->source->pools()){
+      streamBytes += pool->totalBytes();
+    }
+    streamBytes += static_cast<size_t>(sourceOptions.modelRes) * sourceOptions.modelRes * 3 * 2;
+  }
+
+  int interpreterCount = std::max(1, std::min<int>(options.interpreters, streams.size()));
+
+  // Interpreters run concurrently, a shared CPU backend context would race
+  DetectorOptions interpreterOptions = detectorOptions;
+  interpreterOptions.numThreads = std::max(1, detectorOptions.numThreads / interpreterCount);
+  interpreterOptions.cpuBackend.reset();
+
+  // Interpreters that do not fit into the memory budget are left out, the
+  // model mapping is counted once
+  size_t accounted = streamBytes;
+
+  std::vector<std::unique_ptr<Detector>> detectors;
+  for(int i = 0; i < interpreterCount; i++){
+    std::unique_ptr<Detector> detector(new Detector());
+    if(!loadDetector(modelFile, interpreterOptions, *detector, model)){
+      return -1;
+    }
+
+    if(options.memoryBudget > 0){
+      InterpreterMemory memory = interpreterMemory(*detector);
+      size_t needed = accounted + memory.ownBytes() + (i == 0 ? memory.modelBytes : 0);
+      if(needed > options.memoryBudget){
+        if(i == 0){
+          std::cout << "Memory budget of " << options.memoryBudget / (1024 * 1024) << " MiB is too small, "
+                    << streams.size() << " streams and one interpreter need "
+                    << (needed + 1024 * 1024 - 1) / (1024 * 1024) << " MiB" << std::endl;
+          return -1;
+        }
+        break;
+      }
+      accounted = needed;
+    }
+
+    if(!warmUpDetector(*detector, 1)){
+      return -1;
+    }
+    detectors.push_back(std::move(detector));
+  }
+
+  if(options.memoryBudget > 0){
+    std::cout << "Memory budget: " << options.memoryBudget / (1024 * 1024) << " MiB, " << accounted / (1024 * 1024)
+              << " MiB accounted";
+    if(static_cast<int>(detectors.size()) != interpreterCount){
+      std::cout << ", interpreters reduced to " << detectors.size();
+    }
+    std::cout << std::endl;
+  }
+  interpreterCount = static_cast<int>(detectors.size());
+
+  const int  MODEL_RES   = detectors[0]->resolution;
+  const bool KERAS_MODEL = detectors[0]->keras;
+  const int  CHANNELS    = 3;
+  cv::Size   modelSize(MODEL_RES, MODEL_RES);
+  size_t     inputFrameBytes = MODEL_RES * MODEL_RES * CHANNELS * sizeof(int8_t);
+
+  StageStats decodeStats("Decode");
+  StageStats preprocessStats("Preprocess");
+  StageStats inferenceStats("Inference");
+  StageStats postprocessStats("Postprocess");
+
+  // Streams with a preprocessed frame waiting for an interpreter, pushed by the
+  // pool threads and taken by the interpreters. Each stream has at most one
+  // frame in flight, so pushes never block.
+  MpmcRing<int> ready(streams.size());
+
+  std::mutex              doneLock;
+  std::condition_variable doneSignal;
+  size_t                  running = 0;
+
+  auto finish = [&](StreamState& stream){
+    stream.end = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> guard(doneLock);
+    running--;
+    doneSignal.notify_all();
+  };
+
+  std::function<void(int)> decode;
+  std::function<void(int)> postprocess;
+
+  // Declared after everything its tasks use, so its threads are joined first
+  std::unique_ptr<Executor> executor = createExecutor(options.scheduler, std::max(1, options.poolThreads),
+                                                      static_cast<int>(streams.size()));
+  if(!executor){
+    return -1;
+  }
+
+  std::cout << "Processing " << streams.size() << " streams with " << interpreterCount << " interpreter(s) of "
+            << interpreterOptions.numThreads << " thread(s) and " << std::max(1, options.poolThreads)
+            << " pool thread(s)" << std::endl;
+
+  decode = [&](int index){
+    StreamState& stream = *states[index];
+
+    auto stageStart = std::chrono::steady_clock::now();
+    if(!stream.source->read(stream.frame)){
+      finish(stream);
+      return;
+    }
+    stream.captured = std::chrono::steady_clock::now();
+    decodeStats.addSince(stageStart);
+
+    if(stream.frame.full.empty()){
+      std::cout << "Stream " << index << " does not deliver full frames" << std::endl;
+      stream.failed = true;
+      finish(stream);
+      return;
+    }
+
+    // Resizing before the channel swap converts far fewer pixels
+    stageStart = std::chrono::steady_clock::now();
+    cv::resize(stream.frame.full.mat, stream.scaled, modelSize, 0, 0, cv::INTER_CUBIC);
+    cv::cvtColor(stream.scaled, stream.rgb, cv::COLOR_BGR2RGB);
+    preprocessStats.addSince(stageStart);
+
+    ready.push(index);
+  };
+
+  postprocess = [&](int index){
+    StreamState& stream = *states[index];
+
+    auto stageStart = std::chrono::steady_clock::now();
+    if(stream.detections){
+      readDetections(*detectors[0], stream.outputs, pipelineOptions.scoreThreshold, stream.found);
+      stream.detections->write(stream.job.input, stream.frames, stream.found);
+    }
+
+    drawBoundingBoxesResized(stream.outputs, KERAS_MODEL, MODEL_RES, stream.frame.full.mat);
+    stream.sink->write(stream.frame.full.mat);
+    stream.frame.full.release();
+    postprocessStats.addSince(stageStart);
+
+    stream.latency.addSince(stream.captured);
+    stream.frames++;
+
+    executor->submit(index, [&decode, index]{ decode(index); });
+  };
+
+  // Interpreters take whichever stream is ready next
+  std::vector<std::thread> interpreterThreads;
+  for(std::unique_ptr<Detector>& detector : detectors){
+    interpreterThreads.emplace_back([&, detector = detector.get()]{
+      int8_t* input = reinterpret_cast<int8_t*>(detector->inTensor->data.raw);
+
+      int index;
+      while(ready.pop(index)){
+        StreamState& stream = *states[index];
+
+        memcpy((void*)input, (void*)stream.rgb.data, inputFrameBytes);
+        inferenceStats.add(timedInference(detector->interpreter.get()));
+        getOutputVectors(detector->outTensor, outputRows(*detector), outputValues(*detector), stream.outputs);
+
+        executor->submit(index, [&postprocess, index]{ postprocess(index); });
+      }
+    });
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  for(size_t i = 0; i < states.size(); i++){
+    if(states[i]->failed){
+      continue;
+    }
+    states[i]->start = std::chrono::steady_clock::now();
+    {
+      std::lock_guard<std::mutex> guard(doneLock);
+      running++;
+    }
+    int index = static_cast<int>(i);
+    executor->submit(index, [&decode, index]{ decode(index); });
+  }
+
+  {
+    std::unique_lock<std::mutex> guard(doneLock);
+    doneSignal.wait(guard, [&]{ return running == 0; });
+  }
+
+  ready.close();
+  for(std::thread& thread : interpreterThreads){
+    thread.join();
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  bool ok     = true;
+  int  frames = 0;
+  for(size_t i = 0; i < states.size(); i++){
+    StreamState& stream = *states[i];
+    if(stream.sink){
+      stream.sink->release();
+    }
+    if(stream.detections){
+      stream.detections->flush();
+    }
+
+    std::cout << "Stream " << i << " (" << stream.job.input << "): ";
+    if(stream.failed){
+      std::cout << "failed after " << stream.frames << " frames" << std::endl;
+      ok = false;
+      continue;
+    }
+
+    double streamSeconds = std::chrono::duration<double>(stream.end - stream.start).count();
+    std::cout << stream.frames << " frames in " << streamSeconds << " s ("
+              << stream.frames / std::max(streamSeconds, 1e-9) << " FPS), latency mean "
+              << stream.latency.meanMs() << " ms, max " << stream.latency.maxMs() << " ms" << std::endl;
+    frames += stream.frames;
+  }
+
+  std::cout << "Processed " << frames << " frames in " << seconds << " s (" << frames / seconds << " FPS)" << std::endl;
+
+  if(pipelineOptions.report){
+    decodeStats.print();
+    preprocessStats.print();
+    inferenceStats.print();
+    postprocessStats.print();
+    executor->printStats();
+  }
+
+  if(pipelineOptions.memory){
+    for(const std::unique_ptr<Detector>& detector : detectors){
+      pipelineOptions.memory->addInterpreter(*detector);
+    }
+    for(const std::unique_ptr<StreamState>& stream : states){
+      if(stream->source){
+        pipelineOptions.memory->addPools(stream->source->pools());
+      }
+    }
+    size_t inputBytes = static_cast<size_t>(MODEL_RES) * MODEL_RES * CHANNELS * 2;
+    pipelineOptions.memory->add("stream model inputs", inputBytes * states.size());
+    pipelineOptions.memory->print();
+  }
+
+  return ok ? 0 : -1;
+}
@@ -0,0 +1,66 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef STREAM_RUNNER
+#define STREAM_RUNNER
+
+#include <string>
+#include <vector>
+#include "detector.hpp"
+#include "pipeline.hpp"
+#include "stream_list.hpp"
+#include "video_sink.hpp"
+#include "video_source.hpp"
+
+/*
+	Options of in-process stream processing.
+
+	interpreters: Number of interpreters, each runs on its own thread and
+	              takes the next stream with a preprocessed frame
+	poolThreads:  Number of threads decoding, preprocessing, postprocessing
+	              and encoding the frames of all streams
+	scheduler:    Executor scheduling the pool threads, "fair" or "steal", see
+	              createExecutor()
+	memoryBudget: Bytes the interpreters, model mapping and stream buffers
+	              may use, fewer interpreters are built if they do not fit. 0
+	              for no limit.
+*/
+struct StreamRunnerOptions {
+  int         interpreters = 2;
+  int         poolThreads  = 2;
+  std::string scheduler    = "fair";
+  size_t      memoryBudget = 0;
+};
+
+
+/*
+	Process streams concurrently in this process. The model is loaded once and
+	shared by every interpreter. Each stream has its own capture, output sink,
+	detections file and buffers, and keeps one frame in flight: decoding and
+	preprocessing run as a task on the shared pool, the frame then waits for a
+	free interpreter, and drawing and encoding run as a second pool task that
+	also queues the stream's next frame. The pool serves the streams fairly, so
+	a stream with large frames slows down itself rather than the others.
+
+	The thread budget is split: detectorOptions.numThreads is divided between
+	the interpreters, options.poolThreads serve everything else. Sources must
+	deliver full frames (not gst-scaled).
+
+	streams:         Streams to process
+	modelFile:       Path to the EfficientDet model
+	detectorOptions: Interpreter options
+	sourceOptions:   Capture options, input is set per stream
+	sinkOptions:     Output options, output is set per stream
+	pipelineOptions: scoreThreshold, report and memory are used
+	options:         Thread and memory budget and scheduling
+
+	Returns 0 if every stream was processed.
+*/
+int runStreams(const std::vector<StreamJob>& streams, const std::string& modelFile,
+               const DetectorOptions& detectorOptions, const SourceOptions& sourceOptions,
+               const SinkOptions& sinkOptions, const PipelineOptions& pipelineOptions,
+               const StreamRunnerOptions& options);
+
+#endif
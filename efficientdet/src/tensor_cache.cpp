@@ -0,0 +1,247 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "opencv2/opencv.hpp"
+#include "efficientdet_utils.hpp"
+#include "stage_stats.hpp"
+#include "tensor_cache.hpp"
+
+namespace {
+
+const char     CACHE_MAGIC[8]     = {'E', 'D', 'T', 'C', 'A', 'C', 'H', 'E'};
+const uint32_t CACHE_VERSION      = 1;
+const uint64_t CACHE_DATA_ALIGN   = 4096;
+const uint64_t CACHE_FRAME_ALIGN  = 64;
+
+uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+size_t dtypeSize(TfLiteType dtype)
+{
+  switch(dtype){
+    case kTfLiteUInt8:
+    case kTfLiteInt8:
+      return 1;
+    case kTfLiteFloat32:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+}
+
+TensorCache::~TensorCache()
+{
+  if(mapping){
+    munmap(mapping, mappingSize);
+  }
+}
+
+bool TensorCache::open(const std::string& path)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0){
+    std::cout << "Failed to open tensor cache " << path << std::endl;
+    return false;
+  }
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(TensorCacheHeader)){
+    std::cout << "Tensor cache " << path << " is too small" << std::endl;
+    ::close(fd);
+    return false;
+  }
+
+  // Private writable mapping: TfLite takes non-const tensor pointers, pages
+  // are only copied if something ever writes to them
+  mappingSize = st.st_size;
+  mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+
+  if(mapping == MAP_FAILED){
+    mapping = nullptr;
+    std::cout << "Failed to map tensor cache " << path << std::endl;
+    return false;
+  }
+
+  madvise(mapping, mappingSize, MADV_SEQUENTIAL | MADV_WILLNEED);
+
+  cacheHeader = reinterpret_cast<const TensorCacheHeader*>(mapping);
+
+  if(memcmp(cacheHeader->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+     cacheHeader->version != CACHE_VERSION ||
+     cacheHeader->dataOffset + cacheHeader->frameCount * cacheHeader->frameStride > mappingSize){
+    std::cout << "Tensor cache " << path << " is invalid or truncated" << std::endl;
+    cacheHeader = nullptr;
+    return false;
+  }
+
+  return true;
+}
+
+void TensorCache::preload() const
+{
+  volatile const uint8_t* bytes = reinterpret_cast<const uint8_t*>(mapping);
+  long pageSize = sysconf(_SC_PAGESIZE);
+  uint8_t sum = 0;
+
+  for(size_t offset = 0; offset < mappingSize; offset += pageSize){
+    sum += bytes[offset];
+  }
+
+  (void)sum;
+}
+
+void* TensorCache::frame(size_t index) const
+{
+  return reinterpret_cast<uint8_t*>(mapping) + cacheHeader->dataOffset + index * cacheHeader->frameStride;
+}
+
+std::string tensorCachePath(const std::string& videoFile, int resolution, TfLiteType dtype)
+{
+  return videoFile + "." + std::to_string(resolution) + "." + TfLiteTypeGetName(dtype) + ".tcache";
+}
+
+int buildTensorCache(const std::string& videoFile, const std::string& cachePath,
+                     int resolution, TfLiteType dtype)
+{
+  size_t elementSize = dtypeSize(dtype);
+  if(elementSize == 0){
+    std::cout << "Unsupported input tensor type " << TfLiteTypeGetName(dtype) << std::endl;
+    return -1;
+  }
+
+  cv::VideoCapture cap(videoFile);
+  if(!cap.isOpened()){
+    std::cout << "Failed to open input file ..." << std::endl;
+    return -1;
+  }
+
+  FILE* file = fopen(cachePath.c_str(), "wb");
+  if(!file){
+    std::cout << "Failed to create tensor cache " << cachePath << std::endl;
+    return -1;
+  }
+
+  TensorCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header.version     = CACHE_VERSION;
+  header.resolution  = resolution;
+  header.channels    = 3;
+  header.dtype       = dtype;
+  header.frameBytes  = static_cast<uint64_t>(resolution) * resolution * header.channels * elementSize;
+  header.frameStride = alignUp(header.frameBytes, CACHE_FRAME_ALIGN);
+  header.dataOffset  = alignUp(sizeof(header), CACHE_DATA_ALIGN);
+  header.fps         = cap.get(cv::CAP_PROP_FPS);
+  header.width       = cap.get(cv::CAP_PROP_FRAME_WIDTH);
+  header.height      = cap.get(cv::CAP_PROP_FRAME_HEIGHT);
+
+  // Header is rewritten with the final frame count at the end
+  std::vector<char> padding(header.dataOffset, 0);
+  fwrite(padding.data(), 1, padding.size(), file);
+
+  cv::Size modelSize(resolution, resolution);
+  cv::Mat  img;
+  cv::Mat  scaledImg;
+  cv::Mat  RGBImg;
+  cv::Mat  tensorImg;
+
+  padding.assign(header.frameStride - header.frameBytes, 0);
+
+  while(cap.read(img)){
+    // Same preprocessing as the detection loop
+    cv::resize(img, scaledImg, modelSize, 0, 0, cv::INTER_CUBIC);
+    cv::cvtColor(scaledImg, RGBImg, cv::COLOR_BGR2RGB);
+
+    const cv::Mat* out = &RGBImg;
+    if(dtype == kTfLiteFloat32){
+      RGBImg.convertTo(tensorImg, CV_32FC3);
+      out = &tensorImg;
+    }
+
+    fwrite(out->data, 1, header.frameBytes, file);
+    fwrite(padding.data(), 1, padding.size(), file);
+    header.frameCount++;
+  }
+
+  fseek(file, 0, SEEK_SET);
+  fwrite(&header, sizeof(header), 1, file);
+
+  bool ok = ferror(file) == 0;
+  ok = (fclose(file) == 0) && ok;
+
+  if(!ok){
+    std::cout << "Failed to write tensor cache " << cachePath << std::endl;
+    return -1;
+  }
+
+  return static_cast<int>(header.frameCount);
+}
+
+int runCacheBenchmark(TensorCache& cache, Detector& detector, int repetitions,
+                      DetectionSink* detections, float scoreThreshold, const std::string& sourceName)
+{
+  const TensorCacheHeader& header = cache.header();
+
+  if(static_cast<int>(header.resolution) != detector.resolution ||
+     header.dtype != static_cast<uint32_t>(detector.inTensor->type) ||
+     header.frameBytes != detector.inTensor->bytes){
+    std::cout << "Tensor cache was built for " << header.resolution << "px "
+              << TfLiteTypeGetName(static_cast<TfLiteType>(header.dtype)) << " input, model expects "
+              << detector.resolution << "px " << TfLiteTypeGetName(detector.inTensor->type) << std::endl;
+    return -1;
+  }
+
+  std::vector<std::vector<float>> outputs;
+  std::vector<Detection>          frameDetections;
+
+  StageStats totalStats("invoke (all repetitions)");
+
+  for(int rep = 0; rep < repetitions; rep++){
+    StageStats repStats("invoke (repetition " + std::to_string(rep + 1) + ")");
+
+    for(size_t i = 0; i < cache.frameCount(); i++){
+      // Zero copy: the input tensor is the cached frame
+      if(!bindInputBuffer(detector, cache.frame(i), header.frameBytes)){
+        std::cout << "Failed to bind cached frame to the input tensor" << std::endl;
+        return -1;
+      }
+
+      auto inferenceTimeDuration = timedInference(detector.interpreter.get());
+      repStats.add(inferenceTimeDuration);
+      totalStats.add(inferenceTimeDuration);
+
+      // Results are identical in every repetition, write them once
+      if(detections && rep == 0){
+        getOutputVectors(detector.outTensor, outputRows(detector), outputValues(detector), outputs);
+        readDetections(detector, outputs, scoreThreshold, frameDetections);
+        detections->write(sourceName, static_cast<int>(i), frameDetections);
+      }
+    }
+
+    repStats.print();
+  }
+
+  totalStats.print();
+
+  double meanMs = totalStats.meanMs();
+  if(meanMs > 0){
+    std::cout << "  mean FPS: " << 1000.0 / meanMs << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,99 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef TENSOR_CACHE
+#define TENSOR_CACHE
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "detection_sink.hpp"
+#include "detector.hpp"
+
+/*
+	On-disk layout of a tensor cache: this header, padding up to dataOffset,
+	then frameCount input tensors, each frameStride bytes apart. dataOffset is
+	page aligned and frameStride a multiple of 64 bytes, so every frame can be
+	handed to TfLite as a tensor buffer straight from the mapping.
+*/
+struct TensorCacheHeader {
+  char     magic[8];
+  uint32_t version;
+  uint32_t resolution;
+  uint32_t channels;
+  uint32_t dtype;        // TfLiteType of the input tensor
+  uint64_t frameCount;
+  uint64_t frameBytes;   // Size of one input tensor
+  uint64_t frameStride;
+  uint64_t dataOffset;
+  double   fps;
+  int32_t  width;        // Size of the source video
+  int32_t  height;
+};
+
+
+/*
+	Read-only memory mapping of a tensor cache file.
+*/
+class TensorCache {
+public:
+  TensorCache() = default;
+  ~TensorCache();
+
+  TensorCache(const TensorCache&) = delete;
+  TensorCache& operator=(const TensorCache&) = delete;
+
+  // Map the file and validate the header. Returns false on failure.
+  bool open(const std::string& path);
+
+  // Touch every page, so the first pass over the frames does no I/O
+  void preload() const;
+
+  const TensorCacheHeader& header() const { return *cacheHeader; }
+  size_t frameCount() const { return cacheHeader ? cacheHeader->frameCount : 0; }
+
+  // Tensor data of frame index, aligned for TfLite
+  void* frame(size_t index) const;
+
+private:
+  void*                    mapping     = nullptr;
+  size_t                   mappingSize = 0;
+  const TensorCacheHeader* cacheHeader = nullptr;
+};
+
+
+/*
+	Default cache file name, keyed by input file, model resolution and dtype,
+	ie. cars_short.mp4.320.uint8.tcache
+*/
+std::string tensorCachePath(const std::string& videoFile, int resolution, TfLiteType dtype);
+
+
+/*
+	Decode videoFile once, preprocess every frame exactly like the detection
+	loop does and store the input tensors contiguously in cachePath.
+
+	videoFile:  Input video
+	cachePath:  Cache file to write
+	resolution: Model input resolution
+	dtype:      Type of the model's input tensor (uint8, int8 or float32)
+
+	Returns the number of cached frames, -1 on failure.
+*/
+int buildTensorCache(const std::string& videoFile, const std::string& cachePath,
+                     int resolution, TfLiteType dtype);
+
+
+/*
+	Run inference over every cached frame, repetitions times. The input tensor
+	points straight into the mapping, so no frame is decoded or copied.
+	Prints per-repetition and overall invoke statistics.
+
+	Returns 0 on success.
+*/
+int runCacheBenchmark(TensorCache& cache, Detector& detector, int repetitions,
+                      DetectionSink* detections, float scoreThreshold, const std::string& sourceName);
+
+#endif
@@ -0,0 +1,330 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "thread_placement.hpp"
+
+namespace {
+
+const char* ROLE_NAMES[THREAD_ROLES] = {"capture", "preprocess", "interpreter", "encoder"};
+
+// Set once before the threads start, read-only afterwards
+ThreadPlacement configured;
+
+int parseRole(const std::string& name)
+{
+  for(int i = 0; i < THREAD_ROLES; i++){
+    if(name == ROLE_NAMES[i]){
+      return i;
+    }
+  }
+  std::cout << "Unknown thread role '" << name << "'. Use one of capture, preprocess, interpreter, encoder" << std::endl;
+  return -1;
+}
+
+// Splits "role=value;role=value" and calls parse for every entry
+template <typename Parse>
+bool parseRoles(const std::string& spec, Parse parse)
+{
+  std::stringstream entries(spec);
+  std::string       entry;
+  while(std::getline(entries, entry, ';')){
+    if(entry.empty()){
+      continue;
+    }
+
+    size_t separator = entry.find('=');
+    if(separator == std::string::npos){
+      std::cout << "Expected role=value, got '" << entry << "'" << std::endl;
+      return false;
+    }
+
+    int role = parseRole(entry.substr(0, separator));
+    if(role < 0 || !parse(role, entry.substr(separator + 1))){
+      return false;
+    }
+  }
+  return true;
+}
+
+bool parseCpus(const std::string& list, std::vector<int>& cpus)
+{
+  long available = sysconf(_SC_NPROCESSORS_CONF);
+
+  std::stringstream ranges(list);
+  std::string       range;
+  while(std::getline(ranges, range, ',')){
+    int first;
+    int last;
+    char dash;
+    std::stringstream text(range);
+    if(!(text >> first)){
+      std::cout << "Invalid CPU list '" << list << "'" << std::endl;
+      return false;
+    }
+    last = first;
+    if(text >> dash && (dash != '-' || !(text >> last))){
+      std::cout << "Invalid CPU list '" << list << "'" << std::endl;
+      return false;
+    }
+
+    if(first < 0 || last < first || last >= available || last >= CPU_SETSIZE){
+      std::cout << "CPUs " << range << " out of range, the system has " << available << " CPUs" << std::endl;
+      return false;
+    }
+    for(int cpu = first; cpu <= last; cpu++){
+      cpus.push_back(cpu);
+    }
+  }
+
+  if(cpus.empty()){
+    std::cout << "Empty CPU list" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool parsePolicy(const std::string& text, RolePlacement& placement)
+{
+  size_t      separator = text.find(':');
+  std::string name      = text.substr(0, separator);
+
+  if(name == "other")      placement.policy = SCHED_OTHER;
+  else if(name == "batch") placement.policy = SCHED_BATCH;
+  else if(name == "idle")  placement.policy = SCHED_IDLE;
+  else if(name == "fifo")  placement.policy = SCHED_FIFO;
+  else if(name == "rr")    placement.policy = SCHED_RR;
+  else{
+    std::cout << "Unknown scheduling policy '" << name << "'. Use one of other, batch, idle, fifo, rr" << std::endl;
+    return false;
+  }
+
+  bool realtime = placement.policy == SCHED_FIFO || placement.policy == SCHED_RR;
+  placement.priority    = realtime ? 1 : 0;
+  placement.hasPriority = separator != std::string::npos;
+
+  if(placement.hasPriority){
+    try{
+      placement.priority = std::stoi(text.substr(separator + 1));
+    }
+    catch(const std::exception&){
+      std::cout << "Invalid priority in '" << text << "'" << std::endl;
+      return false;
+    }
+
+    if(realtime ? (placement.priority < 1 || placement.priority > 99)
+                : (placement.priority < -20 || placement.priority > 19)){
+      std::cout << "Priority of '" << text << "' out of range, 1-99 for fifo and rr, nice -20-19 otherwise" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string policyName(int policy)
+{
+  switch(policy){
+    case SCHED_OTHER: return "other";
+    case SCHED_BATCH: return "batch";
+    case SCHED_IDLE:  return "idle";
+    case SCHED_FIFO:  return "fifo";
+    case SCHED_RR:    return "rr";
+    default:          return "unchanged";
+  }
+}
+
+}
+
+bool ThreadPlacement::empty() const
+{
+  for(const RolePlacement& role : roles){
+    if(!role.cpus.empty() || role.policy >= 0){
+      return false;
+    }
+  }
+  return true;
+}
+
+bool parseAffinity(const std::string& spec, ThreadPlacement& placement)
+{
+  return parseRoles(spec, [&](int role, const std::string& value){
+    return parseCpus(value, placement.roles[role].cpus);
+  });
+}
+
+bool parseSchedule(const std::string& spec, ThreadPlacement& placement)
+{
+  return parseRoles(spec, [&](int role, const std::string& value){
+    return parsePolicy(value, placement.roles[role]);
+  });
+}
+
+void setThreadPlacement(const ThreadPlacement& placement)
+{
+  configured = placement;
+}
+
+bool placeThread(ThreadRole role)
+{
+  const RolePlacement& placement = configured.roles[role];
+  bool ok = true;
+
+  if(!placement.cpus.empty()){
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(int cpu : placement.cpus){
+      CPU_SET(cpu, &set);
+    }
+
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if(error != 0){
+      std::cout << "Failed to set the CPU affinity of a " << ROLE_NAMES[role] << " thread: " << strerror(error) << std::endl;
+      ok = false;
+    }
+  }
+
+  if(placement.policy >= 0){
+    bool realtime = placement.policy == SCHED_FIFO || placement.policy == SCHED_RR;
+
+    struct sched_param param;
+    param.sched_priority = realtime ? placement.priority : 0;
+
+    int error = pthread_setschedparam(pthread_self(), placement.policy, &param);
+    if(error != 0){
+      std::cout << "Failed to set scheduling policy " << policyName(placement.policy) << " of a "
+                << ROLE_NAMES[role] << " thread: " << strerror(error) << std::endl;
+      ok = false;
+    }
+
+    // Linux keeps a nice value per thread
+    if(!realtime && placement.hasPriority &&
+       setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), placement.priority) != 0){
+      std::cout << "Failed to set nice value " << placement.priority << " of a " << ROLE_NAMES[role]
+                << " thread: " << strerror(errno) << std::endl;
+      ok = false;
+    }
+  }
+
+  return ok;
+}
+
+void printThreadPlacement()
+{
+  for(int i = 0; i < THREAD_ROLES; i++){
+    const RolePlacement& placement = configured.roles[i];
+    if(placement.cpus.empty() && placement.policy < 0){
+      continue;
+    }
+
+    std::cout << "Placement " << ROLE_NAMES[i] << ": CPUs ";
+    if(placement.cpus.empty()){
+      std::cout << "any";
+    }
+    for(size_t j = 0; j < placement.cpus.size(); j++){
+      std::cout << (j ? "," : "") << placement.cpus[j];
+    }
+
+    std::cout << ", policy " << policyName(placement.policy);
+    if(placement.hasPriority){
+      std::cout << ":" << placement.priority;
+    }
+    std::cout << std::endl;
+  }
+}
+
+CpuUsageReport::CpuUsageReport()
+  : startTimes(readCoreTimes())
+{
+}
+
+std::vector<CpuUsageReport::CoreTimes> CpuUsageReport::readCoreTimes()
+{
+  std::vector<CoreTimes> cores;
+
+  FILE* stat = fopen("/proc/stat", "r");
+  if(!stat){
+    return cores;
+  }
+
+  char line[512];
+  while(fgets(line, sizeof(line), stat)){
+    // Per-core lines only, "cpu " is the sum
+    if(strncmp(line, "cpu", 3) != 0 || !isdigit(static_cast<unsigned char>(line[3]))){
+      continue;
+    }
+
+    unsigned core;
+    unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
+    if(sscanf(line, "cpu%u %llu %llu %llu %llu %llu %llu %llu %llu", &core, &user, &nice, &system,
+              &idle, &iowait, &irq, &softirq, &steal) != 9){
+      continue;
+    }
+
+    if(core >= cores.size()){
+      cores.resize(core + 1);
+    }
+
+    CoreTimes& times = cores[core];
+    times.user   = user + nice;
+    times.system = system + irq + softirq;
+    times.idle   = idle + iowait;
+    times.total  = times.user + times.system + times.idle + steal;
+  }
+
+  fclose(stat);
+  return cores;
+}
+
+void CpuUsageReport::print() const
+{
+  std::vector<CoreTimes> endTimes = readCoreTimes();
+
+  std::cout << "CPU utilization:" << std::endl;
+  std::streamsize precision = std::cout.precision(3);
+
+  for(size_t core = 0; core < endTimes.size() && core < startTimes.size(); core++){
+    const CoreTimes& start = startTimes[core];
+    const CoreTimes& end   = endTimes[core];
+
+    // Cores that were offline have no ticks
+    double total = static_cast<double>(end.total - start.total);
+    if(total <= 0){
+      continue;
+    }
+
+    double user   = 100.0 * (end.user - start.user) / total;
+    double system = 100.0 * (end.system - start.system) / total;
+
+    std::cout << "  cpu" << core << ": " << 100.0 - 100.0 * (end.idle - start.idle) / total << "% busy (user "
+              << user << "%, system " << system << "%)";
+
+    std::string roles;
+    for(int i = 0; i < THREAD_ROLES; i++){
+      const std::vector<int>& cpus = configured.roles[i].cpus;
+      for(int cpu : cpus){
+        if(cpu == static_cast<int>(core)){
+          roles += roles.empty() ? ROLE_NAMES[i] : std::string(", ") + ROLE_NAMES[i];
+        }
+      }
+    }
+    if(!roles.empty()){
+      std::cout << " " << roles;
+    }
+    std::cout << std::endl;
+  }
+
+  std::cout.precision(precision);
+}
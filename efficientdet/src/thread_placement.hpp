@@ -0,0 +1,123 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef THREAD_PLACEMENT
+#define THREAD_PLACEMENT
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+	Kinds of threads the demo starts. Each thread applies the placement of its
+	role when it starts, threads created by it (ie. the TFLite and XNNPACK
+	thread pools of an interpreter) inherit it.
+
+	THREAD_CAPTURE:     Dedicated readers: --realtime reader, image decoders
+	THREAD_PREPROCESS:  Pool threads decoding, preprocessing, drawing and
+	                    encoding the frames of in-process streams
+	THREAD_INTERPRETER: Threads building and invoking interpreters, with their
+	                    thread pools. Includes the main detection loop, which
+	                    also reads and preprocesses inline.
+	THREAD_ENCODER:     The encoder thread of the video writer
+*/
+enum ThreadRole {
+  THREAD_CAPTURE = 0,
+  THREAD_PREPROCESS,
+  THREAD_INTERPRETER,
+  THREAD_ENCODER,
+  THREAD_ROLES
+};
+
+
+/*
+	Placement of the threads of one role.
+
+	cpus:     CPUs the threads may run on, empty to leave the affinity alone
+	policy:   SCHED_OTHER, SCHED_BATCH, SCHED_IDLE, SCHED_FIFO or SCHED_RR,
+	          -1 to leave the policy alone
+	priority: Real-time priority (1-99) for SCHED_FIFO and SCHED_RR, nice
+	          value (-20-19) for the others
+*/
+struct RolePlacement {
+  std::vector<int> cpus;
+  int              policy      = -1;
+  int              priority    = 0;
+  bool             hasPriority = false;
+};
+
+struct ThreadPlacement {
+  RolePlacement roles[THREAD_ROLES];
+
+  bool empty() const;
+};
+
+
+/*
+	Parse the CPU sets of --affinity into placement, ie.
+	"capture=0;preprocess=0-1;interpreter=2-5;encoder=1". Roles are capture,
+	preprocess, interpreter and encoder, CPUs are comma-separated numbers or
+	ranges.
+
+	Returns false on a malformed spec or a CPU the system does not have.
+*/
+bool parseAffinity(const std::string& spec, ThreadPlacement& placement);
+
+
+/*
+	Parse the scheduling of --sched into placement, ie.
+	"interpreter=fifo:10;encoder=other:5". Policies are other, batch, idle,
+	fifo and rr, optionally followed by a priority.
+
+	Returns false on a malformed spec.
+*/
+bool parseSchedule(const std::string& spec, ThreadPlacement& placement);
+
+
+/*
+	Make placement the process-wide configuration. Call once, before any
+	thread that applies it is started.
+*/
+void setThreadPlacement(const ThreadPlacement& placement);
+
+
+/*
+	Apply the configured placement of role to the calling thread. Failures
+	(ie. real-time policies without CAP_SYS_NICE) are printed and leave the
+	thread as it was.
+
+	Returns false if part of the placement could not be applied.
+*/
+bool placeThread(ThreadRole role);
+
+
+// Prints the configured placement, one line per configured role
+void printThreadPlacement();
+
+
+/*
+	Measures the utilization of every core from /proc/stat between
+	construction and print(), and lists the roles placed on each core.
+*/
+class CpuUsageReport {
+public:
+  CpuUsageReport();
+
+  void print() const;
+
+private:
+  struct CoreTimes {
+    uint64_t user   = 0;
+    uint64_t system = 0;
+    uint64_t idle   = 0;
+    uint64_t total  = 0;
+  };
+
+  static std::vector<CoreTimes> readCoreTimes();
+
+  std::vector<CoreTimes> startTimes;
+};
+
+#endif
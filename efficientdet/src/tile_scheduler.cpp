@@ -0,0 +1,148 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <iostream>
+#include "tile_scheduler.hpp"
+
+namespace {
+
+// Change detection runs on a copy of the frame downscaled by this factor,
+// which also averages out sensor noise
+const int THUMB_SCALE = 8;
+
+// Objects on tile borders are found twice, keep the stronger one
+const float DUPLICATE_IOU = 0.5f;
+
+// Tile origins spread evenly, so the last tile ends at the frame border
+int tileOrigin(int index, int count, int length, int side)
+{
+  return count > 1 ? static_cast<int>(static_cast<int64_t>(index) * (length - side) / (count - 1)) : 0;
+}
+
+}
+
+TileScheduler::TileScheduler(Detector& tileDetector, const TileOptions& options)
+  : tileOptions(options), cropBatch(tileDetector), tileStats("tile inference")
+{
+}
+
+void TileScheduler::layout(cv::Size frameSize)
+{
+  int side = std::min({cropBatch.resolution(), frameSize.width, frameSize.height});
+  int cols = (frameSize.width  + side - 1) / side;
+  int rows = (frameSize.height + side - 1) / side;
+
+  cv::Size thumbSize(std::max(1, frameSize.width / THUMB_SCALE), std::max(1, frameSize.height / THUMB_SCALE));
+  cv::Rect thumbBounds(0, 0, thumbSize.width, thumbSize.height);
+
+  tiles.clear();
+  for(int row = 0; row < rows; row++){
+    for(int col = 0; col < cols; col++){
+      Tile tile;
+      tile.region = cv::Rect(tileOrigin(col, cols, frameSize.width, side),
+                             tileOrigin(row, rows, frameSize.height, side), side, side);
+
+      cv::Rect thumbRegion(tile.region.x / THUMB_SCALE, tile.region.y / THUMB_SCALE,
+                           std::max(1, side / THUMB_SCALE), std::max(1, side / THUMB_SCALE));
+      tile.thumbRegion = thumbRegion & thumbBounds;
+
+      tiles.push_back(tile);
+    }
+  }
+
+  // Allocated once per frame size, the per-frame work reuses them
+  thumb.create(thumbSize, CV_8UC3);
+  thumbGray.create(thumbSize, CV_8UC1);
+  reference.create(thumbSize, CV_8UC1);
+  difference.create(thumbSize, CV_8UC1);
+
+  layoutSize = frameSize;
+
+  std::cout << "Tiles: " << cols << "x" << rows << " tiles of " << side << "x" << side << std::endl;
+}
+
+bool TileScheduler::detect(const cv::Mat& frame, std::vector<Detection>& detections)
+{
+  if(frame.size() != layoutSize){
+    layout(frame.size());
+  }
+
+  frames++;
+
+  cv::resize(frame, thumb, thumb.size(), 0, 0, cv::INTER_AREA);
+  cv::cvtColor(thumb, thumbGray, cv::COLOR_BGR2GRAY);
+
+  // Tiles that never ran, are due for a refresh or changed since their last
+  // inference
+  changed.clear();
+  for(size_t i = 0; i < tiles.size(); i++){
+    Tile& tile  = tiles[i];
+    bool  stale = !tile.inferred ||
+                  (tileOptions.refresh > 0 && frames - tile.lastInferred >= static_cast<uint64_t>(tileOptions.refresh));
+
+    if(!stale){
+      cv::Mat diff = difference(tile.thumbRegion);
+      cv::absdiff(thumbGray(tile.thumbRegion), reference(tile.thumbRegion), diff);
+      stale = cv::mean(diff)[0] > tileOptions.threshold;
+    }
+
+    if(stale){
+      changed.push_back(static_cast<int>(i));
+    }
+  }
+
+  // Changed tiles in batches of the detector's batch size
+  for(size_t first = 0; first < changed.size(); first += cropBatch.capacity()){
+    size_t last = std::min(changed.size(), first + cropBatch.capacity());
+
+    regions.clear();
+    for(size_t i = first; i < last; i++){
+      regions.push_back(tiles[changed[i]].region);
+    }
+
+    tileStats.add(cropBatch.run(frame, regions, tileOptions.minScore, regionDetections));
+
+    for(size_t i = first; i < last; i++){
+      Tile& tile = tiles[changed[i]];
+      tile.detections.swap(regionDetections[i - first]);
+      tile.inferred     = true;
+      tile.lastInferred = frames;
+
+      // Later changes are measured against the content the detections are for
+      cv::Mat tileReference = reference(tile.thumbRegion);
+      thumbGray(tile.thumbRegion).copyTo(tileReference);
+    }
+  }
+
+  tilesInferred += changed.size();
+
+  // Fresh detections of changed tiles plus cached ones of static tiles
+  detections.clear();
+  for(const Tile& tile : tiles){
+    for(const Detection& detection : tile.detections){
+      auto duplicate = std::find_if(detections.begin(), detections.end(), [&](const Detection& other){
+        return other.label == detection.label && intersectionOverUnion(other, detection) > DUPLICATE_IOU;
+      });
+
+      if(duplicate == detections.end()){
+        detections.push_back(detection);
+      }
+      else if(duplicate->score < detection.score){
+        *duplicate = detection;
+      }
+    }
+  }
+
+  return true;
+}
+
+void TileScheduler::printStats() const
+{
+  std::cout << "Tiles: " << tilesInferred << " tile inferences in " << frames << " frames ("
+            << (frames ? static_cast<double>(tilesInferred) / frames : 0.0) << " of "
+            << tiles.size() << " tiles per frame)" << std::endl;
+  tileStats.print();
+}
@@ -0,0 +1,85 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef TILE_SCHEDULER
+#define TILE_SCHEDULER
+
+#include <cstdint>
+#include <vector>
+#include "crop_batch.hpp"
+#include "region_scheduler.hpp"
+#include "stage_stats.hpp"
+
+/*
+	Options of tile-level change detection.
+
+	threshold: Mean absolute difference in gray levels (0-255) of a tile to
+	           its state at its last inference that marks it as changed
+	refresh:   Re-infer every tile after this many frames even if it did not
+	           change, 0 for never
+	minScore:  Minimum score of detections in tiles
+*/
+struct TileOptions {
+  double threshold = 4.0;
+  int    refresh   = 300;
+  float  minScore  = 0.3f;
+};
+
+
+/*
+	Partial-frame inference for fixed cameras. The full-resolution frame is
+	covered by a grid of model-sized tiles (overlapping where the frame size
+	is not a multiple of the model resolution). Every frame, each tile gets a
+	change score against its content at its last inference, computed on a
+	small gray copy of the frame. Only changed tiles are inferred, packed into
+	batches, and their detections are merged with the cached detections of the
+	static tiles.
+
+	Tiles are inferred at full resolution, so small objects keep their size in
+	pixels. Objects crossing tile borders may be found in two tiles, the
+	weaker of two overlapping detections of the same class is dropped.
+
+	tileDetector: Detector for the tiles, its batch size is the number of
+	              tiles per Invoke()
+	options:      Tile settings
+*/
+class TileScheduler : public RegionScheduler {
+public:
+  TileScheduler(Detector& tileDetector, const TileOptions& options);
+
+  bool detect(const cv::Mat& frame, std::vector<Detection>& detections) override;
+  void fullFrame(const cv::Mat& frame, const std::vector<Detection>& detections) override {}
+  void printStats() const override;
+
+private:
+  struct Tile {
+    cv::Rect               region;      // In frame pixels
+    cv::Rect               thumbRegion; // In the change detection thumbnail
+    uint64_t               lastInferred = 0;
+    bool                   inferred     = false;
+    std::vector<Detection> detections;
+  };
+
+  void layout(cv::Size frameSize);
+
+  TileOptions tileOptions;
+  CropBatch   cropBatch;
+  StageStats  tileStats;
+
+  std::vector<Tile>                   tiles;
+  cv::Size                            layoutSize;
+  cv::Mat                             thumb;
+  cv::Mat                             thumbGray;
+  cv::Mat                             reference;
+  cv::Mat                             difference;
+  std::vector<int>                    changed;
+  std::vector<cv::Rect>               regions;
+  std::vector<std::vector<Detection>> regionDetections;
+
+  uint64_t frames        = 0;
+  uint64_t tilesInferred = 0;
+};
+
+#endif
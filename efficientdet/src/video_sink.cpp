@@ -0,0 +1,196 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include "video_sink.hpp"
+
+namespace {
+
+int parseFourcc(const std::string& codec)
+{
+  if(codec.size() != 4){
+    std::cout << "Codec must be a four character code (ie. mp4v, avc1), got '" << codec << "'" << std::endl;
+    return -1;
+  }
+  return cv::VideoWriter::fourcc(codec[0], codec[1], codec[2], codec[3]);
+}
+
+// Any sink that is backed by cv::VideoWriter
+class OpenCvSink : public VideoSink {
+public:
+  OpenCvSink(const std::string& description) : text(description) {}
+
+  bool isOpened() const override { return writer.isOpened(); }
+  void write(const cv::Mat& frame) override { writer << frame; }
+  void release() override { writer.release(); }
+  std::string describe() const override { return text; }
+
+  cv::VideoWriter writer;
+
+private:
+  std::string text;
+};
+
+// YUV4MPEG2 stream, readable by ffmpeg, gst-launch (y4mdec) and most players
+class Y4mSink : public VideoSink {
+public:
+  Y4mSink(const std::string& output, double fps, cv::Size frameSize)
+    : path(output), size(frameSize)
+  {
+    // Y4M 4:2:0 needs even dimensions
+    if(size.width % 2 || size.height % 2){
+      std::cout << "Y4M output needs even frame dimensions, got "
+                << size.width << "x" << size.height << std::endl;
+      return;
+    }
+
+    file = (path == "-") ? stdout : fopen(path.c_str(), "wb");
+    if(!file){
+      return;
+    }
+
+    // One frame per write keeps pipes flowing without extra syscalls
+    setvbuf(file, nullptr, _IOFBF, size.area() * 3 / 2 + 64);
+
+    int fpsNum = static_cast<int>(std::lround(fps * 1000));
+    int fpsDen = 1000;
+    if(fpsNum <= 0){
+      fpsNum = 30;
+      fpsDen = 1;
+    }
+
+    fprintf(file, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C420jpeg\n", size.width, size.height, fpsNum, fpsDen);
+
+    // Reused for every frame
+    yuv.create(size.height * 3 / 2, size.width, CV_8UC1);
+  }
+
+  ~Y4mSink() override { release(); }
+
+  bool isOpened() const override { return file != nullptr; }
+
+  void write(const cv::Mat& frame) override
+  {
+    cv::cvtColor(frame, yuv, cv::COLOR_BGR2YUV_I420);
+    fputs("FRAME\n", file);
+    fwrite(yuv.data, 1, yuv.total(), file);
+  }
+
+  void release() override
+  {
+    if(!file){
+      return;
+    }
+    if(file == stdout){
+      fflush(file);
+    }
+    else{
+      fclose(file);
+    }
+    file = nullptr;
+  }
+
+  std::string describe() const override
+  {
+    return "y4m " + (path == "-" ? std::string("stdout") : path);
+  }
+
+private:
+  std::string path;
+  cv::Size    size;
+  FILE*       file = nullptr;
+  cv::Mat     yuv;
+};
+
+class NullSink : public VideoSink {
+public:
+  bool isOpened() const override { return true; }
+  void write(const cv::Mat& frame) override {}
+  void release() override {}
+  std::string describe() const override { return "null (frames are discarded)"; }
+};
+
+}
+
+std::unique_ptr<VideoSink> createVideoSink(const SinkOptions& options, double fps, cv::Size frameSize)
+{
+  const std::string& type = options.type;
+
+  if(type == "null"){
+    return std::unique_ptr<VideoSink>(new NullSink());
+  }
+
+  if(type == "y4m"){
+    return std::unique_ptr<VideoSink>(new Y4mSink(options.output, fps, frameSize));
+  }
+
+  if(type == "gst"){
+    int fourcc = parseFourcc(options.codec);
+    if(fourcc == -1){
+      return nullptr;
+    }
+    auto sink = new OpenCvSink("gstreamer " + options.output + " (" + options.codec + ")");
+    sink->writer.open(options.output, cv::CAP_GSTREAMER, fourcc, fps, frameSize, true);
+    return std::unique_ptr<VideoSink>(sink);
+  }
+
+  if(type == "gst-pipeline"){
+    // Encoder, muxer and destination are all part of the pipeline string
+    auto sink = new OpenCvSink("gstreamer pipeline '" + options.output + "'");
+    sink->writer.open(options.output, cv::CAP_GSTREAMER, 0, fps, frameSize, true);
+    return std::unique_ptr<VideoSink>(sink);
+  }
+
+  if(type == "ffmpeg"){
+    int fourcc = parseFourcc(options.codec);
+    if(fourcc == -1){
+      return nullptr;
+    }
+
+    // OpenCV passes these to the FFmpeg encoder as AVOptions ("key;value|key;value")
+    std::stringstream encoderOptions;
+    if(!options.preset.empty()){
+      encoderOptions << "preset;" << options.preset;
+    }
+    if(options.quality >= 0){
+      encoderOptions << (options.preset.empty() ? "" : "|") << "crf;" << options.quality;
+    }
+    if(!encoderOptions.str().empty()){
+      setenv("OPENCV_FFMPEG_WRITER_OPTIONS", encoderOptions.str().c_str(), 1);
+    }
+
+    std::stringstream description;
+    description << "ffmpeg " << options.output << " (" << options.codec;
+    if(!options.preset.empty()){
+      description << ", preset " << options.preset;
+    }
+    if(options.quality >= 0){
+      description << ", crf " << options.quality;
+    }
+    description << ")";
+
+    auto sink = new OpenCvSink(description.str());
+    sink->writer.open(options.output, cv::CAP_FFMPEG, fourcc, fps, frameSize, true);
+    return std::unique_ptr<VideoSink>(sink);
+  }
+
+  if(type == "mjpeg"){
+    auto sink = new OpenCvSink("mjpeg " + options.output +
+                               (options.quality >= 0 ? " (quality " + std::to_string(options.quality) + ")" : ""));
+    sink->writer.open(options.output, cv::CAP_OPENCV_MJPEG,
+                      cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), fps, frameSize, true);
+    if(sink->writer.isOpened() && options.quality >= 0){
+      sink->writer.set(cv::VIDEOWRITER_PROP_QUALITY, options.quality);
+    }
+    return std::unique_ptr<VideoSink>(sink);
+  }
+
+  std::cout << "Unknown output sink '" << type << "'. Use one of gst, gst-pipeline, ffmpeg, mjpeg, y4m, null" << std::endl;
+  return nullptr;
+}
@@ -0,0 +1,63 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef VIDEO_SINK
+#define VIDEO_SINK
+
+#include <memory>
+#include <string>
+#include "opencv2/opencv.hpp"
+
+/*
+	Destination for rendered BGR frames. Implementations are only used from one
+	thread at a time (the writer thread).
+*/
+class VideoSink {
+public:
+  virtual ~VideoSink() = default;
+
+  virtual bool isOpened() const = 0;
+  virtual void write(const cv::Mat& frame) = 0;
+  virtual void release() = 0;
+
+  // Human readable description for the startup log
+  virtual std::string describe() const = 0;
+};
+
+
+/*
+	Output selection from the command line.
+
+	type:    gst          - GStreamer backend writing to a file (default, out.avi / mp4v)
+	         gst-pipeline - output is a GStreamer pipeline string starting with appsrc
+	         ffmpeg       - FFmpeg backend, codec / preset / quality are honoured
+	         mjpeg        - OpenCV's built-in MJPEG encoder, quality is honoured
+	         y4m          - Uncompressed YUV4MPEG2 (4:2:0) to a file, FIFO or "-" for stdout
+	         null         - Discard all frames, for benchmarks
+	output:  File name, pipeline string or "-"
+	codec:   Fourcc for the gst and ffmpeg sinks (ie. mp4v, avc1, XVID)
+	preset:  FFmpeg encoder speed preset (ie. ultrafast, veryfast, medium)
+	quality: FFmpeg CRF or MJPEG quality (0-100). Negative keeps the encoder default.
+*/
+struct SinkOptions {
+  std::string type    = "gst";
+  std::string output  = "out.avi";
+  std::string codec   = "mp4v";
+  std::string preset;
+  int         quality = -1;
+};
+
+
+/*
+	Creates and opens the sink selected by options. Returns nullptr for an unknown
+	sink type, otherwise check isOpened() on the result.
+
+	options:   Sink selection
+	fps:       Frame rate of the output
+	frameSize: Size of every frame passed to write()
+*/
+std::unique_ptr<VideoSink> createVideoSink(const SinkOptions& options, double fps, cv::Size frameSize);
+
+#endif
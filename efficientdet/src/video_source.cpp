@@ -0,0 +1,230 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include "video_source.hpp"
+#include "gst_source.hpp"
+#include "latest_frame_source.hpp"
+#include "pipe_source.hpp"
+#include "shm_source.hpp"
+
+SourceInfo readSourceInfo(cv::VideoCapture& cap)
+{
+  SourceInfo info;
+  info.fps        = cap.get(cv::CAP_PROP_FPS);
+  info.frameCount = cap.get(cv::CAP_PROP_FRAME_COUNT);
+  info.frameSize  = cv::Size(cap.get(cv::CAP_PROP_FRAME_WIDTH), cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+  info.fourcc     = cap.get(cv::CAP_PROP_FOURCC);
+  return info;
+}
+
+VideoFileSource::VideoFileSource(const std::string& path, int depth, int startFrame, int maxFrames)
+  : inputPath(path), cap(path), framesLeft(maxFrames)
+{
+  if(!cap.isOpened()){
+    return;
+  }
+
+  sourceInfo  = readSourceInfo(cap);
+
+  if(startFrame > 0){
+    cap.set(cv::CAP_PROP_POS_FRAMES, startFrame);
+    sourceInfo.frameCount = std::max(0.0, sourceInfo.frameCount - startFrame);
+  }
+  if(maxFrames >= 0){
+    sourceInfo.frameCount = std::min<double>(sourceInfo.frameCount, maxFrames);
+  }
+
+  capturePool.reset(new FramePool("capture", sourceInfo.frameSize, CV_8UC3, depth));
+}
+
+bool VideoFileSource::read(Frame& frame)
+{
+  frame.model.release();
+
+  if(framesLeft == 0){
+    frame.full.release();
+    return false;
+  }
+
+  frame.full = capturePool->acquire();
+
+  cap >> frame.full.mat;
+
+  if(frame.full.mat.empty()){
+    frame.full.release();
+    return false;
+  }
+
+  if(framesLeft > 0){
+    framesLeft--;
+  }
+
+  return true;
+}
+
+std::vector<const FramePool*> VideoFileSource::pools() const
+{
+  return {capturePool.get()};
+}
+
+namespace {
+
+const double SYNTHETIC_FPS   = 30.0;
+const int    SYNTHETIC_BOXES = 6;
+
+}
+
+SyntheticSource::SyntheticSource(cv::Size frameSize, int frameCount, int depth)
+{
+  if(frameSize.width <= 0 || frameSize.height <= 0 || frameCount <= 0){
+    return;
+  }
+
+  sourceInfo.fps        = SYNTHETIC_FPS;
+  sourceInfo.frameCount = frameCount;
+  sourceInfo.frameSize  = frameSize;
+  sourceInfo.fourcc     = 0;
+
+  // Gradient with a fine texture, so scaling and encoding cost about as much
+  // as on camera footage instead of a flat image
+  background.create(frameSize, CV_8UC3);
+  for(int y = 0; y < frameSize.height; y++){
+    uint8_t* row = background.ptr<uint8_t>(y);
+    for(int x = 0; x < frameSize.width; x++){
+      row[3 * x]     = static_cast<uint8_t>(x * 255 / frameSize.width);
+      row[3 * x + 1] = static_cast<uint8_t>(y * 255 / frameSize.height);
+      row[3 * x + 2] = static_cast<uint8_t>(((x * 7) ^ (y * 13)) & 0x3f) + 96;
+    }
+  }
+
+  capturePool.reset(new FramePool("capture", frameSize, CV_8UC3, depth));
+}
+
+bool SyntheticSource::read(Frame& frame)
+{
+  frame.model.release();
+
+  if(frameIndex >= sourceInfo.frameCount){
+    frame.full.release();
+    return false;
+  }
+
+  frame.full = capturePool->acquire();
+  cv::Mat& img = frame.full.mat;
+  background.copyTo(img);
+
+  int width  = sourceInfo.frameSize.width;
+  int height = sourceInfo.frameSize.height;
+
+  // Boxes move across the frame at different speeds and lanes
+  for(int i = 0; i < SYNTHETIC_BOXES; i++){
+    int boxWidth  = width / 8;
+    int boxHeight = height / 10;
+    int lane      = (i + 1) * height / (SYNTHETIC_BOXES + 2);
+    int x         = ((i * width / SYNTHETIC_BOXES) + frameIndex * (2 + i) * width / 600) % width;
+
+    cv::rectangle(img, cv::Rect(x, lane, boxWidth, boxHeight),
+                  cv::Scalar(40 * i, 255 - 40 * i, 128), cv::FILLED);
+  }
+
+  cv::putText(img, "synthetic " + std::to_string(frameIndex),
+              cv::Point(15, height - 20), cv::FONT_HERSHEY_SIMPLEX, 1.0, CV_RGB(255, 255, 255), 2);
+
+  frameIndex++;
+  return true;
+}
+
+std::string SyntheticSource::describe() const
+{
+  return "synthetic " + std::to_string(sourceInfo.frameSize.width) + "x" +
+         std::to_string(sourceInfo.frameSize.height);
+}
+
+std::vector<const FramePool*> SyntheticSource::pools() const
+{
+  return {capturePool.get()};
+}
+
+bool parseSyntheticInput(const std::string& input, cv::Size& frameSize, int& frameCount)
+{
+  int  width  = 0;
+  int  height = 0;
+  char end    = 0;
+
+  if(input.rfind("synthetic:", 0) != 0 ||
+     sscanf(input.c_str(), "synthetic:%dx%d:%d%c", &width, &height, &frameCount, &end) != 3){
+    return false;
+  }
+
+  frameSize = cv::Size(width, height);
+  return width > 0 && height > 0 && frameCount > 0;
+}
+
+namespace {
+
+std::unique_ptr<FrameSource> openFrameSource(const SourceOptions& options)
+{
+  if(isPipeInput(options.input)){
+    return std::unique_ptr<FrameSource>(new PipeSource(options.input, options.inputFormat, options.inputSize,
+                                                       options.inputFps, options.depth));
+  }
+
+  if(options.input.rfind("shm:", 0) == 0){
+    return std::unique_ptr<FrameSource>(new ShmFrameSource(options.input.substr(4), options.modelRes));
+  }
+
+  if(options.input.rfind("synthetic:", 0) == 0){
+    cv::Size frameSize;
+    int      frameCount = 0;
+
+    if(!parseSyntheticInput(options.input, frameSize, frameCount)){
+      std::cout << "Synthetic input must be given as synthetic:WxH:N, ie. synthetic:1920x1080:300" << std::endl;
+      return nullptr;
+    }
+
+    return std::unique_ptr<FrameSource>(new SyntheticSource(frameSize, frameCount, options.depth));
+  }
+
+  if(options.capture == "opencv"){
+    return std::unique_ptr<FrameSource>(new VideoFileSource(options.input, options.depth));
+  }
+
+  if(options.capture == "gst-scaled" || options.capture == "gst-tee"){
+#ifdef EFFICIENTDET_GSTREAMER
+    bool withFull = options.capture == "gst-tee";
+    return std::unique_ptr<FrameSource>(
+      new GstPipelineSource(options.input, options.modelRes, withFull, options.depth));
+#else
+    std::cout << "GStreamer capture is not compiled in, rebuild with 'make GSTREAMER=1'" << std::endl;
+    return nullptr;
+#endif
+  }
+
+  std::cout << "Unknown capture mode '" << options.capture << "'. Use one of opencv, gst-scaled, gst-tee" << std::endl;
+  return nullptr;
+}
+
+}
+
+std::unique_ptr<FrameSource> createFrameSource(const SourceOptions& options)
+{
+  if(!options.realtime){
+    return openFrameSource(options);
+  }
+
+  // One more frame waits for the caller, one more is being read
+  SourceOptions wrappedOptions = options;
+  wrappedOptions.depth += 2;
+
+  std::unique_ptr<FrameSource> source = openFrameSource(wrappedOptions);
+  if(!source){
+    return nullptr;
+  }
+
+  return std::unique_ptr<FrameSource>(new LatestFrameSource(std::move(source)));
+}
@@ -0,0 +1,168 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef VIDEO_SOURCE
+#define VIDEO_SOURCE
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "opencv2/opencv.hpp"
+#include "frame_pool.hpp"
+
+struct SourceInfo {
+  double   fps        = 0;
+  double   frameCount = 0;
+  cv::Size frameSize;
+  int      fourcc     = 0;
+};
+
+
+/*
+	One frame as delivered by a FrameSource. A source fills at least one of the
+	two buffers.
+
+	full:  BGR frame at input resolution
+	model: RGB frame at model resolution, ready to be copied into the input tensor
+*/
+struct Frame {
+  FrameBuffer full;
+  FrameBuffer model;
+};
+
+
+/*
+	Produces frames for the detection loop. Frames are backed by pools owned by
+	the source, so a caller must release them before the source is destroyed.
+*/
+class FrameSource {
+public:
+  virtual ~FrameSource() = default;
+
+  virtual bool isOpened() const = 0;
+
+  // Returns false at the end of the stream
+  virtual bool read(Frame& frame) = 0;
+
+  virtual std::string describe() const = 0;
+
+  // Pools owned by the source, for the statistics report
+  virtual std::vector<const FramePool*> pools() const { return {}; }
+
+  // Makes a read() blocked in another thread, and every later one, return
+  // false. Sources whose reads always finish on their own ignore it.
+  virtual void interrupt() {}
+
+  const SourceInfo& info() const { return sourceInfo; }
+
+protected:
+  SourceInfo sourceInfo;
+};
+
+
+/*
+	Input selection from the command line.
+
+	input:    Path to the input video file, or synthetic:WxH:N for N generated
+	          frames of size WxH, or shm:/name for a shared-memory ring filled
+	          by another process, or "-", pipe:<path> or a FIFO path for
+	          uncompressed frames from another program
+	capture:  opencv     - cv::VideoCapture, full-resolution BGR frames (default)
+	          gst-scaled - GStreamer pipeline delivering RGB frames at model resolution
+	          gst-tee    - GStreamer pipeline delivering both of the above from one decode
+	modelRes: Model input resolution
+	depth:    Number of frames the caller may hold at the same time
+
+	inputFormat: Format of pipe input: y4m, rgb24 or bgr24
+	inputSize:   Frame size of raw (rgb24, bgr24) pipe input
+	inputFps:    Frame rate of raw pipe input
+	realtime:    Read frames on a separate thread and deliver only the newest
+	             one, dropping frames the caller is too slow for
+*/
+struct SourceOptions {
+  std::string input;
+  std::string capture  = "opencv";
+  int         modelRes = 0;
+  int         depth    = 1;
+
+  std::string inputFormat = "y4m";
+  cv::Size    inputSize;
+  double      inputFps    = 30.0;
+  bool        realtime    = false;
+};
+
+
+/*
+	Creates and opens the source selected by options. Returns nullptr if the
+	selected capture mode is unknown or not compiled in, otherwise check
+	isOpened() on the result.
+*/
+std::unique_ptr<FrameSource> createFrameSource(const SourceOptions& options);
+
+
+/*
+	Reads fps, frame count, frame size and fourcc from an opened capture.
+*/
+SourceInfo readSourceInfo(cv::VideoCapture& cap);
+
+
+/*
+	cv::VideoCapture based source, delivering full-resolution BGR frames.
+
+	path:       Path to the input video file
+	depth:      Number of frames the caller may hold at the same time
+	startFrame: First frame to deliver. The backend seeks to the preceding
+	            keyframe and decodes forward to it.
+	maxFrames:  Number of frames to deliver, -1 for all remaining
+*/
+class VideoFileSource : public FrameSource {
+public:
+  VideoFileSource(const std::string& path, int depth, int startFrame = 0, int maxFrames = -1);
+
+  bool isOpened() const override { return cap.isOpened(); }
+  bool read(Frame& frame) override;
+  std::string describe() const override { return "opencv " + inputPath; }
+  std::vector<const FramePool*> pools() const override;
+
+private:
+  std::string                inputPath;
+  cv::VideoCapture           cap;
+  std::unique_ptr<FramePool> capturePool;
+  int                        framesLeft;
+};
+
+
+/*
+	Generates deterministic BGR frames without any input file: a fixed textured
+	background with moving boxes and the frame number. Every run produces the
+	same frames, so costs can be compared across resolutions and machines.
+
+	frameSize:  Size of the generated frames
+	frameCount: Number of frames to deliver
+	depth:      Number of frames the caller may hold at the same time
+*/
+class SyntheticSource : public FrameSource {
+public:
+  SyntheticSource(cv::Size frameSize, int frameCount, int depth);
+
+  bool isOpened() const override { return !background.empty(); }
+  bool read(Frame& frame) override;
+  std::string describe() const override;
+  std::vector<const FramePool*> pools() const override;
+
+private:
+  cv::Mat                    background;
+  std::unique_ptr<FramePool> capturePool;
+  int                        frameIndex = 0;
+};
+
+
+/*
+	Parses "synthetic:WxH:N". Returns false if input is not a synthetic source
+	or malformed.
+*/
+bool parseSyntheticInput(const std::string& input, cv::Size& frameSize, int& frameCount);
+
+#endif
@@ -0,0 +1,93 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include "thread_placement.hpp"
+#include "video_writer.hpp"
+
+AsyncVideoWriter::AsyncVideoWriter(VideoSink& sink, size_t queueDepth, bool dropWhenFull)
+  : videoSink(sink),
+    queue(std::max<size_t>(queueDepth, 1)),
+    dropFrames(dropWhenFull),
+    encodeStats("encode"),
+    stallStats("writer backpressure")
+{
+  worker = std::thread(&AsyncVideoWriter::run, this);
+}
+
+AsyncVideoWriter::~AsyncVideoWriter()
+{
+  flush();
+}
+
+void AsyncVideoWriter::write(FrameBuffer frame)
+{
+  // Depth is sampled before queueing, ie. how much work the encoder still had
+  size_t depth = queue.size();
+  depthSum += depth;
+  depthMax  = std::max(depthMax, depth);
+  queuedFrames++;
+
+  if(dropFrames){
+    if(!queue.tryPush(frame)){
+      droppedFrames++;
+    }
+    return;
+  }
+
+  if(depth < queue.capacity()){
+    queue.push(std::move(frame));
+    return;
+  }
+
+  // Queue is full, the main loop has to wait for the encoder
+  auto stallStart = std::chrono::steady_clock::now();
+  queue.push(std::move(frame));
+  stallStats.addSince(stallStart);
+}
+
+void AsyncVideoWriter::flush()
+{
+  queue.close();
+  if(worker.joinable()){
+    worker.join();
+  }
+}
+
+void AsyncVideoWriter::run()
+{
+  placeThread(THREAD_ENCODER);
+
+  FrameBuffer frame;
+
+  while(queue.pop(frame)){
+    auto encodeStart = std::chrono::steady_clock::now();
+    videoSink.write(frame.mat);
+    encodeStats.addSince(encodeStart);
+
+    // Return the buffer to its pool right away
+    frame.release();
+  }
+}
+
+void AsyncVideoWriter::printStats() const
+{
+  std::cout << "Video writer:" << std::endl;
+  encodeStats.print();
+
+  double meanDepth = queuedFrames ? static_cast<double>(depthSum) / queuedFrames : 0.0;
+  std::cout << "  queue depth: mean " << meanDepth << ", max " << depthMax
+            << " of " << queue.capacity() << std::endl;
+
+  if(dropFrames){
+    std::cout << "  dropped frames: " << droppedFrames << " / " << queuedFrames << std::endl;
+  }
+  else{
+    std::cout << "  stalls on full queue: " << stallStats.count()
+              << ", total " << stallStats.totalMs() << " ms" << std::endl;
+  }
+}
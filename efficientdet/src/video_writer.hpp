@@ -0,0 +1,62 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef VIDEO_WRITER
+#define VIDEO_WRITER
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include "opencv2/opencv.hpp"
+#include "frame_pool.hpp"
+#include "ring_queue.hpp"
+#include "stage_stats.hpp"
+#include "video_sink.hpp"
+
+/*
+	Encodes finished frames on a dedicated thread, so encoding overlaps with
+	inference of the next frame instead of adding to it.
+
+	sink:         Opened output sink. Only the writer thread touches it
+	              until flush() returns.
+	queueDepth:   Maximum number of finished frames waiting for the encoder
+	dropWhenFull: When true, frames arriving at a full queue are dropped.
+	              Otherwise write() blocks until the encoder catches up.
+*/
+class AsyncVideoWriter {
+public:
+  AsyncVideoWriter(VideoSink& sink, size_t queueDepth, bool dropWhenFull);
+  ~AsyncVideoWriter();
+
+  AsyncVideoWriter(const AsyncVideoWriter&) = delete;
+  AsyncVideoWriter& operator=(const AsyncVideoWriter&) = delete;
+
+  // Queue a frame for encoding. The pooled buffer is held until it is encoded.
+  void write(FrameBuffer frame);
+
+  // Encode every queued frame and stop the writer thread
+  void flush();
+
+  // Prints queue depth, encoder time and backpressure statistics
+  void printStats() const;
+
+private:
+  void run();
+
+  VideoSink&               videoSink;
+  SpscRing<FrameBuffer>    queue;
+  bool                     dropFrames;
+  std::thread              worker;
+
+  StageStats encodeStats;
+  StageStats stallStats;
+
+  uint64_t queuedFrames  = 0;
+  uint64_t droppedFrames = 0;
+  uint64_t depthSum      = 0;
+  size_t   depthMax      = 0;
+};
+
+#endif
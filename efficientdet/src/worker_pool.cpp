@@ -0,0 +1,364 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "detection_sink.hpp"
+#include "worker_pool.hpp"
+
+namespace {
+
+// A worker slot that dies this many times in a row without finishing a
+// stream, ie. because the interpreter can not be built, is not restarted
+const int MAX_WORKER_FAILURES = 3;
+
+// Delay before the first restart of a slot, doubled with every failure in a row
+const int RESTART_BACKOFF_MS = 100;
+
+// Sent to a worker to start a stream, and back once it is done
+struct WorkerMessage {
+  int32_t stream;
+  int32_t frames;    // -1 if the stream failed
+  double  seconds;
+};
+
+struct Worker {
+  pid_t pid      = -1;
+  int   fd       = -1;
+  int   stream   = -1;   // Stream in progress, -1 when idle
+  int   failures = 0;    // Deaths since the last finished stream
+  bool  gaveUp   = false;
+
+  std::chrono::steady_clock::time_point restartAt;
+};
+
+struct StreamResult {
+  int    attempts = 0;
+  int    frames   = -1;
+  double seconds  = 0;
+  std::string failure;
+};
+
+// Runs one stream in a worker, returns the number of frames or -1
+int processStream(const StreamJob& stream, Detector& detector, SourceOptions sourceOptions,
+                  SinkOptions sinkOptions, PipelineOptions pipelineOptions)
+{
+  sourceOptions.input = stream.input;
+  std::unique_ptr<FrameSource> source = createFrameSource(sourceOptions);
+  if(!source || !source->isOpened()){
+    std::cout << "Failed to open input " << stream.input << std::endl;
+    return -1;
+  }
+
+  if(stream.output.empty()){
+    sinkOptions.type = "null";
+  }
+  sinkOptions.output = stream.output;
+
+  std::unique_ptr<VideoSink> sink = createVideoSink(sinkOptions, source->info().fps, source->info().frameSize);
+  if(!sink || !sink->isOpened()){
+    std::cout << "Failed to open output " << stream.output << std::endl;
+    return -1;
+  }
+
+  std::unique_ptr<FileDetectionSink> detections;
+  if(!stream.detections.empty()){
+    detections.reset(new FileDetectionSink(stream.detections));
+    if(!detections->isOpened()){
+      std::cout << "Failed to open detections file " << stream.detections << std::endl;
+      return -1;
+    }
+  }
+
+  pipelineOptions.sourceName = stream.input;
+
+  int frames = runDetectionLoop(*source, detector, *sink, detections.get(), pipelineOptions);
+  sink->release();
+  if(detections){
+    detections->flush();
+  }
+
+  return frames;
+}
+
+// Body of a worker process: one interpreter, streams until the supervisor
+// closes the socket
+int workerMain(int fd, const std::vector<StreamJob>& streams, const std::string& modelFile,
+               std::shared_ptr<tflite::FlatBufferModel> model, const DetectorOptions& detectorOptions,
+               const SourceOptions& sourceOptions, const SinkOptions& sinkOptions,
+               const PipelineOptions& pipelineOptions)
+{
+  Detector detector;
+  if(!loadDetector(modelFile, detectorOptions, detector, model)){
+    return 1;
+  }
+
+  WorkerMessage message;
+  while(recv(fd, &message, sizeof(message), 0) == sizeof(message)){
+    auto start = std::chrono::steady_clock::now();
+
+    message.frames  = processStream(streams[message.stream], detector, sourceOptions, sinkOptions, pipelineOptions);
+    message.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if(send(fd, &message, sizeof(message), MSG_NOSIGNAL) != sizeof(message)){
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+std::string describeExit(int status)
+{
+  if(WIFSIGNALED(status)){
+    return std::string("killed by signal ") + std::to_string(WTERMSIG(status)) + " (" + strsignal(WTERMSIG(status)) + ")";
+  }
+  return "exited with status " + std::to_string(WEXITSTATUS(status));
+}
+
+}
+
+int runWorkerPool(const std::vector<StreamJob>& streams, const std::string& modelFile,
+                  const DetectorOptions& detectorOptions, const SourceOptions& sourceOptions,
+                  const SinkOptions& sinkOptions, const PipelineOptions& pipelineOptions,
+                  const WorkerPoolOptions& options)
+{
+  // Mapped once here, every fork shares the pages
+  std::shared_ptr<tflite::FlatBufferModel> model = loadModel(modelFile);
+  if(!model){
+    return -1;
+  }
+
+  int workerCount = std::max(1, std::min<int>(options.workers, streams.size()));
+
+  // Split the thread budget, so the workers do not oversubscribe the cores
+  DetectorOptions workerDetectorOptions = detectorOptions;
+  workerDetectorOptions.numThreads = std::max(1, detectorOptions.numThreads / workerCount);
+
+  PipelineOptions workerPipelineOptions = pipelineOptions;
+  workerPipelineOptions.progress = false;
+
+  std::cout << "Processing " << streams.size() << " streams in " << workerCount << " worker processes, "
+            << workerDetectorOptions.numThreads << " interpreter thread(s) each" << std::endl;
+
+  std::vector<Worker> workers(workerCount);
+
+  auto spawn = [&](Worker& worker){
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) != 0){
+      std::cout << "Failed to create worker socket: " << strerror(errno) << std::endl;
+      return false;
+    }
+
+    // Buffered output would be written by both processes
+    std::cout.flush();
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if(pid < 0){
+      std::cout << "Failed to fork worker: " << strerror(errno) << std::endl;
+      close(fds[0]);
+      close(fds[1]);
+      return false;
+    }
+
+    if(pid == 0){
+      close(fds[0]);
+      for(const Worker& other : workers){
+        if(other.fd >= 0){
+          close(other.fd);
+        }
+      }
+
+      int status = workerMain(fds[1], streams, modelFile, model, workerDetectorOptions,
+                              sourceOptions, sinkOptions, workerPipelineOptions);
+      std::cout.flush();
+      _exit(status);
+    }
+
+    close(fds[1]);
+    worker.pid    = pid;
+    worker.fd     = fds[0];
+    worker.stream = -1;
+    return true;
+  };
+
+  for(Worker& worker : workers){
+    if(!spawn(worker)){
+      return -1;
+    }
+  }
+
+  std::vector<StreamResult> results(streams.size());
+  std::deque<int>           pending;
+  for(size_t i = 0; i < streams.size(); i++){
+    pending.push_back(static_cast<int>(i));
+  }
+
+  int restarts = 0;
+  int running  = 0;
+  auto start   = std::chrono::steady_clock::now();
+
+  while(!pending.empty() || running > 0){
+    // Restart dead workers whose backoff is over, and find the next one due
+    auto now = std::chrono::steady_clock::now();
+    int  timeoutMs = -1;
+    for(Worker& worker : workers){
+      if(worker.fd >= 0 || worker.gaveUp){
+        continue;
+      }
+      if(now < worker.restartAt){
+        int due = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                   worker.restartAt - now).count()) + 1;
+        timeoutMs = timeoutMs < 0 ? due : std::min(timeoutMs, due);
+        continue;
+      }
+      if(spawn(worker)){
+        restarts++;
+      }
+      else{
+        worker.gaveUp = true;
+      }
+    }
+
+    // Hand out streams to idle workers
+    for(Worker& worker : workers){
+      if(worker.stream >= 0 || worker.fd < 0 || pending.empty()){
+        continue;
+      }
+
+      WorkerMessage message{pending.front(), 0, 0.0};
+      if(send(worker.fd, &message, sizeof(message), MSG_NOSIGNAL) != sizeof(message)){
+        // The worker is gone, its socket reports the hang-up below
+        continue;
+      }
+
+      pending.pop_front();
+      worker.stream = message.stream;
+      results[message.stream].attempts++;
+      running++;
+    }
+
+    std::vector<struct pollfd> fds;
+    for(const Worker& worker : workers){
+      fds.push_back({worker.fd, POLLIN, 0});
+    }
+
+    if(poll(fds.data(), fds.size(), timeoutMs) < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      std::cout << "Worker pool failed: " << strerror(errno) << std::endl;
+      break;
+    }
+
+    for(size_t i = 0; i < workers.size(); i++){
+      Worker& worker = workers[i];
+      if(!fds[i].revents){
+        continue;
+      }
+
+      WorkerMessage message;
+      ssize_t received = recv(worker.fd, &message, sizeof(message), MSG_DONTWAIT);
+
+      if(received == sizeof(message)){
+        results[message.stream].frames  = message.frames;
+        results[message.stream].seconds = message.seconds;
+        worker.stream   = -1;
+        worker.failures = 0;
+        running--;
+        continue;
+      }
+
+      if(received < 0 && (errno == EAGAIN || errno == EINTR)){
+        continue;
+      }
+
+      // Hang-up: the worker died, retry its stream and restart it from the
+      // supervisor's copy of the model after a backoff
+      int status = 0;
+      waitpid(worker.pid, &status, 0);
+      close(worker.fd);
+      worker.fd = -1;
+
+      std::string reason = describeExit(status);
+      std::cout << "Worker " << worker.pid << " " << reason << std::endl;
+
+      if(worker.stream >= 0){
+        StreamResult& result = results[worker.stream];
+        result.failure = reason;
+        running--;
+
+        if(result.attempts < options.attempts){
+          pending.push_front(worker.stream);
+        }
+        worker.stream = -1;
+      }
+
+      worker.failures++;
+      if(worker.failures >= MAX_WORKER_FAILURES){
+        std::cout << "Worker slot " << i << " failed " << worker.failures
+                  << " times in a row, not restarting it" << std::endl;
+        worker.gaveUp = true;
+      }
+      else{
+        worker.restartAt = std::chrono::steady_clock::now() +
+                           std::chrono::milliseconds(RESTART_BACKOFF_MS << (worker.failures - 1));
+      }
+    }
+
+    bool anyLeft = std::any_of(workers.begin(), workers.end(), [](const Worker& worker){ return !worker.gaveUp; });
+    if(!anyLeft){
+      std::cout << "No workers left" << std::endl;
+      break;
+    }
+  }
+
+  // Closing the sockets ends the workers
+  for(Worker& worker : workers){
+    if(worker.fd >= 0){
+      close(worker.fd);
+      waitpid(worker.pid, nullptr, 0);
+    }
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  bool ok     = true;
+  int  frames = 0;
+  for(size_t i = 0; i < streams.size(); i++){
+    const StreamResult& result = results[i];
+    std::cout << "Stream " << i << " (" << streams[i].input << "): ";
+    if(result.frames >= 0){
+      std::cout << result.frames << " frames in " << result.seconds << " s ("
+                << result.frames / std::max(result.seconds, 1e-9) << " FPS)";
+      frames += result.frames;
+    }
+    else{
+      std::cout << "failed";
+      if(!result.failure.empty()){
+        std::cout << ", worker " << result.failure;
+      }
+      ok = false;
+    }
+    std::cout << ", " << result.attempts << " attempt(s)" << std::endl;
+  }
+
+  std::cout << "Processed " << frames << " frames in " << seconds << " s (" << frames / seconds << " FPS), "
+            << restarts << " worker restart(s)" << std::endl;
+
+  return ok ? 0 : -1;
+}
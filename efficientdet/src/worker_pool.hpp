@@ -0,0 +1,60 @@
+/*
+* Copyright 2022 NXP
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef WORKER_POOL
+#define WORKER_POOL
+
+#include <string>
+#include <vector>
+#include "detector.hpp"
+#include "pipeline.hpp"
+#include "stream_list.hpp"
+#include "video_sink.hpp"
+#include "video_source.hpp"
+
+/*
+	Options of the worker pool.
+
+	workers:  Number of worker processes
+	attempts: Number of times a stream is started before it counts as failed.
+	          A stream whose worker crashed is retried on another worker.
+*/
+struct WorkerPoolOptions {
+  int workers  = 2;
+  int attempts = 2;
+};
+
+
+/*
+	Process streams in crash-isolated worker processes. The supervisor loads
+	the model once and forks the workers afterwards, so every worker shares
+	the weights mapped by the FlatBufferModel (copy-on-write) instead of
+	loading them again. Each worker builds its own interpreter once, then
+	processes the streams the supervisor sends it over a socket pair, one at
+	a time. A worker that dies is replaced by a new fork of the supervisor,
+	again without loading the model, and its stream is retried. Restarts of
+	a worker slot back off, and a slot whose workers die three times in a row
+	without finishing a stream (ie. at startup) is given up.
+
+	Only the calling thread survives fork(), so this must be called before
+	the process starts any other thread.
+
+	streams:         Streams to process
+	modelFile:       Path to the EfficientDet model
+	detectorOptions: Interpreter options, numThreads is split between the
+	                 workers
+	sourceOptions:   Capture options, input is set per stream
+	sinkOptions:     Output options, output is set per stream
+	pipelineOptions: Detection loop options
+	options:         Worker pool settings
+
+	Returns 0 if every stream was processed.
+*/
+int runWorkerPool(const std::vector<StreamJob>& streams, const std::string& modelFile,
+                  const DetectorOptions& detectorOptions, const SourceOptions& sourceOptions,
+                  const SinkOptions& sinkOptions, const PipelineOptions& pipelineOptions,
+                  const WorkerPoolOptions& options);
+
+#endif